@@ -1221,6 +1221,7 @@ process_cap_file(const char *filename, gboolean need_separator)
     cfile_open_failure_message(filename, err, err_info);
     return 2;
   }
+  wtap_set_mmap(cf_info.wth, TRUE);
 
   /*
    * Calculate the checksums. Do this after wtap_open_offline, so we don't
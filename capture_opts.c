@@ -987,8 +987,23 @@ capture_opts_add_opt(capture_options *capture_opts, int opt, const char *optarg_
             ;
         } else if (strcmp(optarg_str_p, "gzip") == 0) {
             ;
+#ifdef HAVE_ZSTD
+        } else if (strcmp(optarg_str_p, "zstd") == 0) {
+            ;
+#endif
+#ifdef HAVE_LZ4FRAME_H
+        } else if (strcmp(optarg_str_p, "lz4") == 0) {
+            ;
+#endif
         } else {
-            cmdarg_err("parameter of --compress-type can be 'none' or 'gzip'");
+            cmdarg_err("parameter of --compress-type can be 'none', 'gzip'"
+#ifdef HAVE_ZSTD
+                       ", 'zstd'"
+#endif
+#ifdef HAVE_LZ4FRAME_H
+                       ", 'lz4'"
+#endif
+                       );
             return 1;
         }
         capture_opts->compress_type = g_strdup(optarg_str_p);
@@ -30,6 +30,7 @@
 #include <wsutil/privileges.h>
 #include <wsutil/report_message.h>
 #include <wsutil/wslog.h>
+#include <wsutil/ws_getopt.h>
 
 #include <wiretap/wtap.h>
 
@@ -59,6 +60,9 @@ main(int argc, char **argv)
 	char		*text;
 	dfilter_t	*df;
 	gchar		*err_msg;
+	gboolean	show_stats = FALSE;
+	int		opt;
+	guint		num_unoptimized, num_optimized;
 
 	cmdarg_err_init(dftest_cmdarg_err, dftest_cmdarg_err_cont);
 
@@ -121,14 +125,26 @@ main(int argc, char **argv)
 	line that its preferences have changed. */
 	prefs_apply_all();
 
+	while ((opt = ws_getopt(argc, argv, "s")) != -1) {
+		switch (opt) {
+			case 's':
+				/* Show the effect of the bytecode optimizer */
+				show_stats = TRUE;
+				break;
+			default:
+				fprintf(stderr, "Usage: dftest [-s] <filter>\n");
+				exit(1);
+		}
+	}
+
 	/* Check for filter on command line */
-	if (argc <= 1) {
-		fprintf(stderr, "Usage: dftest <filter>\n");
+	if (argc <= ws_optind) {
+		fprintf(stderr, "Usage: dftest [-s] <filter>\n");
 		exit(1);
 	}
 
 	/* Get filter text */
-	text = get_args_as_string(argc, argv, 1);
+	text = get_args_as_string(argc, argv, ws_optind);
 
 	printf("Filter: %s\n", text);
 
@@ -145,8 +161,14 @@ main(int argc, char **argv)
 
 	if (df == NULL)
 		printf("Filter is empty\n");
-	else
+	else {
 		dfilter_dump(df);
+		if (show_stats) {
+			dfilter_get_insn_counts(df, &num_unoptimized, &num_optimized);
+			printf("\nInstructions before optimization: %u\n", num_unoptimized);
+			printf("Instructions after optimization: %u\n", num_optimized);
+		}
+	}
 
 	dfilter_free(df);
 	epan_cleanup();
@@ -108,12 +108,24 @@ FILE *debug_log;   /* for logging debug messages to  */
                    /*  is defined                    */
 #endif
 
-static GAsyncQueue *pcap_queue;
-static gint64 pcap_queue_bytes;
-static gint64 pcap_queue_packets;
 static gint64 pcap_queue_byte_limit = 0;
 static gint64 pcap_queue_packet_limit = 0;
 
+/* Queue sizes used if neither -C nor -N is given. */
+#define PCAP_QUEUE_DEFAULT_BYTE_LIMIT   (1000 * 1000)
+#define PCAP_QUEUE_DEFAULT_PACKET_LIMIT 1000
+
+/* Most packets a queue has room for to begin with; it grows if needed. */
+#define PCAP_QUEUE_INITIAL_PACKETS      4096
+
+/*
+ * The writer thread sleeps on this condition when all the packet queues
+ * are empty; capture threads only take the mutex to wake it up.
+ */
+static GMutex pcap_queue_mutex;
+static GCond pcap_queue_cond;
+static gint pcap_queue_writer_waiting;
+
 static gboolean capture_child = FALSE; /* FALSE: standalone call, TRUE: this is an Wireshark capture child */
 static const char *report_capture_filename = NULL; /* capture child file name */
 #ifdef _WIN32
@@ -138,8 +150,9 @@ static void cap_pipe_close(int pipe_fd, gboolean from_socket);
  * Hence we use a select for that come what may.
  *
  * XXX - with TPACKET_V1 and TPACKET_V2, it currently uses select()
- * internally, and, with TPACKET_V3, once that's supported, it'll
- * support timeouts, at least as I understand the way the code works.
+ * internally, and, with TPACKET_V3, it supports timeouts, at least as I
+ * understand the way the code works.  Either way, once select() says
+ * there's something to read, we process everything that's there.
  */
 #define MUST_DO_SELECT
 #endif
@@ -178,6 +191,59 @@ typedef struct _pcapng_pipe_info {
 
 struct _loop_data; /* forward declaration so we can use it in the cap_pipe_dispatch function pointer */
 
+/*
+ * A packet or pcapng block in a packet queue.
+ */
+typedef struct _pcap_queue_element {
+    union {
+        struct pcap_pkthdr  phdr;
+        pcapng_block_header_t  bh;
+    } u;
+    guint               data_offset;    /**< Offset of the packet data in the queue's data buffer */
+    guint               data_len;       /**< Bytes of the data buffer used, including any padding skipped at its end */
+} pcap_queue_element;
+
+/*
+ * Ring of packet queue elements.  "head" is only written by the producer
+ * and "tail" only by the consumer.  Once the producer has set "next" it
+ * doesn't add anything more to this ring.
+ */
+typedef struct _pcap_queue_ring {
+    pcap_queue_element      *elements;
+    guint                    num_elements;  /**< One more than the number of packets the ring can hold */
+    gint                     head;          /**< Next element to fill */
+    gint                     tail;          /**< Next element to write */
+    struct _pcap_queue_ring *next;          /**< Larger ring that replaced this one, if any */
+} pcap_queue_ring;
+
+/*
+ * Queue of packets captured by one capture thread and not yet written by
+ * the writer thread.
+ *
+ * The packet data is preallocated, and so is a ring of elements for up to
+ * PCAP_QUEUE_INITIAL_PACKETS packets, so queueing a packet doesn't
+ * normally allocate memory or take a lock.  If the ring fills up before
+ * the packet limit is reached, the producer starts a ring twice as large
+ * and the consumer switches to it once it has emptied the old one.
+ *
+ * There is exactly one producer (the capture thread of the source) and
+ * one consumer (the writer thread): "push_ring" is only used by the
+ * producer, "pop_ring" only by the consumer, and "data_used" and
+ * "num_queued" are updated atomically by both.  Packet data is stored
+ * contiguously; if it doesn't fit before the end of the data buffer, the
+ * rest of the buffer is skipped and it's stored at the beginning.
+ */
+typedef struct _pcap_queue {
+    pcap_queue_ring    *push_ring;      /**< Ring to which packets are added */
+    pcap_queue_ring    *pop_ring;       /**< Ring from which packets are written */
+    guint               max_packets;    /**< Most packets the queue can hold */
+    gint                num_queued;     /**< Packets in the queue */
+    u_char             *data;
+    guint               data_size;
+    guint               data_head;      /**< Offset in the data buffer at which to store the next packet */
+    gint                data_used;      /**< Bytes of the data buffer in use */
+} pcap_queue_t;
+
 /*
  * A source of packets from which we're capturing.
  */
@@ -185,6 +251,8 @@ typedef struct _capture_src {
     guint32                      received;
     guint32                      dropped;
     guint32                      flushed;
+    guint32                      max_queued;             /**< Most packets ever waiting in the queue */
+    pcap_queue_t                *queue;                  /**< Packets waiting for the writer thread, if we're using threads */
     pcap_t                      *pcap_h;
 #ifdef MUST_DO_SELECT
     int                          pcap_fd;                /**< pcap file descriptor */
@@ -267,15 +335,6 @@ typedef struct _loop_data {
     int      interval_s;
 } loop_data;
 
-typedef struct _pcap_queue_element {
-    capture_src        *pcap_src;
-    union {
-        struct pcap_pkthdr  phdr;
-        pcapng_block_header_t  bh;
-    } u;
-    u_char             *pd;
-} pcap_queue_element;
-
 /*
  * This needs to be static, so that the SIGINT handler can clear the "go"
  * flag and for saved_shb_idb_lock.
@@ -317,6 +376,13 @@ static gboolean need_timeout_workaround;
 
 #define WRITER_THREAD_TIMEOUT 100000 /* usecs */
 
+/*
+ * Longest time, in microseconds, the writer thread keeps writing queued
+ * packets before going back to the capture loop, which flushes the
+ * output if it's a pipe and checks the stop conditions.
+ */
+#define WRITER_FLUSH_INTERVAL 20000 /* usecs */
+
 static void
 dumpcap_log_writer(const char *domain, enum ws_log_level level,
                                    ws_log_time_t timestamp,
@@ -347,7 +413,7 @@ static void WS_NORETURN exit_main(int err);
 
 static void report_new_capture_file(const char *filename);
 static void report_packet_count(unsigned int packet_count);
-static void report_packet_drops(guint32 received, guint32 pcap_drops, guint32 drops, guint32 flushed, guint32 ps_ifdrop, gchar *name);
+static void report_packet_drops(guint32 received, guint32 pcap_drops, guint32 drops, guint32 flushed, guint32 ps_ifdrop, guint32 max_queued, gchar *name);
 static void report_capture_error(const char *error_msg, const char *secondary_error_msg);
 static void report_cfilter_error(capture_options *capture_opts, guint i, const char *errmsg);
 
@@ -3189,16 +3255,8 @@ capture_loop_init_output(capture_options *capture_opts, loop_data *ld, char *err
         if (ld->pdh == NULL) {
             err = errno;
         } else {
-            size_t buffsize = IO_BUF_SIZE;
-#ifdef HAVE_STRUCT_STAT_ST_BLKSIZE
-            ws_statb64 statb;
+            size_t buffsize = pcapio_write_buffer_size(ld->save_file_fd);
 
-            if (ws_fstat64(ld->save_file_fd, &statb) == 0) {
-                if (statb.st_blksize > IO_BUF_SIZE) {
-                    buffsize = statb.st_blksize;
-                }
-            }
-#endif
             /* Increase the size of the IO buffer */
             ld->io_buffer = (char *)g_malloc(buffsize);
             setvbuf(ld->pdh, ld->io_buffer, _IOFBF, buffsize);
@@ -3387,15 +3445,29 @@ capture_loop_dispatch(loop_data *ld,
                  * "select()" says we can read from it without blocking; go for
                  * it.
                  *
-                 * We don't have pcap_breakloop(), so we only process one packet
-                 * per pcap_dispatch() call, to allow a signal to stop the
-                 * processing immediately, rather than processing all packets
-                 * in a batch before quitting.
+                 * Process all the packets that are available, rather than one
+                 * packet per "select()"; with memory-mapped capture (TPACKET_V3
+                 * on Linux) a wakeup typically delivers a whole block of packets.
+                 * capture_loop_stop() calls pcap_breakloop(), so a signal or
+                 * reaching a limit stops the processing in the middle of a batch.
+                 *
+                 * With a packet count limit, process one packet at a time, as
+                 * we used to; when capturing in a separate thread, packets of
+                 * a batch that are queued after the limit is reached would be
+                 * counted as flushed, i.e. reported as dropped.  The same goes
+                 * for a file size or file count limit when capturing in a
+                 * separate thread, as the writer thread is the one that finds
+                 * the limit has been reached.
                  */
+                int dispatch_count =
+                    (global_capture_opts.has_autostop_packets ||
+                     (use_threads &&
+                      (global_capture_opts.has_autostop_filesize ||
+                       global_capture_opts.has_autostop_files))) ? 1 : -1;
                 if (use_threads) {
-                    inpkts = pcap_dispatch(pcap_src->pcap_h, 1, capture_loop_queue_packet_cb, (u_char *)pcap_src);
+                    inpkts = pcap_dispatch(pcap_src->pcap_h, dispatch_count, capture_loop_queue_packet_cb, (u_char *)pcap_src);
                 } else {
-                    inpkts = pcap_dispatch(pcap_src->pcap_h, 1, capture_loop_write_packet_cb, (u_char *)pcap_src);
+                    inpkts = pcap_dispatch(pcap_src->pcap_h, dispatch_count, capture_loop_write_packet_cb, (u_char *)pcap_src);
                 }
                 if (inpkts < 0) {
                     if (inpkts == -1) {
@@ -3724,8 +3796,9 @@ do_file_switch_or_stop(capture_options *capture_opts)
     if (capture_opts->multi_files_on) {
         if (capture_opts->has_autostop_files &&
             ++global_ld.file_count >= capture_opts->autostop_files) {
-            /* no files left: stop here */
-            global_ld.go = FALSE;
+            /* no files left: stop here, and don't let pcap_dispatch()
+               hand us the rest of its batch */
+            capture_loop_stop();
             return FALSE;
         }
 
@@ -3748,7 +3821,7 @@ do_file_switch_or_stop(capture_options *capture_opts)
             if (!successful) {
                 fclose(global_ld.pdh);
                 global_ld.pdh = NULL;
-                global_ld.go = FALSE;
+                capture_loop_stop();
                 g_free(global_ld.io_buffer);
                 global_ld.io_buffer = NULL;
                 return FALSE;
@@ -3768,12 +3841,12 @@ do_file_switch_or_stop(capture_options *capture_opts)
             report_new_capture_file(capture_opts->save_file);
         } else {
             /* File switch failed: stop here */
-            global_ld.go = FALSE;
+            capture_loop_stop();
             return FALSE;
         }
     } else {
         /* single file, stop now */
-        global_ld.go = FALSE;
+        capture_loop_stop();
         return FALSE;
     }
     return TRUE;
@@ -3798,46 +3871,323 @@ pcap_read_handler(void* arg)
     return (NULL);
 }
 
-/* Try to pop an item off the packet queue and if it exists, write it */
+static pcap_queue_ring *
+pcap_queue_ring_new(guint num_packets)
+{
+    pcap_queue_ring *ring;
+
+    ring = g_try_new0(pcap_queue_ring, 1);
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->num_elements = num_packets + 1;
+    ring->elements = g_try_new(pcap_queue_element, ring->num_elements);
+    if (ring->elements == NULL) {
+        g_free(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+static void
+pcap_queue_ring_free(pcap_queue_ring *ring)
+{
+    g_free(ring->elements);
+    g_free(ring);
+}
+
+static void
+pcap_queue_free(pcap_queue_t *queue)
+{
+    pcap_queue_ring *ring, *next;
+
+    if (queue == NULL) {
+        return;
+    }
+    for (ring = queue->pop_ring; ring != NULL; ring = next) {
+        next = ring->next;
+        pcap_queue_ring_free(ring);
+    }
+    g_free(queue->data);
+    g_free(queue);
+}
+
+/*
+ * Allocate the packet queue for a capture source, sized from the -C and
+ * -N limits.  Each source gets its own queue, with room for the largest
+ * packet the source can deliver.  If only -N was given the data area
+ * still uses the default byte limit rather than N times the snapshot
+ * length; -N then just bounds the number of queued packets.  Elements
+ * for at most PCAP_QUEUE_INITIAL_PACKETS packets are allocated up front,
+ * so that a large -N doesn't cost memory unless the packets are queued.
+ *
+ * Returns NULL if the queue couldn't be allocated.
+ */
+static pcap_queue_t *
+pcap_queue_new(capture_src *pcap_src)
+{
+    pcap_queue_t *queue;
+    guint         max_pkt_size;
+    guint         num_packets;
+
+    if (pcap_src->from_cap_pipe && pcap_src->cap_pipe_max_pkt_size > 0) {
+        max_pkt_size = pcap_src->cap_pipe_max_pkt_size;
+    } else if (pcap_src->snaplen > 0) {
+        max_pkt_size = pcap_src->snaplen;
+    } else {
+        max_pkt_size = WTAP_MAX_PACKET_SIZE_STANDARD;
+    }
+
+    queue = g_try_new0(pcap_queue_t, 1);
+    if (queue == NULL) {
+        return NULL;
+    }
+    if (pcap_queue_byte_limit > 0) {
+        queue->data_size = (guint)MIN(pcap_queue_byte_limit, G_MAXINT);
+    } else {
+        queue->data_size = PCAP_QUEUE_DEFAULT_BYTE_LIMIT;
+    }
+    queue->data_size = MAX(queue->data_size, max_pkt_size);
+    if (pcap_queue_packet_limit > 0) {
+        queue->max_packets = (guint)MIN(pcap_queue_packet_limit, G_MAXINT - 1);
+    } else {
+        /* Don't bother with more elements than there can be minimum-sized frames. */
+        queue->max_packets = MAX(queue->data_size / 64, 1);
+    }
+    queue->push_ring = pcap_queue_ring_new(MIN(queue->max_packets, PCAP_QUEUE_INITIAL_PACKETS));
+    queue->pop_ring = queue->push_ring;
+    queue->data = (u_char *)g_try_malloc(queue->data_size);
+    if (queue->push_ring == NULL || queue->data == NULL) {
+        pcap_queue_free(queue);
+        return NULL;
+    }
+    return queue;
+}
+
+/*
+ * Add a packet to the queue of the capture source.  Called only by the
+ * capture thread of the source.  Returns FALSE if the queue is full.
+ */
 static gboolean
-capture_loop_dequeue_packet(void) {
-    pcap_queue_element *queue_element;
+pcap_queue_push(capture_src *pcap_src, const pcap_queue_element *element,
+                const u_char *pd, guint len)
+{
+    pcap_queue_t       *queue = pcap_src->queue;
+    pcap_queue_ring    *ring = queue->push_ring;
+    pcap_queue_ring    *new_ring;
+    pcap_queue_element *slot;
+    guint               next;
+    guint               offset;
+    guint               skip = 0;
+    guint               used;
+    guint               queued;
+
+    queued = (guint)g_atomic_int_get(&queue->num_queued);
+    if (queued >= queue->max_packets)
+        return FALSE;
+    if (len > queue->data_size)
+        return FALSE;
 
-    g_async_queue_lock(pcap_queue);
-    queue_element = (pcap_queue_element *)g_async_queue_timeout_pop_unlocked(pcap_queue, WRITER_THREAD_TIMEOUT);
-    if (queue_element) {
-        if (queue_element->pcap_src->from_pcapng) {
-            pcap_queue_bytes -= queue_element->u.bh.block_total_length;
-        } else {
-            pcap_queue_bytes -= queue_element->u.phdr.caplen;
-        }
-        pcap_queue_packets -= 1;
+    next = ring->head + 1;
+    if (next == ring->num_elements)
+        next = 0;
+    if (next == (guint)g_atomic_int_get(&ring->tail)) {
+        /*
+         * The ring is full but the queue isn't; continue in a larger
+         * ring.  The writer thread frees this one once it's empty.
+         */
+        new_ring = pcap_queue_ring_new(MIN(2 * (ring->num_elements - 1), queue->max_packets));
+        if (new_ring == NULL)
+            return FALSE;
+        g_atomic_pointer_set(&ring->next, new_ring);
+        queue->push_ring = ring = new_ring;
+        next = 1;
     }
-    g_async_queue_unlock(pcap_queue);
-    if (queue_element) {
-        if (queue_element->pcap_src->from_pcapng) {
+
+    used = (guint)g_atomic_int_get(&queue->data_used);
+    /* If the writer thread is done with all the data, start over. */
+    offset = used == 0 ? 0 : queue->data_head;
+    if (len > queue->data_size - offset) {
+        /* Doesn't fit at the end; wrap around. */
+        skip = queue->data_size - offset;
+        offset = 0;
+    }
+    if (skip + len > queue->data_size - used)
+        return FALSE;
+
+    memcpy(queue->data + offset, pd, len);
+    slot = &ring->elements[ring->head];
+    slot->u = element->u;
+    slot->data_offset = offset;
+    slot->data_len = skip + len;
+    queue->data_head = offset + len;
+    g_atomic_int_add(&queue->data_used, (gint)(skip + len));
+    g_atomic_int_inc(&queue->num_queued);
+    g_atomic_int_set(&ring->head, (gint)next);
+
+    if (queued + 1 > pcap_src->max_queued)
+        pcap_src->max_queued = queued + 1;
+
+    /* Wake up the writer thread if it's waiting for packets. */
+    if (g_atomic_int_get(&pcap_queue_writer_waiting)) {
+        g_mutex_lock(&pcap_queue_mutex);
+        g_cond_signal(&pcap_queue_cond);
+        g_mutex_unlock(&pcap_queue_mutex);
+    }
+    return TRUE;
+}
+
+/*
+ * Get the oldest packet in the queue of a capture source, or NULL if the
+ * queue is empty.  Called only by the writer thread.
+ */
+static pcap_queue_element *
+pcap_queue_peek(pcap_queue_t *queue)
+{
+    pcap_queue_ring *ring = queue->pop_ring;
+    pcap_queue_ring *next;
+
+    while (ring->tail == g_atomic_int_get(&ring->head)) {
+        next = (pcap_queue_ring *)g_atomic_pointer_get(&ring->next);
+        if (next == NULL)
+            return NULL;
+        /*
+         * Nothing is added to a ring after it has been replaced, but a
+         * packet may have been added just before; look again.
+         */
+        if (ring->tail != g_atomic_int_get(&ring->head))
+            break;
+        queue->pop_ring = next;
+        pcap_queue_ring_free(ring);
+        ring = next;
+    }
+    return &ring->elements[ring->tail];
+}
+
+/*
+ * Remove the packet returned by pcap_queue_peek() from the queue, once
+ * it's been written.  Called only by the writer thread.
+ */
+static void
+pcap_queue_pop(pcap_queue_t *queue)
+{
+    pcap_queue_ring *ring = queue->pop_ring;
+    guint            next;
+
+    g_atomic_int_add(&queue->data_used, -(gint)ring->elements[ring->tail].data_len);
+    g_atomic_int_add(&queue->num_queued, -1);
+    next = ring->tail + 1;
+    if (next == ring->num_elements)
+        next = 0;
+    g_atomic_int_set(&ring->tail, (gint)next);
+}
+
+/*
+ * Write the oldest packet of one of the packet queues, if there's one.
+ * The queues are visited round-robin so that a busy interface can't
+ * starve the others.
+ */
+static gboolean
+capture_loop_write_queued_packet(void)
+{
+    static guint        next_src = 0;
+    capture_src        *pcap_src;
+    pcap_queue_element *queue_element;
+    u_char             *pd;
+    guint               n, i;
+
+    for (n = 0; n < global_ld.pcaps->len; n++) {
+        i = (next_src + n) % global_ld.pcaps->len;
+        pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+        queue_element = pcap_queue_peek(pcap_src->queue);
+        if (queue_element == NULL)
+            continue;
+
+        next_src = i + 1;
+        pd = pcap_src->queue->data + queue_element->data_offset;
+        if (pcap_src->from_pcapng) {
             ws_info("Dequeued a block of type 0x%08x of length %d captured on interface %d.",
                   queue_element->u.bh.block_type, queue_element->u.bh.block_total_length,
-                  queue_element->pcap_src->interface_id);
+                  pcap_src->interface_id);
 
-            capture_loop_write_pcapng_cb(queue_element->pcap_src,
-                                        &queue_element->u.bh,
-                                        queue_element->pd);
+            capture_loop_write_pcapng_cb(pcap_src, &queue_element->u.bh, pd);
         } else {
             ws_info("Dequeued a packet of length %d captured on interface %d.",
-                queue_element->u.phdr.caplen, queue_element->pcap_src->interface_id);
+                queue_element->u.phdr.caplen, pcap_src->interface_id);
 
-            capture_loop_write_packet_cb((u_char *) queue_element->pcap_src,
-                                        &queue_element->u.phdr,
-                                        queue_element->pd);
+            capture_loop_write_packet_cb((u_char *) pcap_src, &queue_element->u.phdr, pd);
         }
-        g_free(queue_element->pd);
-        g_free(queue_element);
+        pcap_queue_pop(pcap_src->queue);
         return TRUE;
     }
     return FALSE;
 }
 
+static gboolean
+capture_loop_queues_empty(void)
+{
+    capture_src *pcap_src;
+    guint        i;
+
+    for (i = 0; i < global_ld.pcaps->len; i++) {
+        pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+        if (pcap_queue_peek(pcap_src->queue) != NULL)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Write a queued packet; if there's none, wait for one for up to
+ * WRITER_THREAD_TIMEOUT microseconds.
+ */
+static gboolean
+capture_loop_dequeue_packet(void) {
+    gint64 end_time;
+
+    if (capture_loop_write_queued_packet())
+        return TRUE;
+
+    end_time = g_get_monotonic_time() + WRITER_THREAD_TIMEOUT;
+    g_mutex_lock(&pcap_queue_mutex);
+    g_atomic_int_set(&pcap_queue_writer_waiting, 1);
+    /*
+     * Check again now that the capture threads will signal us, so that
+     * we don't sleep on a packet that was queued in the meantime.
+     */
+    if (capture_loop_queues_empty()) {
+        g_cond_wait_until(&pcap_queue_cond, &pcap_queue_mutex, end_time);
+    }
+    g_atomic_int_set(&pcap_queue_writer_waiting, 0);
+    g_mutex_unlock(&pcap_queue_mutex);
+
+    return capture_loop_write_queued_packet();
+}
+
+/*
+ * Write the packets waiting in the queues, waiting for one if there are
+ * none, so that the capture loop flushes the output once per batch of
+ * packets rather than once per packet.  Returns the number of packets
+ * written.
+ */
+static int
+capture_loop_dequeue_packets(void)
+{
+    gint64 end_time;
+    int    inpkts;
+
+    if (!capture_loop_dequeue_packet())
+        return 0;
+    inpkts = 1;
+
+    end_time = g_get_monotonic_time() + WRITER_FLUSH_INTERVAL;
+    while (global_ld.go && g_get_monotonic_time() < end_time &&
+           capture_loop_write_queued_packet()) {
+        inpkts++;
+    }
+    return inpkts;
+}
+
 /*
  * Note: this code will never be run on any OS other than Windows.
  *
@@ -4020,9 +4370,17 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
     /* WOW, everything is prepared! */
     /* please fasten your seat belts, we will enter now the actual capture loop */
     if (use_threads) {
-        pcap_queue = g_async_queue_new();
-        pcap_queue_bytes = 0;
-        pcap_queue_packets = 0;
+        for (i = 0; i < global_ld.pcaps->len; i++) {
+            pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+            pcap_src->queue = pcap_queue_new(pcap_src);
+            if (pcap_src->queue == NULL) {
+                interface_opts = &g_array_index(capture_opts->ifaces, interface_options, i);
+                g_snprintf(errmsg, sizeof(errmsg),
+                           "Couldn't allocate the packet queue for %s.",
+                           interface_opts->display_name);
+                goto error;
+            }
+        }
         for (i = 0; i < global_ld.pcaps->len; i++) {
             pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
             /* XXX - Add an interface name here? */
@@ -4032,13 +4390,7 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
     while (global_ld.go) {
         /* dispatch incoming packets */
         if (use_threads) {
-            gboolean dequeued = capture_loop_dequeue_packet();
-
-            if (dequeued) {
-                inpkts = 1;
-            } else {
-                inpkts = 0;
-            }
+            inpkts = capture_loop_dequeue_packets();
         } else {
             pcap_src = g_array_index(global_ld.pcaps, capture_src *, 0);
             inpkts = capture_loop_dispatch(&global_ld, errmsg,
@@ -4148,14 +4500,17 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
             g_thread_join(pcap_src->tid);
             ws_info("Thread of interface %u terminated.", pcap_src->interface_id);
         }
-        while (1) {
-            gboolean dequeued = capture_loop_dequeue_packet();
-            if (!dequeued) {
-                break;
-            }
-            if (capture_opts->output_to_pipe) {
-                fflush(global_ld.pdh);
-            }
+        inpkts = 0;
+        while (capture_loop_write_queued_packet()) {
+            inpkts++;
+        }
+        if (inpkts > 0 && capture_opts->output_to_pipe) {
+            fflush(global_ld.pdh);
+        }
+        for (i = 0; i < global_ld.pcaps->len; i++) {
+            pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+            pcap_queue_free(pcap_src->queue);
+            pcap_src->queue = NULL;
         }
     }
 
@@ -4346,7 +4701,7 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
                 report_capture_error(errmsg, please_report_bug());
             }
         }
-        report_packet_drops(received, pcap_dropped, pcap_src->dropped, pcap_src->flushed, stats->ps_ifdrop, interface_opts->display_name);
+        report_packet_drops(received, pcap_dropped, pcap_src->dropped, pcap_src->flushed, stats->ps_ifdrop, pcap_src->max_queued, interface_opts->display_name);
     }
 
     /* close the input file (pcap or capture pipe) */
@@ -4358,6 +4713,12 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
     return write_ok && close_ok;
 
 error:
+    for (i = 0; i < global_ld.pcaps->len; i++) {
+        /* Free any packet queues allocated before the failure. */
+        pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+        pcap_queue_free(pcap_src->queue);
+        pcap_src->queue = NULL;
+    }
     if (capture_opts->multi_files_on) {
         /* cleanup ringbuffer */
         ringbuf_error_cleanup();
@@ -4475,7 +4836,8 @@ capture_loop_wrote_one_packet(capture_src *pcap_src) {
     /* check -c NUM / -a packets:NUM */
     if (global_capture_opts.has_autostop_packets && global_ld.packets_captured >= global_capture_opts.autostop_packets) {
         fflush(global_ld.pdh);
-        global_ld.go = FALSE;
+        /* Don't let pcap_dispatch() hand us the rest of its batch. */
+        capture_loop_stop();
         return;
     }
     /* check -b packets:NUM */
@@ -4622,8 +4984,7 @@ capture_loop_queue_packet_cb(u_char *pcap_src_p, const struct pcap_pkthdr *phdr,
                              const u_char *pd)
 {
     capture_src        *pcap_src = (capture_src *) (void *) pcap_src_p;
-    pcap_queue_element *queue_element;
-    gboolean            limit_reached;
+    pcap_queue_element  queue_element;
 
     /* We may be called multiple times from pcap_dispatch(); if we've set
        the "stop capturing" flag, ignore this packet, as we're not
@@ -4633,35 +4994,9 @@ capture_loop_queue_packet_cb(u_char *pcap_src_p, const struct pcap_pkthdr *phdr,
         return;
     }
 
-    queue_element = g_new(pcap_queue_element, 1);
-    if (queue_element == NULL) {
-       pcap_src->dropped++;
-       return;
-    }
-    queue_element->pcap_src = pcap_src;
-    queue_element->u.phdr = *phdr;
-    queue_element->pd = (u_char *)g_malloc(phdr->caplen);
-    if (queue_element->pd == NULL) {
-        pcap_src->dropped++;
-        g_free(queue_element);
-        return;
-    }
-    memcpy(queue_element->pd, pd, phdr->caplen);
-    g_async_queue_lock(pcap_queue);
-    if (((pcap_queue_byte_limit == 0) || (pcap_queue_bytes < pcap_queue_byte_limit)) &&
-        ((pcap_queue_packet_limit == 0) || (pcap_queue_packets < pcap_queue_packet_limit))) {
-        limit_reached = FALSE;
-        g_async_queue_push_unlocked(pcap_queue, queue_element);
-        pcap_queue_bytes += phdr->caplen;
-        pcap_queue_packets += 1;
-    } else {
-        limit_reached = TRUE;
-    }
-    g_async_queue_unlock(pcap_queue);
-    if (limit_reached) {
+    queue_element.u.phdr = *phdr;
+    if (!pcap_queue_push(pcap_src, &queue_element, pd, phdr->caplen)) {
         pcap_src->dropped++;
-        g_free(queue_element->pd);
-        g_free(queue_element);
         ws_info("Dropped a packet of length %d captured on interface %u.",
               phdr->caplen, pcap_src->interface_id);
     } else {
@@ -4669,18 +5004,13 @@ capture_loop_queue_packet_cb(u_char *pcap_src_p, const struct pcap_pkthdr *phdr,
         ws_info("Queued a packet of length %d captured on interface %u.",
               phdr->caplen, pcap_src->interface_id);
     }
-    /* I don't want to hold the mutex over the debug output. So the
-       output may be wrong */
-    ws_info("Queue size is now %" G_GINT64_MODIFIER "d bytes (%" G_GINT64_MODIFIER "d packets)",
-          pcap_queue_bytes, pcap_queue_packets);
 }
 
 /* one pcapng block was captured, queue it */
 static void
 capture_loop_queue_pcapng_cb(capture_src *pcap_src, const pcapng_block_header_t *bh, u_char *pd)
 {
-    pcap_queue_element *queue_element;
-    gboolean            limit_reached;
+    pcap_queue_element  queue_element;
 
     /* We may be called multiple times from pcap_dispatch(); if we've set
        the "stop capturing" flag, ignore this packet, as we're not
@@ -4690,35 +5020,9 @@ capture_loop_queue_pcapng_cb(capture_src *pcap_src, const pcapng_block_header_t
         return;
     }
 
-    queue_element = g_new(pcap_queue_element, 1);
-    if (queue_element == NULL) {
-       pcap_src->dropped++;
-       return;
-    }
-    queue_element->pcap_src = pcap_src;
-    queue_element->u.bh = *bh;
-    queue_element->pd = (u_char *)g_malloc(bh->block_total_length);
-    if (queue_element->pd == NULL) {
-        pcap_src->dropped++;
-        g_free(queue_element);
-        return;
-    }
-    memcpy(queue_element->pd, pd, bh->block_total_length);
-    g_async_queue_lock(pcap_queue);
-    if (((pcap_queue_byte_limit == 0) || (pcap_queue_bytes < pcap_queue_byte_limit)) &&
-        ((pcap_queue_packet_limit == 0) || (pcap_queue_packets < pcap_queue_packet_limit))) {
-        limit_reached = FALSE;
-        g_async_queue_push_unlocked(pcap_queue, queue_element);
-        pcap_queue_bytes += bh->block_total_length;
-        pcap_queue_packets += 1;
-    } else {
-        limit_reached = TRUE;
-    }
-    g_async_queue_unlock(pcap_queue);
-    if (limit_reached) {
+    queue_element.u.bh = *bh;
+    if (!pcap_queue_push(pcap_src, &queue_element, pd, bh->block_total_length)) {
         pcap_src->dropped++;
-        g_free(queue_element->pd);
-        g_free(queue_element);
         ws_info("Dropped a packet of length %d captured on interface %u.",
               bh->block_total_length, pcap_src->interface_id);
     } else {
@@ -4726,10 +5030,6 @@ capture_loop_queue_pcapng_cb(capture_src *pcap_src, const pcapng_block_header_t
         ws_info("Queued a block of type 0x%08x of length %d captured on interface %u.",
               bh->block_type, bh->block_total_length, pcap_src->interface_id);
     }
-    /* I don't want to hold the mutex over the debug output. So the
-       output may be wrong */
-    ws_info("Queue size is now %" G_GINT64_MODIFIER "d bytes (%" G_GINT64_MODIFIER "d packets)",
-          pcap_queue_bytes, pcap_queue_packets);
 }
 
 static int
@@ -5293,8 +5593,8 @@ main(int argc, char *argv[])
     if ((pcap_queue_byte_limit == 0) && (pcap_queue_packet_limit == 0)) {
         /* Use some default if the user hasn't specified some */
         /* XXX: Are these defaults good enough? */
-        pcap_queue_byte_limit = 1000 * 1000;
-        pcap_queue_packet_limit = 1000;
+        pcap_queue_byte_limit = PCAP_QUEUE_DEFAULT_BYTE_LIMIT;
+        pcap_queue_packet_limit = PCAP_QUEUE_DEFAULT_PACKET_LIMIT;
     }
     if (arg_error) {
         print_usage(stderr);
@@ -5706,15 +6006,15 @@ report_capture_error(const char *error_msg, const char *secondary_error_msg)
 }
 
 static void
-report_packet_drops(guint32 received, guint32 pcap_drops, guint32 drops, guint32 flushed, guint32 ps_ifdrop, gchar *name)
+report_packet_drops(guint32 received, guint32 pcap_drops, guint32 drops, guint32 flushed, guint32 ps_ifdrop, guint32 max_queued, gchar *name)
 {
     guint32 total_drops = pcap_drops + drops + flushed;
 
     if (capture_child) {
         char* tmp = g_strdup_printf("%u:%s", total_drops, name);
 
-        ws_debug("Packets received/dropped on interface '%s': %u/%u (pcap:%u/dumpcap:%u/flushed:%u/ps_ifdrop:%u)",
-            name, received, total_drops, pcap_drops, drops, flushed, ps_ifdrop);
+        ws_debug("Packets received/dropped on interface '%s': %u/%u (pcap:%u/dumpcap:%u/flushed:%u/ps_ifdrop:%u/max queued:%u)",
+            name, received, total_drops, pcap_drops, drops, flushed, ps_ifdrop, max_queued);
         pipe_write_block(2, SP_DROPS, tmp);
         g_free(tmp);
     } else {
@@ -5722,6 +6022,11 @@ report_packet_drops(guint32 received, guint32 pcap_drops, guint32 drops, guint32
             "Packets received/dropped on interface '%s': %u/%u (pcap:%u/dumpcap:%u/flushed:%u/ps_ifdrop:%u) (%.1f%%)\n",
             name, received, total_drops, pcap_drops, drops, flushed, ps_ifdrop,
             received ? 100.0 * received / (received + total_drops) : 0.0);
+        if (use_threads) {
+            fprintf(stderr,
+                "Most packets queued on interface '%s' at once: %u\n",
+                name, max_queued);
+        }
         /* stderr could be line buffered */
         fflush(stderr);
     }
@@ -44,6 +44,7 @@
 
 #include <wiretap/secrets-types.h>
 #include <wiretap/wtap.h>
+#include <wiretap/frame_index.h>
 
 #include "epan/etypes.h"
 #include "epan/dissectors/packet-ieee80211-radiotap-defs.h"
@@ -98,19 +99,41 @@ struct select_item {
 
 /*
  * Duplicate frame detection
+ *
+ * fd_hash[] is a ring of the digests of the last dup_window frames.
+ * To find a frame's earlier copies without looking at the whole ring,
+ * fd_hash_index[] maps each digest (and length) in the ring to the most
+ * recent frame with that digest, and each frame refers to the previous
+ * frame with the same digest.  Frames are identified by their sequence
+ * number, so a reference to a frame that has left the ring is noticed.
+ *
+ * With -w, a frame is only a duplicate if no frame between it and the
+ * copy is outside the time window, even one with a different digest.
+ * fd_time_min[] holds the seqs of the frames in the ring that are
+ * earlier than every frame after them, oldest first, so the earliest
+ * frame after any given one is found with a binary search.
  */
 typedef struct _fd_hash_t {
     guint8     digest[16];
     guint32    len;
     nstime_t   frame_time;
+    guint64    seq;         /* sequence number + 1 of this frame, 0 if unused */
+    guint64    prev_seq;    /* same for the previous frame with this digest */
 } fd_hash_t;
 
 #define DEFAULT_DUP_DEPTH       5   /* Used with -d */
-#define MAX_DUP_DEPTH     1000000   /* the maximum window (and actual size of fd_hash[]) for de-duplication */
-
-static fd_hash_t fd_hash[MAX_DUP_DEPTH];
-static int       dup_window    = DEFAULT_DUP_DEPTH;
-static int       cur_dup_entry = 0;
+#define MAX_DUP_DEPTH   100000000   /* the maximum window for de-duplication with -D */
+#define REL_TIME_DUP_DEPTH 1000000  /* the window (size of fd_hash[]) used with -w */
+
+static fd_hash_t *fd_hash       = NULL;
+static int        dup_window    = DEFAULT_DUP_DEPTH;
+static int        cur_dup_entry = 0;
+static guint64    dup_seq       = 0;    /* sequence number + 1 of the last frame */
+static guint64   *fd_hash_index = NULL; /* open-addressing table of fd_hash[] seqs */
+static guint64    fd_hash_index_mask;
+static guint64   *fd_time_min   = NULL; /* ring of seqs, used with -w */
+static int        fd_time_min_first;
+static int        fd_time_min_count;
 
 static guint32   ignored_bytes  = 0;  /* Used with -I */
 
@@ -582,15 +605,207 @@ remove_vlan_info(const wtap_packet_header *phdr, guint8* fd, guint32* len) {
     }
 }
 
+static void
+dup_cleanup(void)
+{
+    g_free(fd_hash);
+    g_free(fd_hash_index);
+    g_free(fd_time_min);
+    fd_hash = NULL;
+    fd_hash_index = NULL;
+    fd_time_min = NULL;
+}
+
+static gboolean
+dup_init(void)
+{
+    guint64 index_size;
+    int ring_size = dup_window > 0 ? dup_window : 1;
+
+    /* Keep the index at most half full. */
+    for (index_size = 16; index_size < (guint64)ring_size * 2; index_size <<= 1)
+        ;
+    fd_hash = g_try_new0(fd_hash_t, ring_size);
+    fd_hash_index = g_try_new0(guint64, index_size);
+    if (dup_detect_by_time)
+        fd_time_min = g_try_new0(guint64, ring_size);
+    if (fd_hash == NULL || fd_hash_index == NULL ||
+        (dup_detect_by_time && fd_time_min == NULL)) {
+        dup_cleanup();
+        return FALSE;
+    }
+    fd_time_min_first = 0;
+    fd_time_min_count = 0;
+    fd_hash_index_mask = index_size - 1;
+    /* Frame n goes into fd_hash[(n - 1) % ring_size], starting with 0. */
+    cur_dup_entry = ring_size - 1;
+    dup_seq = 0;
+    for (int i = 0; i < ring_size; i++)
+        nstime_set_unset(&fd_hash[i].frame_time);
+    return TRUE;
+}
+
+/* The ring entry of a frame, or NULL if it has left the ring. */
+static fd_hash_t *
+dup_entry(guint64 seq)
+{
+    fd_hash_t *entry;
+
+    if (seq == 0)
+        return NULL;
+    entry = &fd_hash[(seq - 1) % (dup_window > 0 ? dup_window : 1)];
+    return entry->seq == seq ? entry : NULL;
+}
+
+static guint64
+dup_index_slot(const fd_hash_t *entry)
+{
+    guint64 hash;
+
+    /* The digest is already well mixed; just use part of it. */
+    memcpy(&hash, entry->digest, sizeof hash);
+    return (hash ^ entry->len) & fd_hash_index_mask;
+}
+
+static gboolean
+dup_same_frame(const fd_hash_t *a, const fd_hash_t *b)
+{
+    return a->len == b->len && memcmp(a->digest, b->digest, 16) == 0;
+}
+
+/*
+ * Find the index slot for the digest of entry: the one referring to the
+ * most recent frame with that digest, or the empty slot where it would go.
+ */
+static guint64
+dup_index_find(const fd_hash_t *entry)
+{
+    guint64 slot = dup_index_slot(entry);
+
+    while (fd_hash_index[slot] != 0 &&
+           !dup_same_frame(dup_entry(fd_hash_index[slot]), entry))
+        slot = (slot + 1) & fd_hash_index_mask;
+    return slot;
+}
+
+/*
+ * The frame in the current ring slot is about to be overwritten; if it's
+ * the most recent frame with its digest, take the digest out of the
+ * index.  Any other references to it are from frames that are newer
+ * than it, and dup_entry() will notice that it's gone.
+ */
+static void
+dup_evict(void)
+{
+    fd_hash_t *old = &fd_hash[cur_dup_entry];
+    guint64 slot, next, home;
+
+    if (old->seq == 0)
+        return;
+    slot = dup_index_find(old);
+    if (fd_hash_index[slot] != old->seq)
+        return;
+
+    /* Remove it, moving back later entries of the same probe run. */
+    fd_hash_index[slot] = 0;
+    for (next = (slot + 1) & fd_hash_index_mask; fd_hash_index[next] != 0;
+         next = (next + 1) & fd_hash_index_mask) {
+        home = dup_index_slot(dup_entry(fd_hash_index[next]));
+        if (((next - home) & fd_hash_index_mask) >= ((next - slot) & fd_hash_index_mask)) {
+            fd_hash_index[slot] = fd_hash_index[next];
+            fd_hash_index[next] = 0;
+            slot = next;
+        }
+    }
+}
+
+/*
+ * Put the frame's digest into the next ring slot and the index.  Returns
+ * the ring entry for the previous frame with the same digest, if it's
+ * still in the ring, or NULL.
+ */
+static fd_hash_t *
+dup_add(guint8 *fd, guint32 offset, guint32 len)
+{
+    fd_hash_t *entry;
+    guint64 slot;
+
+    cur_dup_entry++;
+    if (cur_dup_entry >= dup_window)
+        cur_dup_entry = 0;
+    dup_evict();
+
+    entry = &fd_hash[cur_dup_entry];
+
+    /* Calculate our digest */
+    gcry_md_hash_buffer(GCRY_MD_MD5, entry->digest, &fd[offset], len - offset);
+    entry->len = len;
+    entry->seq = ++dup_seq;
+
+    slot = dup_index_find(entry);
+    entry->prev_seq = fd_hash_index[slot];
+    fd_hash_index[slot] = entry->seq;
+    return dup_entry(entry->prev_seq);
+}
+
+/* The seq of the i-th frame in fd_time_min[]. */
+static guint64
+dup_time_min_seq(int i)
+{
+    return fd_time_min[(fd_time_min_first + i) % dup_window];
+}
+
+/*
+ * The earliest time stamp of the frames in the ring after the frame with
+ * the given seq, or NULL if there are none.
+ */
+static const nstime_t *
+dup_time_min_after(guint64 seq)
+{
+    const fd_hash_t *entry;
+    int low = 0, high = fd_time_min_count, mid;
+
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (dup_time_min_seq(mid) > seq)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    if (low == fd_time_min_count)
+        return NULL;
+    entry = dup_entry(dup_time_min_seq(low));
+    return entry != NULL ? &entry->frame_time : NULL;
+}
+
+/* Add the newest frame in the ring to fd_time_min[]. */
+static void
+dup_time_min_add(const fd_hash_t *entry)
+{
+    const fd_hash_t *last;
+
+    /* Forget frames that have left the ring, */
+    while (fd_time_min_count > 0 && dup_entry(dup_time_min_seq(0)) == NULL) {
+        fd_time_min_first = (fd_time_min_first + 1) % dup_window;
+        fd_time_min_count--;
+    }
+    /* and frames that aren't earlier than this one. */
+    while (fd_time_min_count > 0) {
+        last = dup_entry(dup_time_min_seq(fd_time_min_count - 1));
+        if (last != NULL && nstime_cmp(&last->frame_time, &entry->frame_time) < 0)
+            break;
+        fd_time_min_count--;
+    }
+    fd_time_min[(fd_time_min_first + fd_time_min_count) % dup_window] = entry->seq;
+    fd_time_min_count++;
+}
+
 static gboolean
 is_duplicate(guint8* fd, guint32 len) {
-    int i;
     const struct ieee80211_radiotap_header* tap_header;
 
     /*Hint to ignore some bytes at the start of the frame for the digest calculation(-I option) */
     guint32 offset = ignored_bytes;
-    guint32 new_len;
-    guint8 *new_fd;
 
     if (len <= ignored_bytes) {
         offset = 0;
@@ -604,104 +819,50 @@ is_duplicate(guint8* fd, guint32 len) {
             offset = 0;
     }
 
-    new_fd  = &fd[offset];
-    new_len = len - (offset);
-
-    cur_dup_entry++;
-    if (cur_dup_entry >= dup_window)
-        cur_dup_entry = 0;
-
-    /* Calculate our digest */
-    gcry_md_hash_buffer(GCRY_MD_MD5, fd_hash[cur_dup_entry].digest, new_fd, new_len);
-
-    fd_hash[cur_dup_entry].len = len;
-
-    /* Look for duplicates */
-    for (i = 0; i < dup_window; i++) {
-        if (i == cur_dup_entry)
-            continue;
-
-        if (fd_hash[i].len == fd_hash[cur_dup_entry].len
-            && memcmp(fd_hash[i].digest, fd_hash[cur_dup_entry].digest, 16) == 0) {
-            return TRUE;
-        }
-    }
-
-    return FALSE;
+    /* Any earlier frame with the same digest that's still in the window is a duplicate. */
+    return dup_add(fd, offset, len) != NULL;
 }
 
 static gboolean
 is_duplicate_rel_time(guint8* fd, guint32 len, const nstime_t *current) {
-    int i;
+    fd_hash_t *prev;
+    const nstime_t *earliest;
+    gboolean duplicate = FALSE;
 
     /*Hint to ignore some bytes at the start of the frame for the digest calculation(-I option) */
     guint32 offset = ignored_bytes;
-    guint32 new_len;
-    guint8 *new_fd;
 
     if (len <= ignored_bytes) {
         offset = 0;
     }
 
-    new_fd  = &fd[offset];
-    new_len = len - (offset);
-
-    cur_dup_entry++;
-    if (cur_dup_entry >= dup_window)
-        cur_dup_entry = 0;
-
-    /* Calculate our digest */
-    gcry_md_hash_buffer(GCRY_MD_MD5, fd_hash[cur_dup_entry].digest, new_fd, new_len);
-
-    fd_hash[cur_dup_entry].len = len;
+    prev = dup_add(fd, offset, len);
     fd_hash[cur_dup_entry].frame_time.secs = current->secs;
     fd_hash[cur_dup_entry].frame_time.nsecs = current->nsecs;
 
     /*
-     * Look for relative time related duplicates.
-     * This is hopefully a reasonably efficient mechanism for
-     * finding duplicates by rel time in the fd_hash[] cache.
-     * We check starting from the most recently added hash
-     * entries and work backwards towards older packets.
-     * This approach allows the dup test to be terminated
-     * when the relative time of a cached entry is found to
-     * be beyond the dup time window.
+     * Look for relative time related duplicates, starting from the
+     * most recent earlier frame with the same digest and working
+     * backwards towards older frames, so that we can stop once a
+     * frame is beyond the dup time window.  That includes frames
+     * with other digests in between.
      *
      * Of course this assumes that the input trace file is
      * "well-formed" in the sense that the packet timestamps are
      * in strict chronologically increasing order (which is NOT
      * always the case!!).
-     *
-     * The fd_hash[] table was deliberately created large (1,000,000).
-     * Looking for time related duplicates in large trace files with
-     * non-fractional dup time window values can potentially take
-     * a long time to complete.
      */
-
-    for (i = cur_dup_entry - 1;; i--) {
+    for (; prev != NULL; prev = dup_entry(prev->prev_seq)) {
         nstime_t delta;
-        int cmp;
 
-        if (i < 0)
-            i = dup_window - 1;
-
-        if (i == cur_dup_entry) {
-            /*
-             * We've decremented back to where we started.
-             * Check no more!
-             */
-            break;
-        }
-
-        if (nstime_is_unset(&(fd_hash[i].frame_time))) {
-            /*
-             * We've decremented to an unused fd_hash[] entry.
-             * Check no more!
-             */
-            break;
+        earliest = dup_time_min_after(prev->seq);
+        if (earliest != NULL) {
+            nstime_delta(&delta, current, earliest);
+            if (nstime_cmp(&delta, &relative_time_window) > 0)
+                break;
         }
 
-        nstime_delta(&delta, current, &fd_hash[i].frame_time);
+        nstime_delta(&delta, current, &prev->frame_time);
 
         if (delta.secs < 0 || delta.nsecs < 0) {
             /*
@@ -725,22 +886,20 @@ is_duplicate_rel_time(guint8* fd, guint32 len, const nstime_t *current) {
             continue;
         }
 
-        cmp = nstime_cmp(&delta, &relative_time_window);
-
-        if (cmp > 0) {
+        if (nstime_cmp(&delta, &relative_time_window) > 0) {
             /*
              * The delta time indicates that we are now looking at
              * cached packets beyond the specified dup time window.
              * Check no more!
              */
             break;
-        } else if (fd_hash[i].len == fd_hash[cur_dup_entry].len
-                   && memcmp(fd_hash[i].digest, fd_hash[cur_dup_entry].digest, 16) == 0) {
-            return TRUE;
         }
+        duplicate = TRUE;
+        break;
     }
 
-    return FALSE;
+    dup_time_min_add(&fd_hash[cur_dup_entry]);
+    return duplicate;
 }
 
 static void
@@ -847,6 +1006,9 @@ print_usage(FILE *output)
     fprintf(output, "                         when writing the output file.  Does not discard\n");
     fprintf(output, "                         comments added by \"--capture-comment\" in the same\n");
     fprintf(output, "                         command line.\n");
+    fprintf(output, "  --write-frame-index    Also write a frame index for the input file next to\n");
+    fprintf(output, "                         it, so that programs using it can find its records\n");
+    fprintf(output, "                         without reading the whole file.\n");
     fprintf(output, "\n");
     fprintf(output, "Miscellaneous:\n");
     fprintf(output, "  -h                     display this help and exit.\n");
@@ -1140,6 +1302,7 @@ main(int argc, char *argv[])
 #define LONGOPT_DISCARD_ALL_SECRETS  LONGOPT_BASE_APPLICATION+5
 #define LONGOPT_CAPTURE_COMMENT      LONGOPT_BASE_APPLICATION+6
 #define LONGOPT_DISCARD_CAPTURE_COMMENT LONGOPT_BASE_APPLICATION+7
+#define LONGOPT_WRITE_FRAME_INDEX    LONGOPT_BASE_APPLICATION+8
 
     static const struct ws_option long_options[] = {
         {"novlan", ws_no_argument, NULL, LONGOPT_NO_VLAN},
@@ -1151,6 +1314,7 @@ main(int argc, char *argv[])
         {"version", ws_no_argument, NULL, 'V'},
         {"capture-comment", ws_required_argument, NULL, LONGOPT_CAPTURE_COMMENT},
         {"discard-capture-comment", ws_no_argument, NULL, LONGOPT_DISCARD_CAPTURE_COMMENT},
+        {"write-frame-index", ws_no_argument, NULL, LONGOPT_WRITE_FRAME_INDEX},
         {0, 0, 0, 0 }
     };
 
@@ -1179,6 +1343,10 @@ main(int argc, char *argv[])
     guint         max_packet_number  = 0;
     GArray       *dsb_types          = NULL;
     GPtrArray    *dsb_filenames      = NULL;
+    gboolean      write_frame_index  = FALSE;
+    wtap_frame_index_writer     *frame_index = NULL;
+    int                          frame_index_err;
+    gboolean                     stopped_early = FALSE;
     wtap_rec                     read_rec;
     Buffer                       read_buf;
     const wtap_rec              *rec;
@@ -1312,6 +1480,12 @@ main(int argc, char *argv[])
             break;
         }
 
+        case LONGOPT_WRITE_FRAME_INDEX:
+        {
+            write_frame_index = TRUE;
+            break;
+        }
+
         case 'a':
         {
             guint frame_number;
@@ -1409,7 +1583,7 @@ main(int argc, char *argv[])
             dup_detect = TRUE;
             dup_detect_by_time = FALSE;
             dup_window = get_guint32(ws_optarg, "duplicate window");
-            if (dup_window > MAX_DUP_DEPTH) {
+            if (dup_window < 0 || dup_window > MAX_DUP_DEPTH) {
                 fprintf(stderr, "editcap: \"%d\" duplicate window value must be between 0 and %d inclusive.\n",
                         dup_window, MAX_DUP_DEPTH);
                 ret = INVALID_OPTION;
@@ -1528,7 +1702,7 @@ main(int argc, char *argv[])
         case 'w':
             dup_detect = FALSE;
             dup_detect_by_time = TRUE;
-            dup_window = MAX_DUP_DEPTH;
+            dup_window = REL_TIME_DUP_DEPTH;
             if (!set_rel_time(ws_optarg)) {
                 ret = INVALID_OPTION;
                 goto clean_exit;
@@ -1606,6 +1780,9 @@ main(int argc, char *argv[])
         goto clean_exit;
     }
 
+    /* We read the input once, from start to end. */
+    wtap_set_mmap(wth, TRUE);
+
     if (verbose) {
         fprintf(stderr, "File %s is a %s capture file.\n", argv[ws_optind],
                 wtap_file_type_subtype_description(wtap_file_type_subtype(wth)));
@@ -1737,16 +1914,27 @@ main(int argc, char *argv[])
         max_packet_number = G_MAXUINT;
 
     if (dup_detect || dup_detect_by_time) {
-        for (i = 0; i < dup_window; i++) {
-            memset(&fd_hash[i].digest, 0, 16);
-            fd_hash[i].len = 0;
-            nstime_set_unset(&fd_hash[i].frame_time);
+        if (!dup_init()) {
+            fprintf(stderr, "editcap: not enough memory for a duplicate window of %d packets\n",
+                    dup_window);
+            ret = INVALID_OPTION;
+            goto clean_exit;
         }
     }
 
     /* Set up an array of all IDBs seen */
     idbs_seen = g_array_new(FALSE, FALSE, sizeof(wtap_block_t));
 
+    if (write_frame_index) {
+        frame_index = wtap_frame_index_writer_open(argv[ws_optind], &frame_index_err);
+        if (frame_index == NULL) {
+            fprintf(stderr, "editcap: Can't write a frame index for \"%s\": %s\n",
+                    argv[ws_optind], g_strerror(frame_index_err));
+            ret = INVALID_FILE;
+            goto clean_exit;
+        }
+    }
+
     /* Read all of the packets in turn */
     wtap_rec_init(&read_rec);
     ws_buffer_init(&read_buf, 1514);
@@ -1757,8 +1945,18 @@ main(int argc, char *argv[])
          * presumably indicate that we weren't capturing on that
          * interface at this point, but what about, for example, NRBs?
          */
-        if (max_packet_number <= read_count)
+        if (max_packet_number <= read_count) {
+            stopped_early = TRUE;
             break;
+        }
+
+        if (frame_index != NULL &&
+            !wtap_frame_index_writer_add(frame_index, data_offset, &read_rec, &frame_index_err)) {
+            fprintf(stderr, "editcap: Can't write a frame index for \"%s\": %s\n",
+                    argv[ws_optind], g_strerror(frame_index_err));
+            wtap_frame_index_writer_abort(frame_index);
+            frame_index = NULL;
+        }
 
         read_count++;
 
@@ -2268,6 +2466,20 @@ main(int argc, char *argv[])
         cfile_read_failure_message(argv[ws_optind], read_err, read_err_info);
     }
 
+    if (frame_index != NULL) {
+        /*
+         * The index is only useful if it covers the whole file, so
+         * don't keep it if we didn't get to the end of the file.
+         */
+        if (read_err != 0 || stopped_early) {
+            wtap_frame_index_writer_abort(frame_index);
+        } else if (!wtap_frame_index_writer_close(frame_index, wth, &frame_index_err)) {
+            fprintf(stderr, "editcap: Can't write a frame index for \"%s\": %s\n",
+                    argv[ws_optind], g_strerror(frame_index_err));
+        }
+        frame_index = NULL;
+    }
+
     if (!pdh) {
         /* No valid packages found, open the outfile so we can write an
          * empty header */
@@ -2309,6 +2521,9 @@ main(int argc, char *argv[])
     }
 
 clean_exit:
+    if (frame_index != NULL)
+        wtap_frame_index_writer_abort(frame_index);
+    dup_cleanup();
     if (dsb_filenames) {
         g_array_free(dsb_types, TRUE);
         g_ptr_array_free(dsb_filenames, TRUE);
@@ -49,6 +49,20 @@ static GSList *color_filter_valid_list   = NULL;
 /* Color Filters can en-/disabled. */
 static gboolean filters_enabled = TRUE;
 
+/* The fields used by the enabled color filters, each of them once, so that
+ * fields used in many rules ("tcp", "ip.addr", ...) are primed once per
+ * packet. Built on first use and discarded whenever the filters change. */
+static GArray *color_filter_hfids = NULL;
+
+static void
+color_filters_changed(void)
+{
+    if (color_filter_hfids != NULL) {
+        g_array_free(color_filter_hfids, TRUE);
+        color_filter_hfids = NULL;
+    }
+}
+
 /* Remember if there are temporary coloring filters set to
  * add sensitivity to the "Reset Coloring 1-10" menu item
  */
@@ -197,6 +211,7 @@ color_filters_set_tmp(guint8 filt_nr, const gchar *filter, gboolean disabled, gc
         }
         g_free(name);
     }
+    color_filters_changed();
     return TRUE;
 }
 
@@ -350,6 +365,7 @@ color_filters_init(gchar** err_msg, color_filter_add_cb_func add_cb)
 {
     /* delete all currently existing filters */
     color_filter_list_delete(&color_filter_list);
+    color_filters_changed();
 
     /* now try to construct the filters list */
     return color_filters_get(err_msg, add_cb);
@@ -362,6 +378,7 @@ color_filters_reload(gchar** err_msg, color_filter_add_cb_func add_cb)
      * we must keep them until the dissection no longer needs them */
     color_filter_deleted_list = g_slist_concat(color_filter_deleted_list, color_filter_list);
     color_filter_list = NULL;
+    color_filters_changed();
 
     /* now try to construct the filters list */
     return color_filters_get(err_msg, add_cb);
@@ -456,6 +473,7 @@ color_filters_apply(GSList *tmp_cfl, GSList *edit_cfl, gchar** err_msg)
      * we must keep them until the dissection no longer needs them */
     color_filter_deleted_list = g_slist_concat(color_filter_deleted_list, color_filter_list);
     color_filter_list = NULL;
+    color_filters_changed();
 
     /* clone all list entries from tmp/edit to normal list */
     color_filter_valid_list = NULL;
@@ -493,15 +511,16 @@ tmp_color_filters_used(void)
     return tmp_colors_set;
 }
 
-/* prepare the epan_dissect_t for the filter */
+/* add the fields used by a filter to the set to prime with */
 static void
-prime_edt(gpointer data, gpointer user_data)
+add_hfids(gpointer data, gpointer user_data)
 {
     color_filter_t *colorf = (color_filter_t *)data;
-    epan_dissect_t *edt    = (epan_dissect_t *)user_data;
+    GArray         *hfids  = (GArray *)user_data;
 
-    if (colorf->c_colorfilter != NULL)
-        epan_dissect_prime_with_dfilter(edt, colorf->c_colorfilter);
+    /* Disabled filters aren't applied, so don't need their fields. */
+    if (!colorf->disabled && colorf->c_colorfilter != NULL)
+        dfilter_add_interesting_fields(colorf->c_colorfilter, hfids);
 }
 
 /* Prime the epan_dissect_t with all the compiler
@@ -509,8 +528,14 @@ prime_edt(gpointer data, gpointer user_data)
 void
 color_filters_prime_edt(epan_dissect_t *edt)
 {
-    if (color_filters_used())
-        g_slist_foreach(color_filter_list, prime_edt, edt);
+    if (!color_filters_used())
+        return;
+
+    if (color_filter_hfids == NULL) {
+        color_filter_hfids = g_array_new(FALSE, FALSE, sizeof(int));
+        g_slist_foreach(color_filter_list, add_hfids, color_filter_hfids);
+    }
+    epan_dissect_prime_with_hfid_array(edt, color_filter_hfids);
 }
 
 /* * Return the color_t for later use */
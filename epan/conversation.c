@@ -65,6 +65,56 @@ static wmem_map_t *conversation_hashtable_no_addr2_or_port2 = NULL;
 
 static guint32 new_index;
 
+/*
+ * Least recently used list of conversations, from the one created or
+ * found longest ago to the one created or found most recently.  It's
+ * only maintained if eviction is enabled.
+ */
+static conversation_t *conversation_lru_head = NULL;
+static conversation_t *conversation_lru_tail = NULL;
+
+/*
+ * Eviction limits requested with conversation_set_eviction(), and the
+ * ones in effect for the current file; 0 means no limit.
+ */
+static guint conversation_max_count_pref = 0;
+static guint32 conversation_idle_frames_pref = 0;
+static guint conversation_max_count = 0;
+static guint32 conversation_idle_frames = 0;
+
+static guint conversation_live_count;
+static guint64 conversation_evicted_count;
+
+/*
+ * Routines to call for a protocol's data when a conversation is evicted.
+ */
+typedef struct {
+	int proto;
+	conversation_release_func func;
+} conversation_release_hook_t;
+
+static GSList *conversation_release_hooks = NULL;
+
+/*
+ * For each of the wildcard hash tables, the number of conversations in
+ * it, and a counting filter of the address 1/port 1 endpoints of those
+ * conversations.  Wildcard matches always compare address 1 and port 1,
+ * so if the filter bucket for an endpoint is zero, there's no
+ * conversation in the table for it and the table needn't be searched.
+ * Most new flows don't match any wildcard conversation, and without
+ * this each of them would pay for up to six failed lookups.
+ */
+#define CONVERSATION_GUARD_BUCKETS	4096	/* must be a power of 2 */
+
+typedef struct {
+	guint count;
+	guint32 buckets[CONVERSATION_GUARD_BUCKETS];
+} conversation_guard_t;
+
+static conversation_guard_t conversation_guard_no_addr2;
+static conversation_guard_t conversation_guard_no_port2;
+static conversation_guard_t conversation_guard_no_addr2_or_port2;
+
 /*
  * Placeholder for address-less conversations.
  */
@@ -157,7 +207,9 @@ conversation_create_from_template(conversation_t *conversation, const address *a
 		 * Set the protocol dissector used for the template conversation as
 		 * the handler of the new conversation as well.
 		 */
+		wmem_tree_destroy(new_conversation_from_template->dissector_tree, FALSE, FALSE);
 		new_conversation_from_template->dissector_tree = conversation->dissector_tree;
+		new_conversation_from_template->dissector_tree_shared = TRUE;
 
 		return new_conversation_from_template;
 	}
@@ -481,6 +533,160 @@ void conversation_epan_reset(void)
 	 * Start the conversation indices over at 0.
 	 */
 	new_index = 0;
+
+	/*
+	 * The conversations of the previous file, if any, have been
+	 * freed along with the file scope.
+	 */
+	conversation_lru_head = NULL;
+	conversation_lru_tail = NULL;
+	conversation_live_count = 0;
+	conversation_evicted_count = 0;
+
+	/*
+	 * Pick up the eviction limits here, so that they don't change
+	 * while a file is being dissected.
+	 */
+	conversation_max_count = conversation_max_count_pref;
+	conversation_idle_frames = conversation_idle_frames_pref;
+
+	/*
+	 * The hash tables have been emptied along with the file scope.
+	 */
+	memset(&conversation_guard_no_addr2, 0, sizeof conversation_guard_no_addr2);
+	memset(&conversation_guard_no_port2, 0, sizeof conversation_guard_no_port2);
+	memset(&conversation_guard_no_addr2_or_port2, 0, sizeof conversation_guard_no_addr2_or_port2);
+}
+
+/*
+ * Returns the guard for one of the conversation hash tables, or NULL
+ * for the table of exact matches, which doesn't have one.
+ */
+static conversation_guard_t *
+conversation_guard_for_hashtable(const wmem_map_t *hashtable)
+{
+	if (hashtable == conversation_hashtable_no_addr2)
+		return &conversation_guard_no_addr2;
+	if (hashtable == conversation_hashtable_no_port2)
+		return &conversation_guard_no_port2;
+	if (hashtable == conversation_hashtable_no_addr2_or_port2)
+		return &conversation_guard_no_addr2_or_port2;
+	return NULL;
+}
+
+/*
+ * Returns the guard bucket for an address 1/port 1 endpoint.
+ */
+static guint
+conversation_guard_bucket(const address *addr1, const endpoint_type etype, const guint32 port1)
+{
+	guint hash_val;
+
+	hash_val = add_address_to_hash(port1 ^ ((guint)etype << 16), addr1);
+	hash_val += ( hash_val << 3 );
+	hash_val ^= ( hash_val >> 11 );
+	hash_val += ( hash_val << 15 );
+
+	return hash_val & (CONVERSATION_GUARD_BUCKETS - 1);
+}
+
+static void
+conversation_guard_add(wmem_map_t *hashtable, const conversation_t *conv)
+{
+	conversation_guard_t *guard = conversation_guard_for_hashtable(hashtable);
+
+	if (guard == NULL)
+		return;
+	guard->count++;
+	guard->buckets[conversation_guard_bucket(&conv->key_ptr->addr1,
+	    conv->key_ptr->etype, conv->key_ptr->port1)]++;
+}
+
+static void
+conversation_guard_remove(wmem_map_t *hashtable, const conversation_t *conv)
+{
+	conversation_guard_t *guard = conversation_guard_for_hashtable(hashtable);
+
+	if (guard == NULL)
+		return;
+	guard->count--;
+	guard->buckets[conversation_guard_bucket(&conv->key_ptr->addr1,
+	    conv->key_ptr->etype, conv->key_ptr->port1)]--;
+}
+
+/*
+ * Returns the hash table that a conversation with the given options
+ * belongs in.
+ */
+static wmem_map_t *
+conversation_hashtable_for_options(const guint options)
+{
+	if (options & NO_ADDR2) {
+		if (options & (NO_PORT2|NO_PORT2_FORCE)) {
+			return conversation_hashtable_no_addr2_or_port2;
+		} else {
+			return conversation_hashtable_no_addr2;
+		}
+	} else {
+		if (options & (NO_PORT2|NO_PORT2_FORCE)) {
+			return conversation_hashtable_no_port2;
+		} else {
+			return conversation_hashtable_exact;
+		}
+	}
+}
+
+static void
+conversation_lru_unlink(conversation_t *conv)
+{
+	if (conv->lru_prev)
+		conv->lru_prev->lru_next = conv->lru_next;
+	else
+		conversation_lru_head = conv->lru_next;
+	if (conv->lru_next)
+		conv->lru_next->lru_prev = conv->lru_prev;
+	else
+		conversation_lru_tail = conv->lru_prev;
+	conv->lru_prev = NULL;
+	conv->lru_next = NULL;
+}
+
+static void
+conversation_lru_append(conversation_t *conv)
+{
+	conv->lru_prev = conversation_lru_tail;
+	conv->lru_next = NULL;
+	if (conversation_lru_tail)
+		conversation_lru_tail->lru_next = conv;
+	else
+		conversation_lru_head = conv;
+	conversation_lru_tail = conv;
+}
+
+/*
+ * Note that a conversation was created or found for a frame, making it
+ * the most recently used one.
+ */
+static void
+conversation_lru_touch(conversation_t *conv, const guint32 frame_num)
+{
+	if (!conversation_max_count && !conversation_idle_frames)
+		return;
+
+	/* Templates are never evicted, so they aren't in the list. */
+	if (conv->options & CONVERSATION_TEMPLATE)
+		return;
+
+	/* Looking up a conversation for an earlier frame doesn't count. */
+	if (frame_num < conv->lru_frame)
+		return;
+	conv->lru_frame = frame_num;
+
+	if (conv == conversation_lru_tail)
+		return;
+	if (conv == conversation_lru_head || conv->lru_prev)
+		conversation_lru_unlink(conv);
+	conversation_lru_append(conv);
 }
 
 /*
@@ -494,6 +700,8 @@ conversation_insert_into_hashtable(wmem_map_t *hashtable, conversation_t *conv)
 {
 	conversation_t *chain_head, *chain_tail, *cur, *prev;
 
+	conversation_guard_add(hashtable, conv);
+
 	chain_head = (conversation_t *)wmem_map_lookup(hashtable, conv->key_ptr);
 
 	if (NULL==chain_head) {
@@ -554,6 +762,7 @@ conversation_remove_from_hashtable(wmem_map_t *hashtable, conversation_t *conv)
 
 	if (conv == chain_head) {
 		/* We are currently the front of the chain */
+		conversation_guard_remove(hashtable, conv);
 		if (NULL == conv->next) {
 			/* We are the only conversation in the chain, no need to
 			 * update next pointer, but do not call
@@ -571,6 +780,9 @@ conversation_remove_from_hashtable(wmem_map_t *hashtable, conversation_t *conv)
 			else
 				chain_head->latest_found = conv->latest_found;
 
+			/* Re-key the entry with the new head's key, as the
+			 * removed conversation's key may be changed or freed. */
+			wmem_map_steal(hashtable, conv->key_ptr);
 			wmem_map_insert(hashtable, chain_head->key_ptr, chain_head);
 		}
 	}
@@ -589,6 +801,8 @@ conversation_remove_from_hashtable(wmem_map_t *hashtable, conversation_t *conv)
 			return;
 		}
 
+		conversation_guard_remove(hashtable, conv);
+
 		prev->next = conv->next;
 
 		if (NULL == conv->next) {
@@ -601,6 +815,73 @@ conversation_remove_from_hashtable(wmem_map_t *hashtable, conversation_t *conv)
 	}
 }
 
+/*
+ * Forget about a conversation, giving the protocols that have data
+ * attached to it a chance to free that data first.
+ *
+ * The trees holding the conversation's protocol data and dissectors are
+ * freed, unless the dissector tree is shared with a template.  The
+ * conversation_t itself and its key stay in the file scope, as
+ * dissectors may still hold pointers to it, e.g. in per-packet data of
+ * earlier frames; it's marked as evicted, so that it can't be found or
+ * put back into a hash table again, and the functions that use its
+ * trees treat them as empty.
+ */
+static void
+conversation_evict(conversation_t *conv)
+{
+	GSList *hooks;
+	conversation_release_hook_t *hook;
+	void *proto_data;
+
+	for (hooks = conversation_release_hooks; hooks != NULL; hooks = hooks->next) {
+		hook = (conversation_release_hook_t *)hooks->data;
+		proto_data = conversation_get_proto_data(conv, hook->proto);
+		if (proto_data != NULL) {
+			hook->func(conv, proto_data);
+			conversation_delete_proto_data(conv, hook->proto);
+		}
+	}
+
+	if (conv->data_list != NULL) {
+		wmem_tree_destroy(conv->data_list, FALSE, FALSE);
+		conv->data_list = NULL;
+	}
+	if (!conv->dissector_tree_shared && conv->dissector_tree != NULL) {
+		wmem_tree_destroy(conv->dissector_tree, FALSE, FALSE);
+		conv->dissector_tree = NULL;
+	}
+
+	conversation_remove_from_hashtable(conversation_hashtable_for_options(conv->options), conv);
+	conversation_lru_unlink(conv);
+	conv->evicted = TRUE;
+
+	conversation_live_count--;
+	conversation_evicted_count++;
+}
+
+/*
+ * Evict the least recently used conversations while there are too
+ * many of them, and any that haven't been used for too long.
+ *
+ * Conversations used in the current frame are never evicted, as the
+ * dissectors of that frame may still be holding on to them.
+ */
+static void
+conversation_evict_lru(const guint32 frame_num)
+{
+	conversation_t *conv;
+
+	while ((conv = conversation_lru_head) != NULL && conv->lru_frame < frame_num) {
+		if ((conversation_max_count == 0 || conversation_live_count <= conversation_max_count) &&
+		    (conversation_idle_frames == 0 || frame_num - conv->lru_frame <= conversation_idle_frames))
+			break;
+		DPRINT(("evicting conversation %u, last used in frame #%u",
+			conv->conv_index, conv->lru_frame));
+		conversation_evict(conv);
+	}
+}
+
 /*
  * Given two address/port pairs for a packet, create a new conversation
  * to contain packets between those address/port pairs.
@@ -710,19 +991,7 @@ conversation_new(const guint32 setup_frame, const address *addr1, const address
 	}
 #endif
 
-	if (options & NO_ADDR2) {
-		if (options & (NO_PORT2|NO_PORT2_FORCE)) {
-			hashtable = conversation_hashtable_no_addr2_or_port2;
-		} else {
-			hashtable = conversation_hashtable_no_addr2;
-		}
-	} else {
-		if (options & (NO_PORT2|NO_PORT2_FORCE)) {
-			hashtable = conversation_hashtable_no_port2;
-		} else {
-			hashtable = conversation_hashtable_exact;
-		}
-	}
+	hashtable = conversation_hashtable_for_options(options);
 
 	new_key = wmem_new(wmem_file_scope(), struct conversation_key);
 	if (addr1 != NULL) {
@@ -755,6 +1024,9 @@ conversation_new(const guint32 setup_frame, const address *addr1, const address
 
 	DINDENT();
 	conversation_insert_into_hashtable(hashtable, conversation);
+	conversation_live_count++;
+	conversation_lru_touch(conversation, setup_frame);
+	conversation_evict_lru(setup_frame);
 	DENDENT();
 
 	return conversation;
@@ -785,6 +1057,13 @@ conversation_set_port2(conversation_t *conv, const guint32 port)
 		return;
 
 	DINDENT();
+	/* An evicted conversation isn't in any table, and stays out. */
+	if (conv->evicted) {
+		conv->options &= ~NO_PORT2;
+		conv->key_ptr->port2  = port;
+		DENDENT();
+		return;
+	}
 	if (conv->options & NO_ADDR2) {
 		conversation_remove_from_hashtable(conversation_hashtable_no_addr2_or_port2, conv);
 	} else {
@@ -822,6 +1101,12 @@ conversation_set_addr2(conversation_t *conv, const address *addr)
 		return;
 
 	DINDENT();
+	if (conv->evicted) {
+		conv->options &= ~NO_ADDR2;
+		copy_address_wmem(wmem_file_scope(), &conv->key_ptr->addr2, addr);
+		DENDENT();
+		return;
+	}
 	if (conv->options & NO_PORT2) {
 		conversation_remove_from_hashtable(conversation_hashtable_no_addr2_or_port2, conv);
 	} else {
@@ -849,6 +1134,20 @@ conversation_lookup_hashtable(wmem_map_t *hashtable, const guint32 frame_num, co
 	conversation_t* match=NULL;
 	conversation_t* chain_head=NULL;
 	struct conversation_key key;
+	conversation_guard_t *guard;
+
+	/*
+	 * Don't bother hashing the whole key if there can't be a
+	 * wildcard conversation for address 1 and port 1.
+	 */
+	guard = conversation_guard_for_hashtable(hashtable);
+	if (guard != NULL) {
+		if (guard->count == 0)
+			return NULL;
+		if (guard->buckets[conversation_guard_bucket(addr1 != NULL ? addr1 : &null_address_,
+		    etype, port1)] == 0)
+			return NULL;
+	}
 
 	/*
 	 * We don't make a copy of the address data, we just copy the
@@ -886,8 +1185,10 @@ conversation_lookup_hashtable(wmem_map_t *hashtable, const guint32 frame_num, co
 		}
 	}
 
-	if (match)
+	if (match) {
 		chain_head->latest_found = match;
+		conversation_lru_touch(match, frame_num);
+	}
 
 	return match;
 }
@@ -1325,6 +1626,10 @@ void
 conversation_set_dissector_from_frame_number(conversation_t *conversation,
 	const guint32 starting_frame_num, const dissector_handle_t handle)
 {
+	/* An evicted conversation's tree has been freed. */
+	if (conversation->dissector_tree == NULL)
+		conversation->dissector_tree = wmem_tree_new(wmem_file_scope());
+
 	wmem_tree_insert32(conversation->dissector_tree, starting_frame_num, (void *)handle);
 }
 
@@ -1337,6 +1642,9 @@ conversation_set_dissector(conversation_t *conversation, const dissector_handle_
 dissector_handle_t
 conversation_get_dissector(conversation_t *conversation, const guint32 frame_num)
 {
+	if (conversation->dissector_tree == NULL)
+		return NULL;
+
 	return (dissector_handle_t)wmem_tree_lookup32_le(conversation->dissector_tree, frame_num);
 }
 
@@ -1344,8 +1652,7 @@ static gboolean try_conversation_call_dissector_helper(conversation_t *conversat
 					tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void* data)
 {
 	int ret;
-	dissector_handle_t handle = (dissector_handle_t)wmem_tree_lookup32_le(
-					conversation->dissector_tree, pinfo->num);
+	dissector_handle_t handle = conversation_get_dissector(conversation, pinfo->num);
 	if (handle == NULL)
 		return FALSE;
 
@@ -1421,7 +1728,7 @@ try_conversation_dissector_by_id(const endpoint_type etype, const guint32 id, tv
 	if (conversation != NULL) {
 		int ret;
 
-		dissector_handle_t handle = (dissector_handle_t)wmem_tree_lookup32_le(conversation->dissector_tree, pinfo->num);
+		dissector_handle_t handle = conversation_get_dissector(conversation, pinfo->num);
 		if (handle == NULL)
 			return FALSE;
 		ret = call_dissector_only(handle, tvb, pinfo, tree, data);
@@ -1564,6 +1871,36 @@ guint32 conversation_get_endpoint_by_id(struct _packet_info *pinfo, endpoint_typ
 	return pinfo->conv_endpoint->port1;
 }
 
+void
+conversation_set_eviction(const guint max_conversations, const guint32 idle_frames)
+{
+	conversation_max_count_pref = max_conversations;
+	conversation_idle_frames_pref = idle_frames;
+}
+
+guint
+conversation_get_live_count(void)
+{
+	return conversation_live_count;
+}
+
+guint64
+conversation_get_evicted_count(void)
+{
+	return conversation_evicted_count;
+}
+
+void
+conversation_register_release_hook(const int proto, conversation_release_func func)
+{
+	conversation_release_hook_t *hook;
+
+	hook = g_new(conversation_release_hook_t, 1);
+	hook->proto = proto;
+	hook->func = func;
+	conversation_release_hooks = g_slist_append(conversation_release_hooks, hook);
+}
+
 wmem_map_t *
 get_conversation_hashtable_exact(void)
 {
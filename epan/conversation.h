@@ -103,6 +103,11 @@ typedef struct conversation {
 	wmem_tree_t *dissector_tree;	/** tree containing protocol dissector client associated with conversation */
 	guint	options;		/** wildcard flags */
 	conversation_key_t key_ptr;	/** pointer to the key for this conversation */
+	struct conversation *lru_prev;	/** previous conversation in least recently used order */
+	struct conversation *lru_next;	/** next conversation in least recently used order */
+	guint32 lru_frame;		/** highest frame number this conversation was created or found for */
+	gboolean evicted;		/** removed from the hash tables by conversation_set_eviction() limits */
+	gboolean dissector_tree_shared;	/** dissector_tree is that of the template this conversation was created from */
 } conversation_t;
 
 
@@ -246,6 +251,61 @@ void conversation_set_port2(conversation_t *conv, const guint32 port);
 WS_DLL_PUBLIC
 void conversation_set_addr2(conversation_t *conv, const address *addr);
 
+/**
+ * Limit the number of conversations kept in memory, for long-running
+ * single-pass dissection such as a live capture with TShark.
+ *
+ * When a new conversation is created, the least recently created or
+ * found conversations are evicted while there are more than
+ * max_conversations of them, as are those that haven't been created
+ * or found in the last idle_frames frames.  Conversations used in the
+ * current frame, and conversations created with CONVERSATION_TEMPLATE,
+ * are never evicted.
+ *
+ * An evicted conversation is removed from the hash tables, and the
+ * release hooks registered with conversation_register_release_hook()
+ * free the protocol data attached to it.  Its protocol data and
+ * dissector trees are then freed; data of protocols without a release
+ * hook is only freed along with the file scope.  The conversation_t
+ * itself and its key stay valid until the file is closed, with the
+ * evicted flag set, as dissectors may still hold pointers to it.
+ *
+ * An evicted conversation can't be found again; if more packets turn up
+ * for it, a new conversation is created.  This is therefore only safe
+ * if packets aren't dissected again after the first pass.
+ *
+ * The limits take effect when the next file is opened.
+ *
+ * @param max_conversations The most conversations to keep, or 0 for
+ * no limit.
+ * @param idle_frames How many frames a conversation is kept without
+ * being used, or 0 for no limit.
+ */
+WS_DLL_PUBLIC void conversation_set_eviction(const guint max_conversations, const guint32 idle_frames);
+
+/** Number of conversations currently kept for the current file. */
+WS_DLL_PUBLIC guint conversation_get_live_count(void);
+
+/** Number of conversations of the current file that have been evicted
+ * because of the limits set with conversation_set_eviction(). */
+WS_DLL_PUBLIC guint64 conversation_get_evicted_count(void);
+
+/**
+ * Routine called for a protocol's data when a conversation that has
+ * data for that protocol is about to be evicted.  It should free the
+ * data and anything else the protocol keeps for the conversation; it
+ * must not keep pointers to the conversation.
+ */
+typedef void (*conversation_release_func)(conversation_t *conv, void *proto_data);
+
+/**
+ * Register a routine to be called for a protocol's conversation data
+ * when a conversation is evicted because of the limits set with
+ * conversation_set_eviction().  Typically called from a dissector's
+ * proto_register_XXX routine.
+ */
+WS_DLL_PUBLIC void conversation_register_release_hook(const int proto, conversation_release_func func);
+
 WS_DLL_PUBLIC
 wmem_map_t *get_conversation_hashtable_exact(void);
 
@@ -0,0 +1,398 @@
+/* conversation_test.c
+ * Standalone program to test the conversation lookup routines, and to
+ * time them with many short-lived flows.
+ *
+ * Run "conversation_test --benchmark [<flow count>]" for the timings.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include <epan/address.h>
+#include <epan/conversation.h>
+#include <epan/wmem_scopes.h>
+
+static const guint8 client_ip[4] = { 192, 168, 0, 1 };
+static const guint8 server_ip[4] = { 192, 168, 0, 2 };
+static const guint8 other_ip[4]  = { 192, 168, 0, 3 };
+
+static address client_addr;
+static address server_addr;
+static address other_addr;
+
+/* Start over as if a new file had been opened. */
+static void
+conversation_test_new_file(void)
+{
+    wmem_leave_file_scope();
+    wmem_enter_file_scope();
+    conversation_epan_reset();
+}
+
+static void
+conversation_test_exact(void)
+{
+    conversation_t *conv;
+
+    conversation_test_new_file();
+
+    conv = conversation_new(1, &client_addr, &server_addr, ENDPOINT_UDP, 1024, 53, 0);
+    g_assert_true(find_conversation(2, &client_addr, &server_addr, ENDPOINT_UDP, 1024, 53, 0) == conv);
+    /* The other direction. */
+    g_assert_true(find_conversation(3, &server_addr, &client_addr, ENDPOINT_UDP, 53, 1024, 0) == conv);
+    /* Not before it was set up. */
+    g_assert_null(find_conversation(0, &client_addr, &server_addr, ENDPOINT_UDP, 1024, 53, 0));
+    /* Nor for another port, address or endpoint type. */
+    g_assert_null(find_conversation(2, &client_addr, &server_addr, ENDPOINT_UDP, 1025, 53, 0));
+    g_assert_null(find_conversation(2, &client_addr, &other_addr, ENDPOINT_UDP, 1024, 53, 0));
+    g_assert_null(find_conversation(2, &client_addr, &server_addr, ENDPOINT_TCP, 1024, 53, 0));
+    g_assert_cmpuint(conversation_get_live_count(), ==, 1);
+}
+
+static void
+conversation_test_wildcard(void)
+{
+    conversation_t *conv;
+
+    conversation_test_new_file();
+
+    /* Expect a connection from the server to any port on the client. */
+    conv = conversation_new(1, &server_addr, &client_addr, ENDPOINT_UDP, 20, 0, NO_PORT2);
+    g_assert_true(find_conversation(2, &server_addr, &client_addr, ENDPOINT_UDP, 20, 4000, 0) == conv);
+    g_assert_true(find_conversation(3, &client_addr, &server_addr, ENDPOINT_UDP, 4001, 20, 0) == conv);
+    g_assert_null(find_conversation(4, &server_addr, &client_addr, ENDPOINT_UDP, 21, 4000, 0));
+    g_assert_null(find_conversation(4, &other_addr, &client_addr, ENDPOINT_UDP, 20, 4000, 0));
+
+    /* Any address and port. */
+    conv = conversation_new(5, &server_addr, NULL, ENDPOINT_UDP, 69, 0, NO_ADDR2|NO_PORT2);
+    g_assert_true(find_conversation(6, &server_addr, &other_addr, ENDPOINT_UDP, 69, 5000, 0) == conv);
+    g_assert_true(find_conversation(7, &other_addr, &server_addr, ENDPOINT_UDP, 5000, 69, 0) == conv);
+    g_assert_null(find_conversation(8, &other_addr, &client_addr, ENDPOINT_UDP, 5000, 69, 0));
+}
+
+static void
+conversation_test_set_port2(void)
+{
+    conversation_t *conv, *conv2;
+
+    conversation_test_new_file();
+
+    /*
+     * Filling in the wildcard port moves the conversation to the table
+     * of exact matches.
+     */
+    conv = conversation_new(1, &server_addr, &client_addr, ENDPOINT_TCP, 20, 0, NO_PORT2);
+    g_assert_true(find_conversation(2, &server_addr, &client_addr, ENDPOINT_TCP, 20, 4000, 0) == conv);
+    conversation_set_port2(conv, 4000);
+    g_assert_false(conv->options & NO_PORT2);
+    g_assert_null(find_conversation(3, &server_addr, &client_addr, ENDPOINT_TCP, 20, 4001, 0));
+    g_assert_true(find_conversation(4, &client_addr, &server_addr, ENDPOINT_TCP, 4000, 20, 0) == conv);
+
+    /* A new wildcard conversation for the same endpoint. */
+    conv2 = conversation_new(5, &server_addr, &client_addr, ENDPOINT_TCP, 20, 0, NO_PORT2);
+    g_assert_true(find_conversation(6, &server_addr, &client_addr, ENDPOINT_TCP, 20, 4001, 0) == conv2);
+    g_assert_true(find_conversation(7, &server_addr, &client_addr, ENDPOINT_TCP, 20, 4000, 0) == conv);
+}
+
+/* A stand-in protocol with a release hook, for the eviction tests. */
+#define TEST_PROTO 1
+
+static guint release_count;
+
+static void
+conversation_test_release(conversation_t *conv, void *proto_data)
+{
+    g_assert_true(conversation_get_proto_data(conv, TEST_PROTO) == proto_data);
+    g_assert_false(conv->evicted);
+    release_count++;
+}
+
+static void
+conversation_test_eviction(void)
+{
+    conversation_t *conv;
+    guint32 i;
+
+    conversation_set_eviction(10, 0);
+    conversation_test_new_file();
+
+    for (i = 1; i <= 100; i++) {
+        conv = conversation_new(i, &client_addr, &server_addr, ENDPOINT_UDP, i, 53, 0);
+        g_assert_nonnull(conv);
+    }
+    g_assert_cmpuint(conversation_get_live_count(), ==, 10);
+    g_assert_cmpuint(conversation_get_evicted_count(), ==, 90);
+    g_assert_null(find_conversation(101, &client_addr, &server_addr, ENDPOINT_UDP, 1, 53, 0));
+    g_assert_nonnull(find_conversation(101, &client_addr, &server_addr, ENDPOINT_UDP, 100, 53, 0));
+
+    /*
+     * Finding a conversation keeps it from being evicted: of the ten
+     * left, 91 was used last, so it's the last to go.
+     */
+    g_assert_nonnull(find_conversation(102, &client_addr, &server_addr, ENDPOINT_UDP, 91, 53, 0));
+    for (i = 103; i <= 111; i++)
+        conversation_new(i, &client_addr, &server_addr, ENDPOINT_UDP, i, 53, 0);
+    g_assert_nonnull(find_conversation(112, &client_addr, &server_addr, ENDPOINT_UDP, 91, 53, 0));
+    g_assert_null(find_conversation(112, &client_addr, &server_addr, ENDPOINT_UDP, 100, 53, 0));
+
+    conversation_set_eviction(0, 0);
+}
+
+static void
+conversation_test_eviction_idle(void)
+{
+    conversation_set_eviction(0, 5);
+    conversation_test_new_file();
+
+    /* Evicting a wildcard conversation forgets it. */
+    conversation_new(1, &server_addr, &client_addr, ENDPOINT_UDP, 20, 0, NO_PORT2);
+    g_assert_nonnull(find_conversation(2, &server_addr, &client_addr, ENDPOINT_UDP, 20, 4000, 0));
+    conversation_new(10, &client_addr, &server_addr, ENDPOINT_UDP, 1024, 53, 0);
+    g_assert_null(find_conversation(11, &server_addr, &client_addr, ENDPOINT_UDP, 20, 4000, 0));
+    g_assert_cmpuint(conversation_get_evicted_count(), ==, 1);
+
+    /* A conversation used in the current frame is kept however idle it is. */
+    conversation_new(12, &client_addr, &other_addr, ENDPOINT_UDP, 1024, 53, 0);
+    g_assert_nonnull(find_conversation(100, &client_addr, &other_addr, ENDPOINT_UDP, 1024, 53, 0));
+    conversation_new(100, &client_addr, &server_addr, ENDPOINT_UDP, 1025, 53, 0);
+    g_assert_nonnull(find_conversation(100, &client_addr, &other_addr, ENDPOINT_UDP, 1024, 53, 0));
+    g_assert_cmpuint(conversation_get_evicted_count(), ==, 2);
+
+    conversation_set_eviction(0, 0);
+}
+
+/*
+ * An evicted conversation has its protocol data released and its trees
+ * freed, but stays valid until the file is closed, for dissectors still
+ * pointing at it.
+ */
+static void
+conversation_test_eviction_keeps_conversation(void)
+{
+    conversation_t *conv, *wild, *conv2;
+    static int proto_data, other_proto_data;
+    static int dummy_handle;
+    dissector_handle_t handle = (dissector_handle_t)&dummy_handle;
+
+    conversation_set_eviction(1, 0);
+    conversation_test_new_file();
+    release_count = 0;
+
+    conv = conversation_new(1, &client_addr, &server_addr, ENDPOINT_UDP, 1024, 53, 0);
+    conversation_add_proto_data(conv, TEST_PROTO, &proto_data);
+    conversation_add_proto_data(conv, TEST_PROTO + 1, &other_proto_data);
+    conversation_set_dissector(conv, handle);
+    wild = conversation_new(2, &server_addr, &client_addr, ENDPOINT_UDP, 20, 0, NO_PORT2);
+
+    g_assert_cmpuint(release_count, ==, 1);
+    g_assert_true(conv->evicted);
+    g_assert_null(conv->data_list);
+    g_assert_null(conv->dissector_tree);
+    g_assert_null(conversation_get_proto_data(conv, TEST_PROTO));
+    g_assert_null(conversation_get_proto_data(conv, TEST_PROTO + 1));
+    g_assert_null(conversation_get_dissector(conv, 2));
+    conversation_set_dissector(conv, handle);
+    g_assert_true(conversation_get_dissector(conv, 2) == handle);
+    g_assert_cmpuint(conv->setup_frame, ==, 1);
+    g_assert_cmpuint(conv->key_ptr->port1, ==, 1024);
+    g_assert_null(find_conversation(3, &client_addr, &server_addr, ENDPOINT_UDP, 1024, 53, 0));
+
+    /* Once evicted, a conversation isn't put back into a table. */
+    conv2 = conversation_new(3, &client_addr, &server_addr, ENDPOINT_UDP, 1025, 53, 0);
+    g_assert_true(wild->evicted);
+    conversation_set_port2(wild, 4000);
+    g_assert_cmpuint(wild->key_ptr->port2, ==, 4000);
+    g_assert_null(find_conversation(4, &server_addr, &client_addr, ENDPOINT_UDP, 20, 4000, 0));
+    g_assert_true(find_conversation(4, &client_addr, &server_addr, ENDPOINT_UDP, 1025, 53, 0) == conv2);
+    g_assert_cmpuint(conversation_get_live_count(), ==, 1);
+    g_assert_cmpuint(conversation_get_evicted_count(), ==, 2);
+
+    conversation_set_eviction(0, 0);
+}
+
+/*
+ * Conversations created from a template share its dissector tree, so
+ * evicting one of them mustn't free it or take the dissector away from
+ * the template or from the others.  Templates themselves are never
+ * evicted.
+ */
+static void
+conversation_test_eviction_template(void)
+{
+    conversation_t *tmpl, *child1, *child2, *child3;
+    static int dummy_handle;
+    dissector_handle_t handle = (dissector_handle_t)&dummy_handle;
+
+    conversation_set_eviction(1, 0);
+    conversation_test_new_file();
+
+    /* Expect connections from the server to any port on the client. */
+    tmpl = conversation_new(1, &server_addr, &client_addr, ENDPOINT_TCP, 21, 0,
+                            NO_PORT2|CONVERSATION_TEMPLATE);
+    conversation_set_dissector(tmpl, handle);
+
+    child1 = find_conversation(2, &server_addr, &client_addr, ENDPOINT_TCP, 21, 4000, 0);
+    g_assert_nonnull(child1);
+    g_assert_true(child1 != tmpl);
+    g_assert_true(child1->dissector_tree == tmpl->dissector_tree);
+    g_assert_true(conversation_get_dissector(child1, 2) == handle);
+
+    /* child2 evicts child1, while child2 and the template stay live. */
+    child2 = find_conversation(3, &server_addr, &client_addr, ENDPOINT_TCP, 21, 4001, 0);
+    g_assert_nonnull(child2);
+    g_assert_true(child1->evicted);
+    g_assert_false(child2->evicted);
+    g_assert_false(tmpl->evicted);
+    g_assert_true(conversation_get_dissector(tmpl, 3) == handle);
+    g_assert_true(conversation_get_dissector(child2, 3) == handle);
+
+    /*
+     * An unrelated conversation in a later frame evicts child2 as well;
+     * the template, both evicted children and a new child made from the
+     * template still have the dissector.
+     */
+    conversation_new(4, &client_addr, &other_addr, ENDPOINT_UDP, 1024, 53, 0);
+    g_assert_true(child2->evicted);
+    g_assert_false(tmpl->evicted);
+    g_assert_true(conversation_get_dissector(tmpl, 5) == handle);
+    g_assert_true(conversation_get_dissector(child1, 5) == handle);
+    g_assert_true(conversation_get_dissector(child2, 5) == handle);
+    child3 = find_conversation(5, &server_addr, &client_addr, ENDPOINT_TCP, 21, 4000, 0);
+    g_assert_nonnull(child3);
+    g_assert_true(child3 != child1);
+    g_assert_true(conversation_get_dissector(child3, 5) == handle);
+
+    conversation_set_eviction(0, 0);
+}
+
+/*
+ * Time creating conversations for many short UDP flows, the way the UDP
+ * dissector does: look the flow up, create a conversation if that
+ * fails, and find it again for the rest of the flow's packets.
+ */
+static void
+conversation_benchmark_flows(guint32 num_flows, gboolean with_wildcards)
+{
+    guint8 src_ip[4], dst_ip[4];
+    address src_addr, dst_addr;
+    guint32 frame_num = 1;
+    guint32 flow, found = 0;
+    guint32 src_port;
+    gint64 start, elapsed;
+    int pkt;
+
+    conversation_test_new_file();
+    if (with_wildcards) {
+        /* Some expected connections, as set up by e.g. SIP or FTP. */
+        for (flow = 0; flow < 64; flow++) {
+            src_ip[0] = 172; src_ip[1] = 16; src_ip[2] = 0; src_ip[3] = (guint8)flow;
+            set_address(&src_addr, AT_IPv4, 4, src_ip);
+            conversation_new(frame_num++, &src_addr, NULL, ENDPOINT_UDP, 5004, 0, NO_ADDR2|NO_PORT2);
+            conversation_new(frame_num++, &src_addr, &server_addr, ENDPOINT_UDP, 5006, 0, NO_PORT2);
+            conversation_new(frame_num++, &src_addr, NULL, ENDPOINT_UDP, 5008, 5060, NO_ADDR2);
+        }
+    }
+
+    start = g_get_monotonic_time();
+    for (flow = 0; flow < num_flows; flow++) {
+        src_ip[0] = 10;
+        src_ip[1] = (guint8)(flow >> 16);
+        src_ip[2] = (guint8)(flow >> 8);
+        src_ip[3] = (guint8)flow;
+        dst_ip[0] = 10; dst_ip[1] = 255; dst_ip[2] = 0; dst_ip[3] = (guint8)(flow % 7);
+        src_port = 1024 + flow % 60000;
+        set_address(&src_addr, AT_IPv4, 4, src_ip);
+        set_address(&dst_addr, AT_IPv4, 4, dst_ip);
+
+        /* A query and its response. */
+        if (find_conversation(frame_num, &src_addr, &dst_addr, ENDPOINT_UDP, src_port, 53, 0) == NULL)
+            conversation_new(frame_num, &src_addr, &dst_addr, ENDPOINT_UDP, src_port, 53, 0);
+        frame_num++;
+        for (pkt = 0; pkt < 3; pkt++) {
+            if (find_conversation(frame_num, &dst_addr, &src_addr, ENDPOINT_UDP, 53, src_port, 0) != NULL)
+                found++;
+            frame_num++;
+        }
+    }
+    elapsed = g_get_monotonic_time() - start;
+
+    printf("%u flows, %s wildcard conversations: %" G_GINT64_FORMAT " us, %.1f ns per packet"
+           " (%u found, %u kept, %" G_GUINT64_FORMAT " evicted)\n",
+           num_flows, with_wildcards ? "with" : "without", elapsed,
+           elapsed * 1000.0 / ((gint64)num_flows * 4), found,
+           conversation_get_live_count(), conversation_get_evicted_count());
+}
+
+static void
+conversation_benchmark(guint32 num_flows)
+{
+    conversation_benchmark_flows(num_flows, FALSE);
+    conversation_benchmark_flows(num_flows, TRUE);
+
+    /* The same, evicting conversations the way a long-running capture would. */
+    conversation_set_eviction(100000, 0);
+    conversation_benchmark_flows(num_flows, FALSE);
+    conversation_benchmark_flows(num_flows, TRUE);
+    conversation_set_eviction(0, 0);
+}
+
+int
+main(int argc, char **argv)
+{
+    int result = 0;
+
+    set_address(&client_addr, AT_IPv4, 4, client_ip);
+    set_address(&server_addr, AT_IPv4, 4, server_ip);
+    set_address(&other_addr, AT_IPv4, 4, other_ip);
+
+    wmem_init_scopes();
+    wmem_enter_file_scope();
+    conversation_init();
+    conversation_epan_reset();
+    conversation_register_release_hook(TEST_PROTO, conversation_test_release);
+
+    if (argc > 1 && strcmp(argv[1], "--benchmark") == 0) {
+        conversation_benchmark(argc > 2 ? (guint32)strtoul(argv[2], NULL, 10) : 1000000);
+    } else {
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/conversation/exact", conversation_test_exact);
+        g_test_add_func("/conversation/wildcard", conversation_test_wildcard);
+        g_test_add_func("/conversation/set_port2", conversation_test_set_port2);
+        g_test_add_func("/conversation/eviction", conversation_test_eviction);
+        g_test_add_func("/conversation/eviction_idle", conversation_test_eviction_idle);
+        g_test_add_func("/conversation/eviction_keeps_conversation", conversation_test_eviction_keeps_conversation);
+        g_test_add_func("/conversation/eviction_template", conversation_test_eviction_template);
+
+        result = g_test_run();
+    }
+
+    wmem_leave_file_scope();
+    wmem_cleanup_scopes();
+
+    return result;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
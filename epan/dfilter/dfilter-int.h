@@ -19,11 +19,14 @@
 struct epan_dfilter {
 	GPtrArray	*insns;
 	GPtrArray	*consts;
+	guint		num_unoptimized_insns;
 	guint		num_registers;
 	guint		max_registers;
 	GList		**registers;
 	gboolean	*attempted_load;
 	gboolean	*owns_memory;
+	GList		**list_nodes;	/* reused list nodes for field registers */
+	guint		*list_nodes_len;
 	int		*interesting_fields;
 	int		num_interesting_fields;
 	GPtrArray	*deprecated;
@@ -40,6 +43,7 @@ typedef struct {
 	GHashTable	*interesting_fields;
 	int		next_insn_id;
 	int		next_const_id;
+	guint		num_unoptimized_insns; /* before redundant loads are removed */
 	int		next_register;
 	int		first_constant; /* first register used as a constant */
 	GPtrArray	*deprecated;
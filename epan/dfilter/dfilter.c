@@ -233,12 +233,18 @@ dfilter_free(dfilter_t *df)
 		g_list_free(df->registers[i]);
 	}
 
+	for (i = 0; i < df->num_registers; i++) {
+		g_free(df->list_nodes[i]);
+	}
+
 	if (df->deprecated)
 		g_ptr_array_unref(df->deprecated);
 
 	g_free(df->registers);
 	g_free(df->attempted_load);
 	g_free(df->owns_memory);
+	g_free(df->list_nodes);
+	g_free(df->list_nodes_len);
 	g_free(df);
 }
 
@@ -464,6 +470,7 @@ dfilter_compile(const gchar *text, dfilter_t **dfp, gchar **err_msg)
 		dfilter = dfilter_new(dfw->deprecated);
 		dfilter->insns = dfw->insns;
 		dfilter->consts = dfw->consts;
+		dfilter->num_unoptimized_insns = dfw->num_unoptimized_insns;
 		dfw->insns = NULL;
 		dfw->consts = NULL;
 		dfilter->interesting_fields = dfw_interesting_fields(dfw,
@@ -475,10 +482,18 @@ dfilter_compile(const gchar *text, dfilter_t **dfp, gchar **err_msg)
 		dfilter->registers = g_new0(GList*, dfilter->max_registers);
 		dfilter->attempted_load = g_new0(gboolean, dfilter->max_registers);
 		dfilter->owns_memory = g_new0(gboolean, dfilter->max_registers);
+		dfilter->list_nodes = g_new0(GList*, dfilter->max_registers);
+		dfilter->list_nodes_len = g_new0(guint, dfilter->max_registers);
 
 		/* Initialize constants */
 		dfvm_init_const(dfilter);
 
+		/* Use the specialized instructions where possible; setting
+		 * WIRESHARK_DFILTER_NO_SPECIALIZE allows comparing against the
+		 * generic ones. */
+		if (g_getenv("WIRESHARK_DFILTER_NO_SPECIALIZE") == NULL)
+			dfvm_specialize(dfilter);
+
 		/* And give it to the user. */
 		*dfp = dfilter;
 	}
@@ -536,6 +551,22 @@ dfilter_prime_proto_tree(const dfilter_t *df, proto_tree *tree)
 	}
 }
 
+void
+dfilter_add_interesting_fields(const dfilter_t *df, GArray *hfids)
+{
+	int i;
+	guint j;
+
+	for (i = 0; i < df->num_interesting_fields; i++) {
+		for (j = 0; j < hfids->len; j++) {
+			if (g_array_index(hfids, int, j) == df->interesting_fields[i])
+				break;
+		}
+		if (j == hfids->len)
+			g_array_append_val(hfids, df->interesting_fields[i]);
+	}
+}
+
 gboolean
 dfilter_has_interesting_fields(const dfilter_t *df)
 {
@@ -568,6 +599,13 @@ dfilter_dump(dfilter_t *df)
 	}
 }
 
+void
+dfilter_get_insn_counts(const dfilter_t *df, guint *unoptimized, guint *optimized)
+{
+	*unoptimized = df->num_unoptimized_insns;
+	*optimized = df->insns->len;
+}
+
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
  *
@@ -68,6 +68,13 @@ dfilter_apply(dfilter_t *df, proto_tree *tree);
 void
 dfilter_prime_proto_tree(const dfilter_t *df, proto_tree *tree);
 
+/* Add the fields/protocols used in a dfilter to an array of field IDs
+ * (ints), skipping those that are already in it. Priming a proto_tree with
+ * the result for several filters does the work once per field instead of
+ * once per filter. */
+void
+dfilter_add_interesting_fields(const dfilter_t *df, GArray *hfids);
+
 /* Check if dfilter has interesting fields */
 gboolean
 dfilter_has_interesting_fields(const dfilter_t *df);
@@ -81,6 +88,12 @@ WS_DLL_PUBLIC
 void
 dfilter_dump(dfilter_t *df);
 
+/* Get the number of bytecode instructions in dfilter before and after
+ * optimization */
+WS_DLL_PUBLIC
+void
+dfilter_get_insn_counts(const dfilter_t *df, guint *unoptimized, guint *optimized);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
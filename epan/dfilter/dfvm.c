@@ -10,6 +10,8 @@
 
 #include "dfvm.h"
 
+#include <stdlib.h>
+
 #include <ftypes/ftypes-int.h>
 #include <wsutil/ws_assert.h>
 
@@ -40,6 +42,12 @@ dfvm_value_free(dfvm_value_t *v)
 		case PCRE:
 			fvalue_regex_free(v->value.pcre);
 			break;
+		case FVALUE_SET:
+			g_ptr_array_free(v->value.fvalue_set->values, TRUE);
+			g_free(v->value.fvalue_set->low);
+			g_free(v->value.fvalue_set->high);
+			g_free(v->value.fvalue_set);
+			break;
 		default:
 			/* nothing */
 			;
@@ -77,6 +85,147 @@ dfvm_value_new(dfvm_value_type_t type)
 }
 
 
+static int
+fvalue_set_cmp_order(const fvalue_t *a, const fvalue_t *b)
+{
+	return a->ftype->cmp_order(a, b);
+}
+
+/* Whether the values of fv's type are totally ordered by cmp_order, so
+ * that a sorted set of them can be binary searched. Addresses only are
+ * if they don't have a mask or prefix. */
+gboolean
+dfvm_fvalue_set_can_hold(fvalue_t *fv)
+{
+	switch (fvalue_type_ftenum(fv)) {
+		case FT_CHAR:
+		case FT_UINT8:
+		case FT_UINT16:
+		case FT_UINT24:
+		case FT_UINT32:
+		case FT_UINT40:
+		case FT_UINT48:
+		case FT_UINT56:
+		case FT_UINT64:
+		case FT_INT8:
+		case FT_INT16:
+		case FT_INT24:
+		case FT_INT32:
+		case FT_INT40:
+		case FT_INT48:
+		case FT_INT56:
+		case FT_INT64:
+		case FT_FRAMENUM:
+		case FT_IPXNET:
+		case FT_EUI64:
+		case FT_ETHER:
+		case FT_BYTES:
+		case FT_STRING:
+		case FT_STRINGZ:
+		case FT_UINT_STRING:
+		case FT_STRINGZPAD:
+		case FT_STRINGZTRUNC:
+			return TRUE;
+		case FT_IPv4:
+			return fv->value.ipv4.nmask == 0xffffffff;
+		case FT_IPv6:
+			return fv->value.ipv6.prefix == 128;
+		default:
+			return FALSE;
+	}
+}
+
+static void
+fvalue_set_free_value(gpointer data)
+{
+	fvalue_t *fv = (fvalue_t *)data;
+
+	/* Single values have a NULL upper bound. */
+	if (fv) {
+		FVALUE_FREE(fv);
+	}
+}
+
+typedef struct {
+	fvalue_t	*low;
+	fvalue_t	*high;
+} fvalue_interval_t;
+
+static int
+compare_interval_low(gconstpointer a, gconstpointer b)
+{
+	return fvalue_set_cmp_order(((const fvalue_interval_t *)a)->low,
+			((const fvalue_interval_t *)b)->low);
+}
+
+/* Makes a set out of the (lower bound, upper bound or NULL) pairs in
+ * values, all of which must be of the same type and satisfy
+ * dfvm_fvalue_set_can_hold(). The set takes ownership of values. */
+dfvm_fvalue_set_t *
+dfvm_fvalue_set_new(GPtrArray *values)
+{
+	dfvm_fvalue_set_t	*set;
+	fvalue_interval_t	*intervals;
+	guint			i, n;
+
+	ws_assert(values->len > 0 && values->len % 2 == 0);
+
+	set = g_new(dfvm_fvalue_set_t, 1);
+	set->ftype = fvalue_type_ftenum((fvalue_t *)g_ptr_array_index(values, 0));
+	set->values = values;
+	g_ptr_array_set_free_func(values, fvalue_set_free_value);
+
+	/* Empty ranges can never match, leave them out. */
+	intervals = g_new(fvalue_interval_t, values->len / 2);
+	for (i = 0, n = 0; i < values->len; i += 2) {
+		intervals[n].low = (fvalue_t *)g_ptr_array_index(values, i);
+		intervals[n].high = (fvalue_t *)g_ptr_array_index(values, i + 1);
+		if (intervals[n].high == NULL)
+			intervals[n].high = intervals[n].low;
+		else if (fvalue_set_cmp_order(intervals[n].low, intervals[n].high) > 0)
+			continue;
+		n++;
+	}
+
+	qsort(intervals, n, sizeof (fvalue_interval_t), compare_interval_low);
+
+	/* Merge overlapping intervals. */
+	set->low = g_new(fvalue_t *, n);
+	set->high = g_new(fvalue_t *, n);
+	set->len = 0;
+	for (i = 0; i < n; i++) {
+		if (set->len > 0 &&
+		    fvalue_set_cmp_order(intervals[i].low, set->high[set->len - 1]) <= 0) {
+			if (fvalue_set_cmp_order(intervals[i].high, set->high[set->len - 1]) > 0)
+				set->high[set->len - 1] = intervals[i].high;
+			continue;
+		}
+		set->low[set->len] = intervals[i].low;
+		set->high[set->len] = intervals[i].high;
+		set->len++;
+	}
+	g_free(intervals);
+
+	return set;
+}
+
+static const char *
+int_cmp_op_name(dfvm_opcode_t op)
+{
+	switch (op) {
+		case ANY_EQ:	return "ANY_EQ";
+		case ALL_NE:	return "ALL_NE";
+		case ANY_NE:	return "ANY_NE";
+		case ANY_GT:	return "ANY_GT";
+		case ANY_GE:	return "ANY_GE";
+		case ANY_LT:	return "ANY_LT";
+		case ANY_LE:	return "ANY_LE";
+		default:	break;
+	}
+	ws_assert_not_reached();
+	return NULL;
+}
+
 void
 dfvm_dump(FILE *f, dfilter_t *df)
 {
@@ -130,6 +279,8 @@ dfvm_dump(FILE *f, dfilter_t *df)
 			case ANY_CONTAINS:
 			case ANY_MATCHES:
 			case ANY_IN_RANGE:
+			case INT_CMP:
+			case ANY_IN_SET:
 			case NOT:
 			case RETURN:
 			case IF_TRUE_GOTO:
@@ -280,6 +431,19 @@ dfvm_dump(FILE *f, dfilter_t *df)
 					arg3->value.numeric);
 				break;
 
+			case ANY_IN_SET:
+				fprintf(f, "%05d ANY_IN_SET\treg#%u in set of %u <%s> intervals\n",
+					id, arg1->value.numeric,
+					arg2->value.fvalue_set->len,
+					ftype_name(arg2->value.fvalue_set->ftype));
+				break;
+
+			case INT_CMP:
+				fprintf(f, "%05d INT_CMP\t\t%s reg#%u, reg#%u\n",
+					id, int_cmp_op_name((dfvm_opcode_t)arg3->value.numeric),
+					arg1->value.numeric, arg2->value.numeric);
+				break;
+
 			case NOT:
 				fprintf(f, "%05d NOT\n", id);
 				break;
@@ -306,15 +470,19 @@ dfvm_dump(FILE *f, dfilter_t *df)
 }
 
 /* Reads a field from the proto_tree and loads the fvalues into a register,
- * if that field has not already been read. */
+ * if that field has not already been read.
+ *
+ * The list in the register is built in an array of list nodes that belongs
+ * to the register and is reused for every packet, rather than allocating
+ * a node per value. */
 static gboolean
 read_tree(dfilter_t *df, proto_tree *tree, header_field_info *hfinfo, int reg)
 {
 	GPtrArray	*finfos;
 	field_info	*finfo;
-	int		i, len;
-	GList		*fvalues = NULL;
-	gboolean	found_something = FALSE;
+	header_field_info *hf;
+	GList		*nodes;
+	guint		i, count, n;
 
 	/* Already loaded in this run of the dfilter? */
 	if (df->attempted_load[reg]) {
@@ -328,30 +496,42 @@ read_tree(dfilter_t *df, proto_tree *tree, header_field_info *hfinfo, int reg)
 
 	df->attempted_load[reg] = TRUE;
 
-	while (hfinfo) {
-		finfos = proto_get_finfo_ptr_array(tree, hfinfo->id);
-		if ((finfos == NULL) || (g_ptr_array_len(finfos) == 0)) {
-			hfinfo = hfinfo->same_name_next;
-			continue;
-		}
-		else {
-			found_something = TRUE;
-		}
+	count = 0;
+	for (hf = hfinfo; hf; hf = hf->same_name_next) {
+		finfos = proto_get_finfo_ptr_array(tree, hf->id);
+		if (finfos != NULL)
+			count += g_ptr_array_len(finfos);
+	}
 
-		len = finfos->len;
-		for (i = 0; i < len; i++) {
+	if (count == 0) {
+		return FALSE;
+	}
+
+	if (count > df->list_nodes_len[reg]) {
+		g_free(df->list_nodes[reg]);
+		df->list_nodes[reg] = g_new(GList, count);
+		df->list_nodes_len[reg] = count;
+	}
+	nodes = df->list_nodes[reg];
+
+	/* Fill the list back to front, which gives the values in the
+	 * order that prepending them one by one would. */
+	n = count;
+	for (hf = hfinfo; hf; hf = hf->same_name_next) {
+		finfos = proto_get_finfo_ptr_array(tree, hf->id);
+		if (finfos == NULL)
+			continue;
+		for (i = 0; i < finfos->len; i++) {
 			finfo = (field_info *)g_ptr_array_index(finfos, i);
-			fvalues = g_list_prepend(fvalues, &finfo->value);
+			nodes[--n].data = &finfo->value;
 		}
-
-		hfinfo = hfinfo->same_name_next;
 	}
-
-	if (!found_something) {
-		return FALSE;
+	for (i = 0; i < count; i++) {
+		nodes[i].prev = i > 0 ? &nodes[i - 1] : NULL;
+		nodes[i].next = i + 1 < count ? &nodes[i + 1] : NULL;
 	}
 
-	df->registers[reg] = fvalues;
+	df->registers[reg] = nodes;
 	// These values are referenced only, do not try to free it later.
 	df->owns_memory[reg] = FALSE;
 	return TRUE;
@@ -499,6 +679,168 @@ any_in_range(dfilter_t *df, int reg1, int reg2, int reg3)
 	return FALSE;
 }
 
+/* Kinds of integer for which int_cmp() compares the values itself. */
+enum int_cmp_class {
+	INT_CMP_UINT,
+	INT_CMP_SINT,
+	INT_CMP_UINT64,
+	INT_CMP_SINT64
+};
+
+static int
+int_cmp_class(ftenum_t ftype)
+{
+	/* These are the types that use the plain integer comparisons
+	 * in ftype-integer.c. */
+	switch (ftype) {
+		case FT_CHAR:
+		case FT_UINT8:
+		case FT_UINT16:
+		case FT_UINT24:
+		case FT_UINT32:
+		case FT_FRAMENUM:
+		case FT_IPXNET:
+			return INT_CMP_UINT;
+		case FT_INT8:
+		case FT_INT16:
+		case FT_INT24:
+		case FT_INT32:
+			return INT_CMP_SINT;
+		case FT_UINT40:
+		case FT_UINT48:
+		case FT_UINT56:
+		case FT_UINT64:
+		case FT_EUI64:
+			return INT_CMP_UINT64;
+		case FT_INT40:
+		case FT_INT48:
+		case FT_INT56:
+		case FT_INT64:
+			return INT_CMP_SINT64;
+		default:
+			return -1;
+	}
+}
+
+#define INT_CMP_ORDER(a, b)	(((a) > (b)) - ((a) < (b)))
+
+/* Compares the values in a register with a single integer constant.
+ * This gives the same result as the generic relation opcode in "op", but
+ * compares the integers inline instead of going through fvalue_eq() and
+ * friends for every value. Values of another type than the constant
+ * (fields that share a name can have different types) use the generic
+ * comparison. */
+static gboolean
+int_cmp(dfilter_t *df, dfvm_opcode_t op, int cmp_class, int reg1, int reg2)
+{
+	GList		*list_a;
+	const fvalue_t	*a, *b;
+	gboolean	have_match;
+	int		order;
+
+	b = (const fvalue_t *)df->registers[reg2]->data;
+
+	for (list_a = df->registers[reg1]; list_a; list_a = g_list_next(list_a)) {
+		a = (const fvalue_t *)list_a->data;
+		if (a->ftype != b->ftype) {
+			order = a->ftype->cmp_order(a, b);
+		}
+		else {
+			switch (cmp_class) {
+				case INT_CMP_UINT:
+					order = INT_CMP_ORDER(a->value.uinteger, b->value.uinteger);
+					break;
+				case INT_CMP_SINT:
+					order = INT_CMP_ORDER(a->value.sinteger, b->value.sinteger);
+					break;
+				case INT_CMP_UINT64:
+					order = INT_CMP_ORDER(a->value.uinteger64, b->value.uinteger64);
+					break;
+				case INT_CMP_SINT64:
+					order = INT_CMP_ORDER(a->value.sinteger64, b->value.sinteger64);
+					break;
+				default:
+					ws_assert_not_reached();
+					return FALSE;
+			}
+		}
+
+		switch (op) {
+			case ANY_EQ:
+				have_match = order == 0;
+				break;
+			case ALL_NE:
+			case ANY_NE:
+				have_match = order != 0;
+				break;
+			case ANY_GT:
+				have_match = order > 0;
+				break;
+			case ANY_GE:
+				have_match = order >= 0;
+				break;
+			case ANY_LT:
+				have_match = order < 0;
+				break;
+			case ANY_LE:
+				have_match = order <= 0;
+				break;
+			default:
+				ws_assert_not_reached();
+				return FALSE;
+		}
+
+		if (op == ALL_NE) {
+			if (!have_match)
+				return FALSE;
+		}
+		else if (have_match) {
+			return TRUE;
+		}
+	}
+	return op == ALL_NE;
+}
+
+
+/* Looks up the values in a register in a set made by
+ * dfvm_fvalue_set_new(), giving the same result as testing each element
+ * of the set in turn. */
+static gboolean
+any_in_set(dfilter_t *df, int reg, const dfvm_fvalue_set_t *set)
+{
+	GList		*list;
+	const fvalue_t	*a;
+	guint		lo, hi, mid;
+
+	for (list = df->registers[reg]; list; list = g_list_next(list)) {
+		a = (const fvalue_t *)list->data;
+
+		if (fvalue_type_ftenum((fvalue_t *)a) != set->ftype) {
+			/* Fields that share a name can have different
+			 * types; the set isn't sorted for this one. */
+			for (lo = 0; lo < set->len; lo++) {
+				if (fvalue_ge(a, set->low[lo]) && fvalue_le(a, set->high[lo]))
+					return TRUE;
+			}
+			continue;
+		}
+
+		/* Find the first interval starting above the value; the
+		 * one before it is the only one that can hold it. */
+		lo = 0;
+		hi = set->len;
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			if (fvalue_set_cmp_order(a, set->low[mid]) < 0)
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		if (lo > 0 && fvalue_set_cmp_order(a, set->high[lo - 1]) <= 0)
+			return TRUE;
+	}
+	return FALSE;
+}
 
 static void
 free_owned_register(gpointer data, gpointer user_data _U_)
@@ -517,11 +859,14 @@ free_register_overhead(dfilter_t* df)
 	for (i = 0; i < df->num_registers; i++) {
 		df->attempted_load[i] = FALSE;
 		if (df->registers[i]) {
+			/* Registers that we don't own were loaded by
+			 * read_tree(), and their list nodes are kept for
+			 * the next run. */
 			if (df->owns_memory[i]) {
 				g_list_foreach(df->registers[i], free_owned_register, NULL);
+				g_list_free(df->registers[i]);
 				df->owns_memory[i] = FALSE;
 			}
-			g_list_free(df->registers[i]);
 			df->registers[i] = NULL;
 		}
 	}
@@ -680,6 +1025,17 @@ dfvm_apply(dfilter_t *df, proto_tree *tree)
 						arg3->value.numeric);
 				break;
 
+			case ANY_IN_SET:
+				accum = any_in_set(df, arg1->value.numeric,
+						arg2->value.fvalue_set);
+				break;
+
+			case INT_CMP:
+				accum = int_cmp(df, (dfvm_opcode_t)insn->arg3->value.numeric,
+						insn->arg4->value.numeric,
+						arg1->value.numeric, arg2->value.numeric);
+				break;
+
 			case NOT:
 				accum = !accum;
 				break;
@@ -768,6 +1124,8 @@ dfvm_init_const(dfilter_t *df)
 			case ANY_CONTAINS:
 			case ANY_MATCHES:
 			case ANY_IN_RANGE:
+			case INT_CMP:
+			case ANY_IN_SET:
 			case NOT:
 			case RETURN:
 			case IF_TRUE_GOTO:
@@ -781,6 +1139,57 @@ dfvm_init_const(dfilter_t *df)
 	return;
 }
 
+/* Replace comparisons of a field with a single integer constant by
+ * INT_CMP, which does the comparison without calling through the ftype
+ * for every value. The original opcode is kept in arg3 and the kind of
+ * integer in arg4. Must be called after dfvm_init_const(). */
+void
+dfvm_specialize(dfilter_t *df)
+{
+	int		id, length, cmp_class;
+	guint		reg;
+	dfvm_insn_t	*insn;
+	dfvm_value_t	*val;
+	GList		*constant;
+
+	length = df->insns->len;
+	for (id = 0; id < length; id++) {
+		insn = (dfvm_insn_t	*)g_ptr_array_index(df->insns, id);
+
+		switch (insn->op) {
+			case ANY_EQ:
+			case ALL_NE:
+			case ANY_NE:
+			case ANY_GT:
+			case ANY_GE:
+			case ANY_LT:
+			case ANY_LE:
+				break;
+			default:
+				continue;
+		}
+
+		/* Only constants are set before the filter runs. */
+		reg = insn->arg2->value.numeric;
+		if (reg < df->num_registers)
+			continue;
+		constant = df->registers[reg];
+		if (constant == NULL || g_list_next(constant) != NULL)
+			continue;
+		cmp_class = int_cmp_class(fvalue_type_ftenum((fvalue_t *)constant->data));
+		if (cmp_class < 0)
+			continue;
+
+		val = dfvm_value_new(INTEGER);
+		val->value.numeric = insn->op;
+		insn->arg3 = val;
+		val = dfvm_value_new(INTEGER);
+		val->value.numeric = cmp_class;
+		insn->arg4 = val;
+		insn->op = INT_CMP;
+	}
+}
+
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
  *
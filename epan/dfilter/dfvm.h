@@ -24,9 +24,20 @@ typedef enum {
 	INTEGER,
 	DRANGE,
 	FUNCTION_DEF,
-	PCRE
+	PCRE,
+	FVALUE_SET
 } dfvm_value_type_t;
 
+/* A set of constants for ANY_IN_SET: sorted, non-overlapping intervals,
+ * with single values stored as intervals of one value. */
+typedef struct {
+	ftenum_t	ftype;
+	GPtrArray	*values;	/* owns the fvalues */
+	fvalue_t	**low;
+	fvalue_t	**high;
+	guint		len;
+} dfvm_fvalue_set_t;
+
 typedef struct {
 	dfvm_value_type_t	type;
 
@@ -37,6 +48,7 @@ typedef struct {
 		header_field_info	*hfinfo;
 		df_func_def_t		*funcdef;
 		fvalue_regex_t		*pcre;
+		dfvm_fvalue_set_t	*fvalue_set;
 	} value;
 
 } dfvm_value_t;
@@ -64,7 +76,9 @@ typedef enum {
 	ANY_MATCHES,
 	MK_RANGE,
 	CALL_FUNCTION,
-	ANY_IN_RANGE
+	ANY_IN_RANGE,
+	INT_CMP,
+	ANY_IN_SET
 
 } dfvm_opcode_t;
 
@@ -86,6 +100,12 @@ dfvm_insn_free(dfvm_insn_t *insn);
 dfvm_value_t*
 dfvm_value_new(dfvm_value_type_t type);
 
+gboolean
+dfvm_fvalue_set_can_hold(fvalue_t *fv);
+
+dfvm_fvalue_set_t *
+dfvm_fvalue_set_new(GPtrArray *values);
+
 void
 dfvm_dump(FILE *f, dfilter_t *df);
 
@@ -95,4 +115,7 @@ dfvm_apply(dfilter_t *df, proto_tree *tree);
 void
 dfvm_init_const(dfilter_t *df);
 
+void
+dfvm_specialize(dfilter_t *df);
+
 #endif
@@ -19,6 +19,8 @@
 #include "ftypes/ftypes.h"
 #include <wsutil/ws_assert.h>
 
+#include <string.h>
+
 static void
 gencode(dfwork_t *dfw, stnode_t *st_node);
 
@@ -309,6 +311,74 @@ fixup_jumps(gpointer data, gpointer user_data)
 	}
 }
 
+/* Sets with at least this many elements, all of them constants, are
+ * searched with a single ANY_IN_SET instruction rather than tested one
+ * element at a time. */
+#define SET_LOOKUP_MIN_ELEMENTS	8
+
+static gboolean
+can_use_set_lookup(GSList *nodelist)
+{
+	stnode_t	*node;
+	fvalue_t	*fv;
+	ftenum_t	ftype = FT_NONE;
+	guint		num_elements = 0;
+
+	for (; nodelist; nodelist = g_slist_next(nodelist)) {
+		node = (stnode_t *)nodelist->data;
+		if (node == NULL) {
+			/* No upper bound, a single value. */
+			continue;
+		}
+		if (stnode_type_id(node) != STTYPE_FVALUE)
+			return FALSE;
+		fv = (fvalue_t *)stnode_data(node);
+		if (!dfvm_fvalue_set_can_hold(fv))
+			return FALSE;
+		if (ftype != FT_NONE && fvalue_type_ftenum(fv) != ftype)
+			return FALSE;
+		ftype = fvalue_type_ftenum(fv);
+		num_elements++;
+	}
+	/* Ranges were counted twice, which doesn't matter for deciding
+	 * whether the set is big enough. */
+	return num_elements >= SET_LOOKUP_MIN_ELEMENTS;
+}
+
+static void
+gen_relation_in_set(dfwork_t *dfw, stnode_t *st_arg1, GSList *nodelist)
+{
+	dfvm_insn_t	*insn;
+	dfvm_value_t	*val1, *val2;
+	dfvm_value_t	*jmp1 = NULL;
+	GPtrArray	*values;
+	stnode_t	*node;
+	int		reg1;
+
+	reg1 = gen_entity(dfw, st_arg1, &jmp1);
+
+	/* Lower bound, then upper bound or NULL, for each element. */
+	values = g_ptr_array_new();
+	for (; nodelist; nodelist = g_slist_next(nodelist)) {
+		node = (stnode_t *)nodelist->data;
+		g_ptr_array_add(values, node ? stnode_steal_data(node) : NULL);
+	}
+
+	insn = dfvm_insn_new(ANY_IN_SET);
+	val1 = dfvm_value_new(REGISTER);
+	val1->value.numeric = reg1;
+	val2 = dfvm_value_new(FVALUE_SET);
+	val2->value.fvalue_set = dfvm_fvalue_set_new(values);
+	insn->arg1 = val1;
+	insn->arg2 = val2;
+	dfw_append_insn(dfw, insn);
+
+	/* Jump here if the LHS entity was not present */
+	if (jmp1) {
+		jmp1->value.numeric = dfw->next_insn_id;
+	}
+}
+
 /* Generate the code for the in operator.  It behaves much like an OR-ed
  * series of == tests, but without the redundant existence checks. */
 static void
@@ -322,11 +392,18 @@ gen_relation_in(dfwork_t *dfw, stnode_t *st_arg1, stnode_t *st_arg2)
 	GSList		*nodelist_head, *nodelist;
 	GSList		*jumplist = NULL;
 
+	nodelist_head = nodelist = (GSList*)stnode_steal_data(st_arg2);
+
+	if (can_use_set_lookup(nodelist_head)) {
+		gen_relation_in_set(dfw, st_arg1, nodelist_head);
+		set_nodelist_free(nodelist_head);
+		return;
+	}
+
 	/* Create code for the LHS of the relation */
 	reg1 = gen_entity(dfw, st_arg1, &jmp1);
 
 	/* Create code for the set on the RHS of the relation */
-	nodelist_head = nodelist = (GSList*)stnode_steal_data(st_arg2);
 	while (nodelist) {
 		node1 = (stnode_t*)nodelist->data;
 		nodelist = g_slist_next(nodelist);
@@ -437,6 +514,138 @@ gen_entity(dfwork_t *dfw, stnode_t *st_arg, dfvm_value_t **p_jmp)
 }
 
 
+/* Rough relative cost of evaluating an entity or a test, used to order
+ * the operands of "and" and "or" so that the cheap tests run first and
+ * the expensive ones only run when they can still change the result.
+ * The numbers only need to rank the operations sensibly, they're not a
+ * measurement of anything. */
+static int
+entity_cost(stnode_t *st_arg)
+{
+	GSList	*params;
+	int	cost;
+
+	switch (stnode_type_id(st_arg)) {
+		case STTYPE_FIELD:
+			return 2;
+		case STTYPE_RANGE:
+			return 2 + entity_cost(sttype_range_entity(st_arg));
+		case STTYPE_FUNCTION:
+			cost = 8;
+			for (params = sttype_function_params(st_arg); params; params = params->next)
+				cost += entity_cost((stnode_t *)params->data);
+			return cost;
+		default:
+			/* Constants are loaded once, before the filter runs. */
+			return 0;
+	}
+}
+
+static int
+order_tests(stnode_t *st_node);
+
+/* An operand of a chain of "and"s or "or"s, with its cost and its
+ * position in the chain as written. */
+typedef struct {
+	stnode_t	*node;
+	int		cost;
+	guint		pos;
+} test_term_t;
+
+static gint
+test_term_cmp(gconstpointer a, gconstpointer b)
+{
+	const test_term_t *ta = (const test_term_t *)a;
+	const test_term_t *tb = (const test_term_t *)b;
+
+	if (ta->cost != tb->cost)
+		return ta->cost < tb->cost ? -1 : 1;
+	/* Ties keep the order the user wrote. */
+	return ta->pos < tb->pos ? -1 : ta->pos > tb->pos;
+}
+
+/* Collect the operands of a chain of the same operator, ordering each
+ * of them and computing its cost, and the nodes that join them.
+ * Returns the cost of the chain. */
+static int
+collect_chain(stnode_t *st_node, test_op_t chain_op, GArray *terms, GPtrArray *joins)
+{
+	test_op_t	st_op;
+	stnode_t	*st_arg1, *st_arg2;
+	test_term_t	term;
+
+	sttype_test_get(st_node, &st_op, &st_arg1, &st_arg2);
+
+	if (st_op == chain_op) {
+		g_ptr_array_add(joins, st_node);
+		return collect_chain(st_arg1, chain_op, terms, joins) +
+			collect_chain(st_arg2, chain_op, terms, joins);
+	}
+
+	term.node = st_node;
+	term.cost = order_tests(st_node);
+	term.pos = terms->len;
+	g_array_append_val(terms, term);
+	return term.cost;
+}
+
+/* "and" and "or" don't have side effects, so the operands of a chain
+ * of either are sorted by cost and joined up again from the left,
+ * reusing the chain's own nodes, so that the cheaper ones run first.
+ * Costs are computed bottom up, once per node.  Returns the cost of
+ * the test. */
+static int
+order_tests(stnode_t *st_node)
+{
+	test_op_t	st_op;
+	stnode_t	*st_arg1, *st_arg2, *left, *join;
+	GArray		*terms;
+	GPtrArray	*joins;
+	guint		i;
+	int		cost;
+
+	sttype_test_get(st_node, &st_op, &st_arg1, &st_arg2);
+
+	switch (st_op) {
+		case TEST_OP_EXISTS:
+			return 1;
+		case TEST_OP_NOT:
+			return order_tests(st_arg1);
+		case TEST_OP_AND:
+		case TEST_OP_OR:
+			terms = g_array_new(FALSE, FALSE, sizeof(test_term_t));
+			joins = g_ptr_array_new();
+			cost = collect_chain(st_node, st_op, terms, joins);
+			g_array_sort(terms, test_term_cmp);
+
+			/* The first join collected is st_node itself, which
+			 * has to stay at the top. */
+			left = g_array_index(terms, test_term_t, 0).node;
+			for (i = 1; i < terms->len; i++) {
+				join = (stnode_t *)g_ptr_array_index(joins, terms->len - 1 - i);
+				sttype_test_set2_args(join, left,
+					g_array_index(terms, test_term_t, i).node);
+				left = join;
+			}
+			g_array_free(terms, TRUE);
+			g_ptr_array_free(joins, TRUE);
+			return cost;
+		case TEST_OP_IN:
+			/* The set holds a (value, upper bound or NULL) pair per element. */
+			return entity_cost(st_arg1) +
+				2 * (int)(g_slist_length((GSList *)stnode_data(st_arg2)) / 2);
+		default:
+			break;
+	}
+
+	cost = 1 + entity_cost(st_arg1) + entity_cost(st_arg2);
+	if (st_op == TEST_OP_CONTAINS)
+		cost += 8;
+	else if (st_op == TEST_OP_MATCHES)
+		cost += 32;
+	return cost;
+}
+
 static void
 gen_test(dfwork_t *dfw, stnode_t *st_node)
 {
@@ -570,6 +779,201 @@ gencode(dfwork_t *dfw, stnode_t *st_node)
 }
 
 
+/*
+ * What's known about the registers at a point in the instruction stream:
+ * "loaded" has the registers that certainly hold at least one field value,
+ * "loaded_if_true" those that do if the accumulator is TRUE.
+ */
+typedef struct {
+	gboolean	reached;
+	guint8		*loaded;
+	guint8		*loaded_if_true;
+} load_state_t;
+
+static void
+merge_load_state(load_state_t *to, const guint8 *loaded,
+		const guint8 *loaded_if_true, int num_regs)
+{
+	int	i;
+
+	if (!to->reached) {
+		to->reached = TRUE;
+		memcpy(to->loaded, loaded, num_regs);
+		if (loaded_if_true)
+			memcpy(to->loaded_if_true, loaded_if_true, num_regs);
+		else
+			memset(to->loaded_if_true, 0, num_regs);
+		return;
+	}
+	for (i = 0; i < num_regs; i++) {
+		to->loaded[i] &= loaded[i];
+		to->loaded_if_true[i] &= loaded_if_true ? loaded_if_true[i] : 0;
+	}
+}
+
+static void
+mark_loaded(guint8 *loaded, dfvm_value_t *arg, int num_regs)
+{
+	/* Constants still have negative register numbers at this point. */
+	if (arg && arg->type == REGISTER && (int)arg->value.numeric >= 0 &&
+			(int)arg->value.numeric < num_regs)
+		loaded[arg->value.numeric] = 1;
+}
+
+/*
+ * Remove READ_TREE/IF_FALSE_GOTO pairs for a register that is already
+ * known to be loaded wherever the READ_TREE can be reached from, e.g. the
+ * second "tcp.port" in "tcp.port > 1000 and tcp.port < 2000".  The VM
+ * doesn't read a field twice in the same run anyway, but the load and the
+ * branch after it are still executed for every packet.
+ *
+ * All jumps go forward, so a single pass in instruction order sees all
+ * the predecessors of an instruction before the instruction itself.
+ */
+static void
+remove_redundant_loads(dfwork_t *dfw)
+{
+	int		id, length, num_regs, reg, target, n;
+	dfvm_insn_t	*insn, *next;
+	load_state_t	*states;
+	guint8		*loaded, *loaded_if_true, *taken;
+	gboolean	*targeted, *removed;
+	int		*new_id;
+	GPtrArray	*insns;
+	gboolean	any_removed = FALSE;
+
+	length = dfw->insns->len;
+	num_regs = dfw->next_register;
+	if (num_regs == 0)
+		return;
+
+	states = g_new0(load_state_t, length);
+	for (id = 0; id < length; id++) {
+		states[id].loaded = g_new0(guint8, num_regs);
+		states[id].loaded_if_true = g_new0(guint8, num_regs);
+	}
+	loaded = g_new(guint8, num_regs);
+	loaded_if_true = g_new(guint8, num_regs);
+	taken = g_new(guint8, num_regs);
+	targeted = g_new0(gboolean, length);
+	removed = g_new0(gboolean, length);
+
+	for (id = 0; id < length; id++) {
+		insn = (dfvm_insn_t *)g_ptr_array_index(dfw->insns, id);
+		if (insn->op == IF_TRUE_GOTO || insn->op == IF_FALSE_GOTO)
+			targeted[insn->arg1->value.numeric] = TRUE;
+	}
+
+	states[0].reached = TRUE;
+	for (id = 0; id < length; id++) {
+		insn = (dfvm_insn_t *)g_ptr_array_index(dfw->insns, id);
+		if (!states[id].reached)
+			continue;
+		memcpy(loaded, states[id].loaded, num_regs);
+		memcpy(loaded_if_true, states[id].loaded_if_true, num_regs);
+
+		switch (insn->op) {
+			case READ_TREE:
+				reg = insn->arg2->value.numeric;
+				next = id + 1 < length ?
+					(dfvm_insn_t *)g_ptr_array_index(dfw->insns, id + 1) : NULL;
+				if (loaded[reg] && next && next->op == IF_FALSE_GOTO &&
+						!targeted[id + 1]) {
+					removed[id] = TRUE;
+					removed[id + 1] = TRUE;
+					any_removed = TRUE;
+				}
+				memset(loaded_if_true, 0, num_regs);
+				loaded_if_true[reg] = 1;
+				break;
+
+			case IF_FALSE_GOTO:
+				target = insn->arg1->value.numeric;
+				merge_load_state(&states[target], loaded, NULL, num_regs);
+				for (reg = 0; reg < num_regs; reg++)
+					loaded[reg] |= loaded_if_true[reg];
+				break;
+
+			case IF_TRUE_GOTO:
+				target = insn->arg1->value.numeric;
+				for (reg = 0; reg < num_regs; reg++)
+					taken[reg] = loaded[reg] | loaded_if_true[reg];
+				merge_load_state(&states[target], taken, loaded_if_true, num_regs);
+				memset(loaded_if_true, 0, num_regs);
+				break;
+
+			case RETURN:
+				continue;
+
+			case ANY_EQ:
+			case ANY_NE:
+			case ANY_GT:
+			case ANY_GE:
+			case ANY_LT:
+			case ANY_LE:
+			case ANY_BITWISE_AND:
+			case ANY_CONTAINS:
+			case ANY_MATCHES:
+			case ANY_IN_RANGE:
+			case ANY_IN_SET:
+				/* These can only be TRUE if their first operands
+				 * hold something. */
+				memset(loaded_if_true, 0, num_regs);
+				mark_loaded(loaded_if_true, insn->arg1, num_regs);
+				mark_loaded(loaded_if_true, insn->arg2, num_regs);
+				break;
+
+			case MK_RANGE:
+				/* Leaves the accumulator alone. */
+				break;
+
+			default:
+				memset(loaded_if_true, 0, num_regs);
+				break;
+		}
+		if (id + 1 < length)
+			merge_load_state(&states[id + 1], loaded, loaded_if_true, num_regs);
+	}
+
+	if (any_removed) {
+		/* Renumber, sending jumps to a removed instruction to the
+		 * first instruction after it that's kept. */
+		new_id = g_new(int, length);
+		for (id = 0, n = 0; id < length; id++) {
+			new_id[id] = n;
+			if (!removed[id])
+				n++;
+		}
+		insns = g_ptr_array_new();
+		for (id = 0; id < length; id++) {
+			insn = (dfvm_insn_t *)g_ptr_array_index(dfw->insns, id);
+			if (removed[id]) {
+				dfvm_insn_free(insn);
+				continue;
+			}
+			if (insn->op == IF_TRUE_GOTO || insn->op == IF_FALSE_GOTO)
+				insn->arg1->value.numeric = new_id[insn->arg1->value.numeric];
+			insn->id = insns->len;
+			g_ptr_array_add(insns, insn);
+		}
+		g_ptr_array_free(dfw->insns, TRUE);
+		dfw->insns = insns;
+		dfw->next_insn_id = insns->len;
+		g_free(new_id);
+	}
+
+	for (id = 0; id < length; id++) {
+		g_free(states[id].loaded);
+		g_free(states[id].loaded_if_true);
+	}
+	g_free(states);
+	g_free(loaded);
+	g_free(loaded_if_true);
+	g_free(taken);
+	g_free(targeted);
+	g_free(removed);
+}
+
 void
 dfw_gencode(dfwork_t *dfw)
 {
@@ -581,6 +985,7 @@ dfw_gencode(dfwork_t *dfw)
 	dfw->consts = g_ptr_array_new();
 	dfw->loaded_fields = g_hash_table_new(g_direct_hash, g_direct_equal);
 	dfw->interesting_fields = g_hash_table_new(g_direct_hash, g_direct_equal);
+	order_tests(dfw->st_root);
 	gencode(dfw, dfw->st_root);
 	dfw_append_insn(dfw, dfvm_insn_new(RETURN));
 
@@ -620,6 +1025,9 @@ dfw_gencode(dfwork_t *dfw)
 		}
 	}
 
+	dfw->num_unoptimized_insns = dfw->insns->len;
+	remove_redundant_loads(dfw);
+
 	/* move constants after registers*/
 	if (dfw->first_constant == -1) {
 		/* NONE */
@@ -383,6 +383,7 @@ typedef struct quic_info_data {
     wmem_list_t    *streams_list;   /**< Ordered list of QUIC Stream ID in this connection (both directions). Used by "Follow QUIC Stream" functionality */
     wmem_map_t     *streams_map;    /**< Map pinfo->num --> First stream in that frame (guint -> quic_follow_stream). Used by "Follow QUIC Stream" functionality */
     gquic_info_data_t *gquic_info; /**< GQUIC info for >Q050 flows. */
+    guint32         last_frame;     /**< Last frame of the connection seen on the first pass. */
 } quic_info_data_t;
 
 /** Per-packet information about QUIC, populated on the first pass. */
@@ -1205,6 +1206,38 @@ quic_connection_destroy(gpointer data, gpointer user_data _U_)
     quic_pp_cipher_reset(&conn->server_pp.pp_ciphers[0]);
     quic_pp_cipher_reset(&conn->server_pp.pp_ciphers[1]);
 }
+
+static void
+quic_cids_remove(wmem_map_t *connections, quic_cid_item_t *items, quic_info_data_t *conn)
+{
+    for (; items != NULL; items = items->next) {
+        if (wmem_map_lookup(connections, &items->data) == conn) {
+            wmem_map_remove(connections, &items->data);
+        }
+    }
+}
+
+/**
+ * Forget about a connection when the UDP conversation it was created for
+ * is evicted, unless it has migrated to another one that is still in use.
+ * The connection stays in quic_connections for "Follow QUIC Stream".
+ */
+static void
+quic_release_conversation_data(conversation_t *conv, void *proto_data)
+{
+    quic_info_data_t *conn = (quic_info_data_t *)proto_data;
+
+    if (conn->last_frame > conv->lru_frame) {
+        return;
+    }
+    quic_cids_remove(quic_client_connections, &conn->client_cids, conn);
+    quic_cids_remove(quic_server_connections, &conn->server_cids, conn);
+    if (conn->client_dcid_set &&
+        wmem_map_lookup(quic_initial_connections, &conn->client_dcid_initial) == conn) {
+        wmem_map_remove(quic_initial_connections, &conn->client_dcid_initial);
+    }
+    quic_connection_destroy(conn, NULL);
+}
 /* QUIC Connection tracking. }}} */
 
 /* QUIC Streams tracking and reassembly. {{{ */
@@ -3612,6 +3645,9 @@ dissect_quic(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree,
             retry_odcid = &real_retry_odcid;
         }
         quic_connection_create_or_update(&conn, pinfo, long_packet_type, version, &scid, &dcid, from_server);
+        if (conn) {
+            conn->last_frame = pinfo->num;
+        }
         dgram_info->conn = conn;
         dgram_info->from_server = from_server;
 #if 0
@@ -4649,6 +4685,7 @@ proto_register_quic(void)
 
     register_init_routine(quic_init);
     register_cleanup_routine(quic_cleanup);
+    conversation_register_release_hook(proto_quic, quic_release_conversation_data);
 
     register_follow_stream(proto_quic, "quic_follow", quic_follow_conv_filter, quic_follow_index_filter, quic_follow_address_filter,
                            udp_port_to_display, follow_quic_tap_listener);
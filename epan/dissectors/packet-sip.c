@@ -1226,6 +1226,8 @@ static sip_info_value_t *stat_info;
  * - store with each dissected packet original frame (if any)
  * - maintain a global hash table of
  *   (call_id, source_addr, dest_addr) -> (cseq, transaction_state, frame)
+ * The keys of the entries are only listed in the conversation data, so
+ * that the entries can be dropped if the conversation is evicted.
  *
  * N.B. This is broken for a couple of reasons:
  * - it won't cope properly with overlapping transactions within the
@@ -1331,6 +1333,28 @@ sip_cleanup_protocol(void)
      g_hash_table_destroy(sip_headers_hash);
 }
 
+/* Drop the sip_hash entries created for packets of a conversation that
+ * is being evicted; proto_data is the list of their keys. */
+static void
+sip_release_conversation_data(conversation_t *conv _U_, void *proto_data)
+{
+    wmem_list_t *keys = (wmem_list_t *)proto_data;
+    wmem_list_frame_t *frame;
+    sip_hash_key *p_key;
+    sip_hash_value *p_val;
+
+    for (frame = wmem_list_head(keys); frame != NULL; frame = wmem_list_frame_next(frame)) {
+        p_key = (sip_hash_key *)wmem_list_frame_data(frame);
+        p_val = (sip_hash_value *)g_hash_table_lookup(sip_hash, p_key);
+        g_hash_table_remove(sip_hash, p_key);
+        wmem_free(wmem_file_scope(), p_val);
+        free_address_wmem(wmem_file_scope(), &p_key->source_address);
+        free_address_wmem(wmem_file_scope(), &p_key->dest_address);
+        wmem_free(wmem_file_scope(), p_key);
+    }
+    wmem_destroy_list(keys);
+}
+
 /* Call the export PDU tap with relevant data */
 static void
 export_sip_pdu(packet_info *pinfo, tvbuff_t *tvb)
@@ -5230,6 +5254,8 @@ guint sip_is_packet_resend(packet_info *pinfo,
     sip_hash_key   *p_key = 0;
     sip_hash_value *p_val = 0;
     sip_frame_result_value *sip_frame_result = NULL;
+    conversation_t *conv;
+    wmem_list_t    *conv_keys;
     guint result = 0;
 
     /* Only consider retransmission of UDP packets */
@@ -5337,6 +5363,16 @@ guint sip_is_packet_resend(packet_info *pinfo,
         /* Add entry */
         g_hash_table_insert(sip_hash, p_key, p_val);
 
+        /* Remember it with the conversation, so that it's dropped if the
+         * conversation is evicted. */
+        conv = find_or_create_conversation(pinfo);
+        conv_keys = (wmem_list_t *)conversation_get_proto_data(conv, proto_sip);
+        if (conv_keys == NULL) {
+            conv_keys = wmem_list_new(wmem_file_scope());
+            conversation_add_proto_data(conv, proto_sip, conv_keys);
+        }
+        wmem_list_append(conv_keys, p_key);
+
         /* Assume have seen no cseq yet */
         cseq_to_compare = 0;
     }
@@ -7659,6 +7695,7 @@ void proto_register_sip(void)
 
     register_init_routine(&sip_init_protocol);
     register_cleanup_routine(&sip_cleanup_protocol);
+    conversation_register_release_hook(proto_sip, sip_release_conversation_data);
     heur_subdissector_list = register_heur_dissector_list("sip", proto_sip);
     /* Register for tapping */
     sip_tap = register_tap("sip");
@@ -1349,7 +1349,7 @@ handle_export_pdu_conversation(packet_info *pinfo, tvbuff_t *tvb, int src_port,
         conversation_t *conversation = find_conversation(pinfo->num, &pinfo->src, &pinfo->dst, ENDPOINT_TCP, src_port, dst_port, 0);
         if (conversation != NULL)
         {
-            dissector_handle_t handle = (dissector_handle_t)wmem_tree_lookup32_le(conversation->dissector_tree, pinfo->num);
+            dissector_handle_t handle = conversation_get_dissector(conversation, pinfo->num);
             if (handle != NULL)
             {
                 exp_pdu_data_item_t exp_pdu_data_dissector_data = {exp_pdu_tcp_dissector_data_size, exp_pdu_tcp_dissector_data_populate_data, NULL};
@@ -1588,6 +1588,44 @@ init_tcp_conversation_data(packet_info *pinfo)
     return tcpd;
 }
 
+static void
+tcp_release_flow(tcp_flow_t *flow)
+{
+    tcp_unacked_t *ual, *next_ual;
+
+    if (flow->tcp_analyze_seq_info) {
+        for (ual = flow->tcp_analyze_seq_info->segments; ual; ual = next_ual) {
+            next_ual = ual->next;
+            wmem_free(wmem_file_scope(), ual);
+        }
+        wmem_free(wmem_file_scope(), flow->tcp_analyze_seq_info->segment_ring);
+        wmem_free(wmem_file_scope(), flow->tcp_analyze_seq_info);
+    }
+    if (flow->process_info) {
+        wmem_free(wmem_file_scope(), flow->process_info->username);
+        wmem_free(wmem_file_scope(), flow->process_info->command);
+        wmem_free(wmem_file_scope(), flow->process_info);
+    }
+    wmem_tree_destroy(flow->multisegment_pdus, FALSE, TRUE);
+}
+
+/* Called when a conversation with TCP data is evicted; see
+ * conversation_set_eviction(). */
+static void
+tcp_release_conversation_data(conversation_t *conv _U_, void *proto_data)
+{
+    struct tcp_analysis *tcpd = (struct tcp_analysis *)proto_data;
+
+    /* MPTCP connections keep pointers to the data of their subflows. */
+    if (tcpd->mptcp_analysis || tcpd->flow1.mptcp_subflow || tcpd->flow2.mptcp_subflow)
+        return;
+
+    tcp_release_flow(&tcpd->flow1);
+    tcp_release_flow(&tcpd->flow2);
+    wmem_tree_destroy(tcpd->acked_table, FALSE, TRUE);
+    wmem_free(wmem_file_scope(), tcpd);
+}
+
 /* setup meta as well */
 static void
 mptcp_init_subflow(tcp_flow_t *flow)
@@ -1967,13 +2005,130 @@ tcp_analyze_get_acked_struct(guint32 frame, guint32 seq, guint32 ack, gboolean c
     }
 }
 
+/*
+ * The unacked segments of a flow are kept both in a list, in the order
+ * they were seen, and in a ring of pointers sorted by nextseq.  An ACK
+ * removes every segment up to some nextseq, so segments only ever leave
+ * from the front of the ring, and finding what an ACK covers doesn't
+ * require walking all the segments in flight.
+ */
+#define TCP_UNACKED_RING_INITIAL_SIZE 16
+
+static inline tcp_unacked_t *
+tcp_unacked_get(tcp_analyze_seq_flow_info_t *seq_info, guint32 i)
+{
+    return seq_info->segment_ring[(seq_info->segment_ring_head + i) & (seq_info->segment_ring_size - 1)];
+}
+
+static inline void
+tcp_unacked_set(tcp_analyze_seq_flow_info_t *seq_info, guint32 i, tcp_unacked_t *ual)
+{
+    seq_info->segment_ring[(seq_info->segment_ring_head + i) & (seq_info->segment_ring_size - 1)] = ual;
+}
+
+/* Index of the first segment in the ring with a nextseq after the given one */
+static guint32
+tcp_unacked_upper_bound(tcp_analyze_seq_flow_info_t *seq_info, guint32 nextseq)
+{
+    guint32 lo = 0, hi = seq_info->segment_count, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (GT_SEQ(tcp_unacked_get(seq_info, mid)->nextseq, nextseq)) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+static void
+tcp_unacked_insert(tcp_analyze_seq_flow_info_t *seq_info, tcp_unacked_t *ual)
+{
+    tcp_unacked_t **ring;
+    guint32 count = seq_info->segment_count;
+    guint32 pos, i;
+
+    ual->prev = NULL;
+    ual->next = seq_info->segments;
+    if (seq_info->segments) {
+        seq_info->segments->prev = ual;
+    } else {
+        seq_info->oldest_segment = ual;
+    }
+    seq_info->segments = ual;
+
+    if (count == seq_info->segment_ring_size) {
+        guint32 size = seq_info->segment_ring_size ? seq_info->segment_ring_size * 2 : TCP_UNACKED_RING_INITIAL_SIZE;
+
+        ring = wmem_alloc_array(wmem_file_scope(), tcp_unacked_t *, size);
+        for (i = 0; i < count; i++) {
+            ring[i] = tcp_unacked_get(seq_info, i);
+        }
+        wmem_free(wmem_file_scope(), seq_info->segment_ring);
+        seq_info->segment_ring = ring;
+        seq_info->segment_ring_head = 0;
+        seq_info->segment_ring_size = (guint16)size;
+    }
+
+    if (ual->nextseq - ual->seq > seq_info->max_segment_len) {
+        seq_info->max_segment_len = ual->nextseq - ual->seq;
+    }
+
+    /*
+     * New data goes at the end.  Anything else, e.g. a retransmission,
+     * goes after the segments with the same nextseq, moving whichever
+     * side of the ring is shorter out of the way.
+     */
+    if (count == 0 || !GT_SEQ(tcp_unacked_get(seq_info, count - 1)->nextseq, ual->nextseq)) {
+        pos = count;
+    } else {
+        pos = tcp_unacked_upper_bound(seq_info, ual->nextseq);
+    }
+    if (pos < count - pos) {
+        seq_info->segment_ring_head = (guint16)((seq_info->segment_ring_head - 1) & (seq_info->segment_ring_size - 1));
+        for (i = 0; i < pos; i++) {
+            tcp_unacked_set(seq_info, i, tcp_unacked_get(seq_info, i + 1));
+        }
+    } else {
+        for (i = count; i > pos; i--) {
+            tcp_unacked_set(seq_info, i, tcp_unacked_get(seq_info, i - 1));
+        }
+    }
+    tcp_unacked_set(seq_info, pos, ual);
+    seq_info->segment_count++;
+}
+
+/* Remove and free the segment at the front of the ring */
+static void
+tcp_unacked_remove_first(tcp_analyze_seq_flow_info_t *seq_info)
+{
+    tcp_unacked_t *ual = tcp_unacked_get(seq_info, 0);
+
+    seq_info->segment_ring_head = (guint16)((seq_info->segment_ring_head + 1) & (seq_info->segment_ring_size - 1));
+    seq_info->segment_count--;
+
+    if (ual->prev) {
+        ual->prev->next = ual->next;
+    } else {
+        seq_info->segments = ual->next;
+    }
+    if (ual->next) {
+        ual->next->prev = ual->prev;
+    } else {
+        seq_info->oldest_segment = ual->prev;
+    }
+    wmem_free(wmem_file_scope(), ual);
+}
 
 /* fwd contains a list of all segments processed but not yet ACKed in the
  *     same direction as the current segment.
  * rev contains a list of all segments received but not yet ACKed in the
  *     opposite direction to the current segment.
  *
- * New segments are always added to the head of the fwd/rev lists.
+ * New segments are always added to the head of the fwd/rev lists, and
+ * to the fwd/rev rings in nextseq order.
  *
  * Changes below should be synced with ChAdvTCPAnalysis in the User's
  * Guide: docbook/wsug_src/WSUG_chapter_advanced.adoc
@@ -1982,9 +2137,11 @@ static void
 tcp_analyze_sequence_number(packet_info *pinfo, guint32 seq, guint32 ack, guint32 seglen, guint16 flags, guint32 window, struct tcp_analysis *tcpd)
 {
     tcp_unacked_t *ual=NULL;
-    tcp_unacked_t *prevual=NULL;
+    tcp_analyze_seq_flow_info_t *rev_seq_info;
     guint32 nextseq;
+    guint32 i;
     int ackcount;
+    gboolean found_acked;
 
 #if 0
     printf("\nanalyze_sequence numbers   frame:%u\n",pinfo->num);
@@ -2374,11 +2531,10 @@ finished_fwd:
              * go back to the eldest one, which in theory is likely to be the one retransmitted here.
              * It's not always the perfect match, particularly when original captured packet used LSO
              */
-            ual = tcpd->fwd->tcp_analyze_seq_info->segments;
-            while(ual) {
+            ual = tcpd->fwd->tcp_analyze_seq_info->oldest_segment;
+            if(ual) {
                 nstime_delta(&tcpd->ta->rto_ts, &pinfo->abs_ts, &ual->ts );
                 tcpd->ta->rto_frame=ual->frame;
-                ual=ual->next;
             }
         }
     }
@@ -2391,9 +2547,6 @@ finished_checking_retransmission_type:
          * aren't "too many" unacked segments (e.g., we're not seeing the ACKs).
          */
         ual = wmem_new(wmem_file_scope(), tcp_unacked_t);
-        ual->next=tcpd->fwd->tcp_analyze_seq_info->segments;
-        tcpd->fwd->tcp_analyze_seq_info->segments=ual;
-        tcpd->fwd->tcp_analyze_seq_info->segment_count++;
         ual->frame=pinfo->num;
         ual->seq=seq;
         ual->ts=pinfo->abs_ts;
@@ -2403,6 +2556,7 @@ finished_checking_retransmission_type:
             nextseq+=1;
         }
         ual->nextseq=nextseq;
+        tcp_unacked_insert(tcpd->fwd->tcp_analyze_seq_info, ual);
     }
 
     /* Store the highest number seen so far for nextseq so we can detect
@@ -2454,34 +2608,32 @@ finished_checking_retransmission_type:
 
 
     /* remove all segments this ACKs and we don't need to keep around any more
+     * Those are at the front of the ring, up to the first one that ends
+     * after the ACK.
      */
     ackcount=0;
-    prevual = NULL;
-    ual = tcpd->rev->tcp_analyze_seq_info->segments;
-    while(ual) {
-        tcp_unacked_t *tmpual;
+    found_acked=FALSE;
+    rev_seq_info = tcpd->rev->tcp_analyze_seq_info;
+    while(rev_seq_info->segment_count) {
+        ual = tcp_unacked_get(rev_seq_info, 0);
 
-        /* If this ack matches the segment, process accordingly */
-        if(ack==ual->nextseq) {
+        /* If this acknowledges a segment prior to this one, leave the rest alone */
+        if (GT_SEQ(ual->nextseq,ack)) {
+            break;
+        }
+        /* If this ack matches the segment, process accordingly.
+         * Segments with the same nextseq are in the order they were seen,
+         * so that's the first one sent.
+         */
+        if(ack==ual->nextseq && !found_acked) {
             tcp_analyze_get_acked_struct(pinfo->num, seq, ack, TRUE, tcpd);
             tcpd->ta->frame_acked=ual->frame;
             nstime_delta(&tcpd->ta->ts, &pinfo->abs_ts, &ual->ts);
-        }
-        /* If this acknowledges part of the segment, adjust the segment info for the acked part */
-        else if (GT_SEQ(ack, ual->seq) && LE_SEQ(ack, ual->nextseq)) {
-            ual->seq = ack;
-            continue;
-        }
-        /* If this acknowledges a segment prior to this one, leave this segment alone and move on */
-        else if (GT_SEQ(ual->nextseq,ack)) {
-            prevual = ual;
-            ual = ual->next;
-            continue;
+            found_acked=TRUE;
         }
 
         /* This segment is old, or an exact match.  Delete the segment from the list */
         ackcount++;
-        tmpual=ual->next;
 
         if (tcpd->rev->scps_capable) {
           /* Track largest segment successfully sent for SNACK analysis*/
@@ -2490,15 +2642,21 @@ finished_checking_retransmission_type:
           }
         }
 
-        if (!prevual) {
-            tcpd->rev->tcp_analyze_seq_info->segments = tmpual;
+        tcp_unacked_remove_first(rev_seq_info);
+    }
+
+    /* If this acknowledges part of a segment, adjust the segment info for
+     * the acked part.  Such a segment can't end further than the longest
+     * segment length past the ACK.
+     */
+    for(i = 0; i < rev_seq_info->segment_count; i++) {
+        ual = tcp_unacked_get(rev_seq_info, i);
+        if (!GT_SEQ(ack + rev_seq_info->max_segment_len, ual->nextseq)) {
+            break;
         }
-        else{
-            prevual->next = tmpual;
+        if (GT_SEQ(ack, ual->seq)) {
+            ual->seq = ack;
         }
-        wmem_free(wmem_file_scope(), ual);
-        ual = tmpual;
-        tcpd->rev->tcp_analyze_seq_info->segment_count--;
     }
 
     /* how many bytes of data are there in flight after this frame
@@ -2521,23 +2679,27 @@ finished_checking_retransmission_type:
          * by now still the default.
          */
         if(!tcp_bif_seq_based) {
-            ual=tcpd->fwd->tcp_analyze_seq_info->segments;
+            tcp_analyze_seq_flow_info_t *fwd_seq_info = tcpd->fwd->tcp_analyze_seq_info;
 
-            if (seglen!=0 && ual && tcpd->fwd->valid_bif) {
+            if (seglen!=0 && fwd_seq_info->segment_count && tcpd->fwd->valid_bif) {
                 guint32 first_seq, last_seq;
 
                 dry_bif_handling = TRUE;
 
-                first_seq = ual->seq - tcpd->fwd->base_seq;
-                last_seq = ual->nextseq - tcpd->fwd->base_seq;
-                while (ual) {
-                    if ((ual->nextseq-tcpd->fwd->base_seq)>last_seq) {
-                        last_seq = ual->nextseq-tcpd->fwd->base_seq;
+                /* The last segment in the ring ends last; the one that
+                 * starts first ends within the longest segment length of
+                 * the start of the first one.
+                 */
+                first_seq = tcp_unacked_get(fwd_seq_info, 0)->seq;
+                last_seq = tcp_unacked_get(fwd_seq_info, fwd_seq_info->segment_count - 1)->nextseq;
+                for (i = 1; i < fwd_seq_info->segment_count; i++) {
+                    ual = tcp_unacked_get(fwd_seq_info, i);
+                    if (!GT_SEQ(first_seq + fwd_seq_info->max_segment_len, ual->nextseq)) {
+                        break;
                     }
-                    if ((ual->seq-tcpd->fwd->base_seq)<first_seq) {
-                        first_seq = ual->seq-tcpd->fwd->base_seq;
+                    if (LT_SEQ(ual->seq, first_seq)) {
+                        first_seq = ual->seq;
                     }
-                    ual = ual->next;
                 }
                 in_flight = last_seq-first_seq;
             }
@@ -3291,6 +3453,10 @@ static gboolean tcp_desegment = TRUE;
  * subdissector (depends on "tcp_desegment"). */
 static gboolean tcp_reassemble_out_of_order = FALSE;
 
+/* Present reassembled PDUs as a composite of the segments' data instead
+ * of copying the data of each segment into one buffer. */
+static gboolean tcp_reassemble_composite = FALSE;
+
 /* Returns true iff any gap exists in the segments associated with msp up to the
  * given sequence number (it ignores any gaps after the sequence number). */
 static gboolean
@@ -7459,6 +7625,8 @@ tcp_init(void)
     /* MPTCP init */
     mptcp_stream_count = 0;
     mptcp_tokens = wmem_tree_new(wmem_file_scope());
+
+    reassembly_table_set_composite(&tcp_reassembly_table, tcp_reassemble_composite);
 }
 
 void
@@ -8499,6 +8667,13 @@ proto_register_tcp(void)
         "Whether out-of-order segments should be buffered and reordered before passing it to a subdissector. "
         "To use this option you must also enable \"Allow subdissector to reassemble TCP streams\".",
         &tcp_reassemble_out_of_order);
+    prefs_register_bool_preference(tcp_module, "reassemble_composite",
+        "Reassemble PDUs without copying segment data",
+        "Whether reassembled PDUs should refer to the data of the segments they are made of "
+        "instead of copying it into one buffer each time more segments are added to them. "
+        "This avoids copying the same data over and over for large PDUs, but uses more memory "
+        "when a subdissector needs the data of a PDU in one piece.",
+        &tcp_reassemble_composite);
     prefs_register_bool_preference(tcp_module, "analyze_sequence_numbers",
         "Analyze TCP sequence numbers",
         "Make the TCP dissector analyze TCP sequence numbers to find and flag segment retransmissions, missing segments and RTT",
@@ -8561,6 +8736,7 @@ proto_register_tcp(void)
         &tcp_display_process_info);
 
     register_init_routine(tcp_init);
+    conversation_register_release_hook(proto_tcp, tcp_release_conversation_data);
     reassembly_table_register(&tcp_reassembly_table,
                           &addresses_ports_reassembly_table_functions);
 
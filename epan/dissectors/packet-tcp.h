@@ -148,6 +148,7 @@ pdu_store_sequencenumber_of_next_pdu(packet_info *pinfo, guint32 seq, guint32 nx
 
 typedef struct _tcp_unacked_t {
 	struct _tcp_unacked_t *next;
+	struct _tcp_unacked_t *prev;
 	guint32 frame;
 	guint32	seq;
 	guint32	nextseq;
@@ -294,8 +295,13 @@ typedef enum {
  * is enabled, so save the memory when it isn't
  */
 typedef struct tcp_analyze_seq_flow_info_t {
-	tcp_unacked_t *segments;/* List of segments for which we haven't seen an ACK */
+	tcp_unacked_t *segments;/* List of segments for which we haven't seen an ACK, newest first */
+	tcp_unacked_t *oldest_segment;	/* Last segment in that list */
+	tcp_unacked_t **segment_ring;	/* The same segments, sorted by nextseq */
+	guint16 segment_ring_head;	/* Index of the first segment in segment_ring */
+	guint16 segment_ring_size;	/* Allocated size of segment_ring, a power of 2 */
 	guint16 segment_count;	/* How many unacked segments we're currently storing */
+	guint32 max_segment_len;	/* Largest nextseq - seq of any segment stored */
     guint32 lastack;	/* Last seen ack for the reverse flow */
 	nstime_t lastacktime;	/* Time of the last ack packet */
 	guint32 lastnondupack;	/* frame number of last seen non dupack */
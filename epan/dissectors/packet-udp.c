@@ -252,6 +252,20 @@ init_udp_conversation_data(packet_info *pinfo)
   return udpd;
 }
 
+/* Called when a conversation with UDP data is evicted; see
+ * conversation_set_eviction(). */
+static void
+udp_release_conversation_data(conversation_t *conv _U_, void *proto_data)
+{
+  struct udp_analysis *udpd = (struct udp_analysis *)proto_data;
+
+  wmem_free(wmem_file_scope(), udpd->flow1.username);
+  wmem_free(wmem_file_scope(), udpd->flow1.command);
+  wmem_free(wmem_file_scope(), udpd->flow2.username);
+  wmem_free(wmem_file_scope(), udpd->flow2.command);
+  wmem_free(wmem_file_scope(), udpd);
+}
+
 struct udp_analysis *
 get_udp_conversation_data(conversation_t *conv, packet_info *pinfo)
 {
@@ -585,7 +599,7 @@ handle_export_pdu_conversation(packet_info *pinfo, tvbuff_t *tvb, int uh_dport,
     conversation_t *conversation = find_conversation(pinfo->num, &pinfo->dst, &pinfo->src, ENDPOINT_UDP, uh_dport, uh_sport, 0);
     if (conversation != NULL)
     {
-      dissector_handle_t handle = (dissector_handle_t)wmem_tree_lookup32_le(conversation->dissector_tree, pinfo->num);
+      dissector_handle_t handle = conversation_get_dissector(conversation, pinfo->num);
       if (handle != NULL)
       {
         exp_pdu_data_t *exp_pdu_data = export_pdu_create_common_tags(pinfo, dissector_handle_get_dissector_name(handle), EXP_PDU_TAG_PROTO_NAME);
@@ -1450,6 +1464,7 @@ proto_register_udp(void)
                          udp_port_to_display, follow_tvb_tap_listener);
 
   register_init_routine(udp_init);
+  conversation_register_release_hook(hfi_udp->id, udp_release_conversation_data);
 
 }
 
@@ -491,6 +491,15 @@ epan_get_frame_ts(const epan_t *session, guint32 frame_num)
 	return abs_ts;
 }
 
+void
+epan_get_frame_shift_offset(const epan_t *session, const frame_data *fd, nstime_t *shift_offset)
+{
+	if (fd->has_shift_offset && session && session->funcs.get_frame_shift_offset)
+		session->funcs.get_frame_shift_offset(session->prov, fd, shift_offset);
+	else
+		nstime_set_zero(shift_offset);
+}
+
 void
 epan_free(epan_t *session)
 {
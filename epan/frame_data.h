@@ -86,9 +86,13 @@ typedef struct _frame_data {
   unsigned int has_ts           : 1; /**< 1 = has time stamp, 0 = no time stamp */
   unsigned int has_modified_block : 1; /** 1 = block for this packet has been modified */
   unsigned int need_colorize    : 1; /**< 1 = need to (re-)calculate packet color */
+  unsigned int has_shift_offset : 1; /**< 1 = abs_ts has been shifted, see frame_data_sequence_get_shift_offset() */
   unsigned int tsprec           : 4; /**< Time stamp precision -2^tsprec gives up to femtoseconds */
   nstime_t     abs_ts;       /**< Absolute timestamp */
-  nstime_t     shift_offset; /**< How much the abs_tm of the frame is shifted */
+  /* The offset by which abs_ts has been shifted by the user is kept in
+     the frame_data_sequence the frame belongs to, which only allocates
+     room for the offsets once a time shift is applied; that saves 16
+     bytes per frame on LP64/LLP64 platforms when no time is shifted. */
   guint32      frame_ref_num; /**< Previous reference frame (0 if this is one) */
   guint32      prev_dis_num; /**< Previous displayed frame (0 if first one) */
 } frame_data;
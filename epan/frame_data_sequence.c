@@ -10,6 +10,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <glib.h>
 
 #include <epan/packet.h>
@@ -32,6 +34,9 @@
 struct _frame_data_sequence {
   guint32      count;           /* Total number of frames */
   void        *ptree_root;      /* Pointer to the root node */
+  nstime_t    *shift_offsets;   /* Shift offsets, indexed by frame number - 1; NULL if no frame is shifted */
+  guint32      shift_offsets_len; /* Number of entries in shift_offsets */
+  guint32      shifted_count;   /* Number of frames with a non-zero shift offset */
 };
 
 /*
@@ -55,6 +60,9 @@ new_frame_data_sequence(void)
   fds = (frame_data_sequence *)g_malloc(sizeof *fds);
   fds->count = 0;
   fds->ptree_root = NULL;
+  fds->shift_offsets = NULL;
+  fds->shift_offsets_len = 0;
+  fds->shifted_count = 0;
   return fds;
 }
 
@@ -307,10 +315,71 @@ free_frame_data_sequence(frame_data_sequence *fds)
     free_frame_data_array(fds->ptree_root, fds->count, levels, TRUE);
   }
 
+  g_free(fds->shift_offsets);
+
   /* free the header struct */
   g_free(fds);
 }
 
+/*
+ * Get the amount by which the time stamp of a frame in the sequence
+ * has been shifted; zero if it hasn't been.
+ */
+void
+frame_data_sequence_get_shift_offset(frame_data_sequence *fds,
+    const frame_data *fdata, nstime_t *shift_offset)
+{
+  if (fdata->has_shift_offset && fdata->num - 1 < fds->shift_offsets_len)
+    *shift_offset = fds->shift_offsets[fdata->num - 1];
+  else
+    nstime_set_zero(shift_offset);
+}
+
+/*
+ * Record the amount by which the time stamp of a frame in the sequence
+ * has been shifted.
+ *
+ * Time Shift usually shifts every frame, so the offsets are kept in an
+ * array with an entry for every frame, which is only allocated when the
+ * first frame is shifted and is freed again when no frame is shifted
+ * any more.
+ */
+void
+frame_data_sequence_set_shift_offset(frame_data_sequence *fds,
+    frame_data *fdata, const nstime_t *shift_offset)
+{
+  guint32 idx = fdata->num - 1;
+  guint32 new_len;
+
+  if (shift_offset->secs == 0 && shift_offset->nsecs == 0) {
+    if (fdata->has_shift_offset) {
+      nstime_set_zero(&fds->shift_offsets[idx]);
+      fdata->has_shift_offset = 0;
+      if (--fds->shifted_count == 0) {
+        g_free(fds->shift_offsets);
+        fds->shift_offsets = NULL;
+        fds->shift_offsets_len = 0;
+      }
+    }
+    return;
+  }
+
+  if (idx >= fds->shift_offsets_len) {
+    /* Frames may have been added since the array was allocated. */
+    new_len = MAX(fds->count, idx + 1);
+    fds->shift_offsets = g_renew(nstime_t, fds->shift_offsets, new_len);
+    memset(&fds->shift_offsets[fds->shift_offsets_len], 0,
+           (new_len - fds->shift_offsets_len) * sizeof *fds->shift_offsets);
+    fds->shift_offsets_len = new_len;
+  }
+
+  fds->shift_offsets[idx] = *shift_offset;
+  if (!fdata->has_shift_offset) {
+    fdata->has_shift_offset = 1;
+    fds->shifted_count++;
+  }
+}
+
 void
 find_and_mark_frame_depended_upon(gpointer data, gpointer user_data)
 {
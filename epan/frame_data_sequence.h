@@ -33,6 +33,22 @@ WS_DLL_PUBLIC frame_data *frame_data_sequence_find(frame_data_sequence *fds,
  */
 WS_DLL_PUBLIC void free_frame_data_sequence(frame_data_sequence *fds);
 
+/**
+ * Get the amount by which the absolute time stamp of a frame has been
+ * shifted, i.e. abs_ts minus the time stamp in the file.  This is zero
+ * unless the frame's time has been shifted.
+ */
+WS_DLL_PUBLIC void frame_data_sequence_get_shift_offset(frame_data_sequence *fds,
+    const frame_data *fdata, nstime_t *shift_offset);
+
+/**
+ * Set the amount by which the absolute time stamp of a frame has been
+ * shifted.  This does not change abs_ts itself.  The offset is kept
+ * until it is set back to zero or the sequence is freed.
+ */
+WS_DLL_PUBLIC void frame_data_sequence_set_shift_offset(frame_data_sequence *fds,
+    frame_data *fdata, const nstime_t *shift_offset);
+
 WS_DLL_PUBLIC void find_and_mark_frame_depended_upon(gpointer data, gpointer user_data);
 
 
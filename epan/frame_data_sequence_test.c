@@ -0,0 +1,181 @@
+/* frame_data_sequence_test.c
+ * Standalone program to test the frame_data_sequence routines.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include <epan/frame_data.h>
+#include <epan/frame_data_sequence.h>
+
+#define TEST_FRAME_COUNT 3
+
+/* A sequence of frames one second apart, starting at 1000 s. */
+static frame_data_sequence *
+frame_data_sequence_test_new(void)
+{
+    frame_data_sequence *fds;
+    frame_data fdlocal;
+    guint32 num;
+
+    fds = new_frame_data_sequence();
+    for (num = 1; num <= TEST_FRAME_COUNT; num++) {
+        memset(&fdlocal, 0, sizeof fdlocal);
+        fdlocal.num = num;
+        fdlocal.has_ts = 1;
+        fdlocal.abs_ts.secs = 999 + num;
+        fdlocal.abs_ts.nsecs = 0;
+        frame_data_sequence_add(fds, &fdlocal);
+    }
+    return fds;
+}
+
+static void
+frame_data_sequence_test_set_offset(frame_data_sequence *fds, guint32 num,
+                                    time_t secs, int nsecs)
+{
+    nstime_t shift_offset;
+
+    shift_offset.secs = secs;
+    shift_offset.nsecs = nsecs;
+    frame_data_sequence_set_shift_offset(fds, frame_data_sequence_find(fds, num), &shift_offset);
+}
+
+static void
+frame_data_sequence_test_assert_offset(frame_data_sequence *fds, guint32 num,
+                                       time_t secs, int nsecs)
+{
+    nstime_t shift_offset;
+
+    frame_data_sequence_get_shift_offset(fds, frame_data_sequence_find(fds, num), &shift_offset);
+    g_assert_cmpint(shift_offset.secs, ==, secs);
+    g_assert_cmpint(shift_offset.nsecs, ==, nsecs);
+}
+
+static void
+frame_data_sequence_test_find(void)
+{
+    frame_data_sequence *fds;
+    frame_data *fd;
+    guint32 num;
+
+    fds = frame_data_sequence_test_new();
+    for (num = 1; num <= TEST_FRAME_COUNT; num++) {
+        fd = frame_data_sequence_find(fds, num);
+        g_assert_nonnull(fd);
+        g_assert_cmpuint(fd->num, ==, num);
+        g_assert_cmpint(fd->abs_ts.secs, ==, 999 + num);
+    }
+    g_assert_null(frame_data_sequence_find(fds, 0));
+    g_assert_null(frame_data_sequence_find(fds, TEST_FRAME_COUNT + 1));
+    free_frame_data_sequence(fds);
+}
+
+/* Shift offsets are kept per frame, and survive redissection. */
+static void
+frame_data_sequence_test_shift_offset(void)
+{
+    frame_data_sequence *fds;
+    frame_data *fd;
+    frame_data fdlocal;
+    guint32 num;
+
+    fds = frame_data_sequence_test_new();
+    fd = frame_data_sequence_find(fds, 2);
+
+    /* Frames start out unshifted. */
+    frame_data_sequence_test_assert_offset(fds, 2, 0, 0);
+    g_assert_false(fd->has_shift_offset);
+
+    /* Setting an offset doesn't touch the time stamp or other frames. */
+    frame_data_sequence_test_set_offset(fds, 2, -49, -500000000);
+    g_assert_true(fd->has_shift_offset);
+    g_assert_cmpint(fd->abs_ts.secs, ==, 1001);
+    frame_data_sequence_test_assert_offset(fds, 2, -49, -500000000);
+    frame_data_sequence_test_assert_offset(fds, 1, 0, 0);
+    frame_data_sequence_test_assert_offset(fds, 3, 0, 0);
+
+    /*
+     * Redissect the way rescan_packets() in file.c does.  Every frame is
+     * reset, and the selected one has its per-frame data destroyed when
+     * the epan session is replaced; neither may lose the offset.
+     */
+    for (num = 1; num <= TEST_FRAME_COUNT; num++)
+        frame_data_reset(frame_data_sequence_find(fds, num));
+    frame_data_destroy(fd);
+    g_assert_true(fd->has_shift_offset);
+    frame_data_sequence_test_assert_offset(fds, 2, -49, -500000000);
+
+    /* Setting the offset back to zero drops it. */
+    frame_data_sequence_test_set_offset(fds, 2, 0, 0);
+    g_assert_false(fd->has_shift_offset);
+    frame_data_sequence_test_assert_offset(fds, 2, 0, 0);
+
+    /* Frames added after a shift start out unshifted, and can be shifted. */
+    frame_data_sequence_test_set_offset(fds, 1, 1, 0);
+    memset(&fdlocal, 0, sizeof fdlocal);
+    fdlocal.num = TEST_FRAME_COUNT + 1;
+    fdlocal.has_ts = 1;
+    fdlocal.abs_ts.secs = 999 + fdlocal.num;
+    frame_data_sequence_add(fds, &fdlocal);
+    frame_data_sequence_test_assert_offset(fds, TEST_FRAME_COUNT + 1, 0, 0);
+    frame_data_sequence_test_set_offset(fds, TEST_FRAME_COUNT + 1, 2, 0);
+    frame_data_sequence_test_assert_offset(fds, TEST_FRAME_COUNT + 1, 2, 0);
+    frame_data_sequence_test_assert_offset(fds, 1, 1, 0);
+
+    /* Freeing a sequence with shifted frames releases their offsets. */
+    free_frame_data_sequence(fds);
+}
+
+/* Each sequence, i.e. each capture file, has its own offsets. */
+static void
+frame_data_sequence_test_shift_offset_per_file(void)
+{
+    frame_data_sequence *fds1, *fds2;
+
+    fds1 = frame_data_sequence_test_new();
+    fds2 = frame_data_sequence_test_new();
+
+    frame_data_sequence_test_set_offset(fds1, 1, 3, 0);
+    frame_data_sequence_test_assert_offset(fds2, 1, 0, 0);
+
+    /* Freeing the other sequence leaves the first one's offsets alone. */
+    free_frame_data_sequence(fds2);
+    frame_data_sequence_test_assert_offset(fds1, 1, 3, 0);
+
+    free_frame_data_sequence(fds1);
+}
+
+int
+main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/frame_data_sequence/find", frame_data_sequence_test_find);
+    g_test_add_func("/frame_data_sequence/shift_offset", frame_data_sequence_test_shift_offset);
+    g_test_add_func("/frame_data_sequence/shift_offset_per_file", frame_data_sequence_test_shift_offset_per_file);
+
+    return g_test_run();
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
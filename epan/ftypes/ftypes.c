@@ -10,12 +10,24 @@
 
 #include "ftypes-int.h"
 
+#include <string.h>
+
 #include <wsutil/ws_assert.h>
 
 struct _fvalue_regex_t {
 	GRegex *code;
+	char *literal;		/* lower-cased text every match must contain, or NULL */
+	size_t literal_len;
+	guint refcount;
 };
 
+/* Compiled regexes by pattern, so that the same pattern used in several
+ * filters (the display filter, coloring rules, taps) is compiled once.
+ * Filters may be compiled and freed on more than one thread, so the
+ * cache and the reference counts are protected by regex_cache_mtx. */
+static GHashTable *regex_cache;
+static GMutex regex_cache_mtx;
+
 /* Keep track of ftype_t's via their ftenum number */
 static ftype_t* type_list[FT_NUM_TYPES];
 
@@ -756,11 +768,173 @@ fvalue_matches(const fvalue_t *a, const fvalue_regex_t *b)
 	return a->ftype->cmp_matches(a, b);
 }
 
+/*
+ * Characters that always match themselves outside of a group or class,
+ * whatever options are set in the pattern.
+ */
+static gboolean
+regex_is_plain_char(char c)
+{
+	return g_ascii_isalnum(c) || c == '_' || c == '-' || c == '/' ||
+		c == ':' || c == '@' || c == '=' || c == ',';
+}
+
+/*
+ * Find the longest run of plain characters that any match of the pattern
+ * must contain, so that subjects without it can be rejected before running
+ * the regex. This is deliberately conservative: any alternation gives up,
+ * and anything inside a group or class, escaped, or made optional by a
+ * quantifier ends the current run.
+ */
+static char *
+regex_required_literal(const char *patt, size_t *lenp)
+{
+	const char *p, *run = NULL, *best = NULL;
+	size_t run_len = 0, best_len = 0;
+	int depth = 0;
+	gboolean in_class = FALSE;
+
+	/* '#' starts a comment if the pattern turns on extended mode, and
+	 * \Q...\E quotes would need to be parsed separately. */
+	if (strchr(patt, '|') != NULL || strchr(patt, '#') != NULL ||
+			strstr(patt, "\\Q") != NULL)
+		return NULL;
+
+	/* Inline options such as (?x) or (?i-s), and verbs such as (*UTF),
+	 * change how the rest of the pattern is read, e.g. in extended mode
+	 * "(?x)ab c" matches "abc"; don't try to follow them. */
+	for (p = patt; (p = strchr(p, '(')) != NULL; p++) {
+		if (p[1] == '*' || (p[1] == '?' &&
+				(g_ascii_isalpha(p[2]) || p[2] == '-' || p[2] == '^')))
+			return NULL;
+	}
+
+	for (p = patt; *p != '\0'; p++) {
+		if (in_class) {
+			if (*p == '\\' && p[1] != '\0') {
+				p++;
+			} else if (*p == '[' && (p[1] == ':' || p[1] == '=' || p[1] == '.')) {
+				/* A POSIX class such as [:digit:], [=a=] or [.-.]
+				 * ends with its own ":]", "=]" or ".]", not with
+				 * the first ']'. */
+				char term[3] = { p[1], ']', '\0' };
+				const char *end = strstr(p + 2, term);
+				if (end == NULL)
+					return NULL;
+				p = end + 1;
+			} else if (*p == ']') {
+				in_class = FALSE;
+			}
+			continue;
+		}
+		if (depth == 0 && regex_is_plain_char(*p)) {
+			if (p[1] == '?' || p[1] == '*' || p[1] == '{') {
+				/* This character is optional. */
+				run_len = 0;
+				continue;
+			}
+			if (run_len == 0)
+				run = p;
+			run_len++;
+			if (run_len > best_len) {
+				best = run;
+				best_len = run_len;
+			}
+			if (p[1] == '+') {
+				/* Can repeat, so it ends the run. */
+				run_len = 0;
+			}
+			continue;
+		}
+		run_len = 0;
+		switch (*p) {
+			case '\\':
+				if (p[1] == '\0')
+					break;
+				p++;
+				if (strchr("xopPgkNc0123456789", *p) != NULL) {
+					/* The escape has arguments, such as
+					 * \x41, \p{L} or \k<name>; skip anything
+					 * that might be one of them. */
+					while (p[1] != '\0' && (g_ascii_isalnum(p[1]) ||
+								strchr("{}<>'+_", p[1]) != NULL))
+						p++;
+				}
+				break;
+			case '{':
+				/* The contents of a quantifier aren't text. */
+				if (strchr(p, '}') != NULL)
+					p = strchr(p, '}');
+				break;
+			case '[':
+				in_class = TRUE;
+				/* A ']' right after '[' or "[^" is literal. */
+				if (p[1] == '^')
+					p++;
+				if (p[1] == ']')
+					p++;
+				break;
+			case '(':
+				depth++;
+				break;
+			case ')':
+				if (depth > 0)
+					depth--;
+				break;
+			default:
+				break;
+		}
+	}
+
+	if (best_len < 2)
+		return NULL;
+	*lenp = best_len;
+	return g_ascii_strdown(best, (gssize)best_len);
+}
+
+/* Case-insensitive search for a lower-case ASCII literal in a subject that
+ * can contain anything, including NULs. */
+static gboolean
+regex_subject_has_literal(const char *subj, size_t subj_len,
+		const char *literal, size_t literal_len)
+{
+	const char *end;
+	char first;
+	size_t i;
+
+	if (literal_len > subj_len)
+		return FALSE;
+	first = literal[0];
+	end = subj + subj_len - literal_len;
+	for (; subj <= end; subj++) {
+		if (g_ascii_tolower(*subj) != first)
+			continue;
+		for (i = 1; i < literal_len; i++) {
+			if (g_ascii_tolower(subj[i]) != literal[i])
+				break;
+		}
+		if (i == literal_len)
+			return TRUE;
+	}
+	return FALSE;
+}
+
 fvalue_regex_t *
 fvalue_regex_compile(const char *patt, char **errmsg)
 {
 	GError *regex_error = NULL;
 	GRegex *pcre;
+	struct _fvalue_regex_t *re;
+
+	g_mutex_lock(&regex_cache_mtx);
+	if (regex_cache == NULL)
+		regex_cache = g_hash_table_new(g_str_hash, g_str_equal);
+	re = (struct _fvalue_regex_t *)g_hash_table_lookup(regex_cache, patt);
+	if (re != NULL) {
+		re->refcount++;
+		g_mutex_unlock(&regex_cache_mtx);
+		return re;
+	}
 
 	/*
 	 * As a string is not guaranteed to contain valid UTF-8,
@@ -771,19 +945,27 @@ fvalue_regex_compile(const char *patt, char **errmsg)
 	 * should compile a pattern without G_REGEX_RAW. Additionally,
 	 * we MUST use g_utf8_validate() before calling g_regex_match_full()
 	 * or risk crashes.
+	 *
+	 * G_REGEX_OPTIMIZE makes GLib JIT-compile the pattern where PCRE
+	 * supports it.
 	 */
 	GRegexCompileFlags cflags = G_REGEX_CASELESS | G_REGEX_OPTIMIZE | G_REGEX_RAW;
 
 	pcre = g_regex_new(patt, cflags, 0, &regex_error);
 
 	if (regex_error) {
+		g_mutex_unlock(&regex_cache_mtx);
 		*errmsg = g_strdup(regex_error->message);
 		g_error_free(regex_error);
 		return NULL;
 	}
 
-	struct _fvalue_regex_t *re = g_new(struct _fvalue_regex_t, 1);
+	re = g_new(struct _fvalue_regex_t, 1);
 	re->code = pcre;
+	re->literal = regex_required_literal(patt, &re->literal_len);
+	re->refcount = 1;
+	g_hash_table_insert(regex_cache, (gpointer)g_regex_get_pattern(pcre), re);
+	g_mutex_unlock(&regex_cache_mtx);
 
 	return re;
 }
@@ -791,13 +973,28 @@ fvalue_regex_compile(const char *patt, char **errmsg)
 gboolean
 fvalue_regex_matches(const fvalue_regex_t *regex, const char *subj, gssize subj_size)
 {
+	if (regex->literal != NULL) {
+		if (subj_size < 0)
+			subj_size = (gssize)strlen(subj);
+		if (!regex_subject_has_literal(subj, (size_t)subj_size,
+					regex->literal, regex->literal_len))
+			return FALSE;
+	}
 	return g_regex_match_full(regex->code, subj, subj_size, 0, 0, NULL, NULL);
 }
 
 void
 fvalue_regex_free(fvalue_regex_t *regex)
 {
+	g_mutex_lock(&regex_cache_mtx);
+	if (--regex->refcount > 0) {
+		g_mutex_unlock(&regex_cache_mtx);
+		return;
+	}
+	g_hash_table_remove(regex_cache, g_regex_get_pattern(regex->code));
+	g_mutex_unlock(&regex_cache_mtx);
 	g_regex_unref(regex->code);
+	g_free(regex->literal);
 	g_free(regex);
 }
 
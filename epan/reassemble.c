@@ -533,6 +533,15 @@ reassembly_table_destroy(reassembly_table *table)
 	}
 }
 
+/*
+ * Keep fragment data and reassemble into composite tvbuffs.
+ */
+void
+reassembly_table_set_composite(reassembly_table *table, gboolean composite)
+{
+	table->composite = composite;
+}
+
 /*
  * Look up an fd_head in the fragment table, optionally returning the key
  * for it.
@@ -610,8 +619,16 @@ fragment_delete(reassembly_table *table, const packet_info *pinfo,
 		fragment_item *tmp_fd;
 		tmp_fd=fd->next;
 
-		if (fd->tvb_data && !(fd->flags & FD_SUBSET_TVB))
-			tvb_free(fd->tvb_data);
+		if (fd->tvb_data && !(fd->flags & FD_SUBSET_TVB)) {
+			/*
+			 * A composite reassembled tvbuff refers to the
+			 * fragments' data, so that has to go with it.
+			 */
+			if (table->composite && fd_tvb_data)
+				tvb_add_to_chain(fd_tvb_data, fd->tvb_data);
+			else
+				tvb_free(fd->tvb_data);
+		}
 		g_slice_free(fragment_item, fd);
 		fd=tmp_fd;
 	}
@@ -688,7 +705,7 @@ fragment_add_seq_offset(reassembly_table *table, const packet_info *pinfo, const
  * length to be set again.
  */
 static void
-fragment_reset_defragmentation(fragment_head *fd_head)
+fragment_reset_defragmentation(fragment_head *fd_head, const gboolean composite)
 {
 	/* Caller must ensure that this function is only called when
 	 * defragmentation is safe to undo. */
@@ -696,8 +713,19 @@ fragment_reset_defragmentation(fragment_head *fd_head)
 
 	for (fragment_item *fd_i = fd_head->next; fd_i; fd_i = fd_i->next) {
 		if (!fd_i->tvb_data) {
-			fd_i->tvb_data = tvb_new_subset_remaining(fd_head->tvb_data, fd_i->offset);
-			fd_i->flags |= FD_SUBSET_TVB;
+			if (composite) {
+				/*
+				 * The reassembled data is made of the
+				 * other fragments' data and goes away
+				 * when it's reassembled again, so this
+				 * one needs a copy of its own.
+				 */
+				fd_i->tvb_data = tvb_clone_offset_len(fd_head->tvb_data, fd_i->offset,
+				    tvb_captured_length_remaining(fd_head->tvb_data, fd_i->offset));
+			} else {
+				fd_i->tvb_data = tvb_new_subset_remaining(fd_head->tvb_data, fd_i->offset);
+				fd_i->flags |= FD_SUBSET_TVB;
+			}
 		}
 		fd_i->flags &= (~FD_TOOLONGFRAGMENT) & (~FD_MULTIPLETAILS);
 	}
@@ -790,7 +818,7 @@ fragment_reset_tot_len(reassembly_table *table, const packet_info *pinfo,
 		 * Fragments were reassembled before, clear it to allow
 		 * increasing the reassembled length.
 		 */
-		fragment_reset_defragmentation(fd_head);
+		fragment_reset_defragmentation(fd_head, table->composite);
 	}
 
 	fd_head->datalen = tot_len;
@@ -969,6 +997,31 @@ MERGE_FRAG(fragment_head *fd_head, fragment_item *fd)
 	fd_i->next = fd;
 }
 
+/*
+ * Append "len" bytes of a fragment's data, starting at "offset", to the
+ * composite tvbuff being built for a reassembly.
+ *
+ * The tvbuffs made for this are put in the chain starting at *chain,
+ * rather than in the chain of the fragment's data, so that they can be
+ * freed along with the composite when the reassembly is redone.
+ */
+static void
+fragment_composite_append(tvbuff_t *composite_tvb, tvbuff_t **chain,
+			  tvbuff_t *tvb_data, const guint32 offset,
+			  const guint32 len)
+{
+	tvbuff_t *member;
+
+	member = tvb_new_proxy(tvb_data);
+	if (*chain)
+		tvb_add_to_chain(*chain, member);
+	else
+		*chain = member;
+	if (offset != 0 || len != tvb_captured_length(tvb_data))
+		member = tvb_new_subset_length_caplen(member, offset, len, len);
+	tvb_composite_append(composite_tvb, member);
+}
+
 /*
  * This function adds a new fragment to the fragment hash table.
  * If this is the first fragment seen for this datagram, a new entry
@@ -989,17 +1042,24 @@ MERGE_FRAG(fragment_head *fd_head, fragment_item *fd)
  * using fragment_set_partial_reassembly() before calling fragment_add
  * with the new fragment. FD_TOOLONGFRAGMENT and FD_MULTIPLETAILS flags
  * are lowered when a new extension process is started.
+ *
+ * If "composite" is set, the fragments keep their data once the packet
+ * is defragmented, and the reassembled data is a composite of it; see
+ * reassembly_table_set_composite().
  */
 static gboolean
 fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 		 const packet_info *pinfo, const guint32 frag_offset,
-		 const guint32 frag_data_len, const gboolean more_frags)
+		 const guint32 frag_data_len, const gboolean more_frags,
+		 const gboolean composite)
 {
 	fragment_item *fd;
 	fragment_item *fd_i;
 	guint32 max, dfpos, fraglen, overlap;
 	tvbuff_t *old_tvb_data;
-	guint8 *data;
+	tvbuff_t *composite_tvb = NULL;
+	tvbuff_t *composite_chain = NULL;
+	guint8 *data = NULL;
 
 	/* create new fd describing this fragment */
 	fd = g_slice_new(fragment_item);
@@ -1032,7 +1092,7 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 				 * Yes.  Set flag in already empty fds &
 				 * point old fds to malloc'ed data.
 				 */
-				fragment_reset_defragmentation(fd_head);
+				fragment_reset_defragmentation(fd_head, composite);
 			} else {
 				/*
 				 * No.  Bail out since we have no idea what to
@@ -1191,9 +1251,13 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 	 */
 	/* store old data just in case */
 	old_tvb_data=fd_head->tvb_data;
-	data = (guint8 *) g_malloc(fd_head->datalen);
-	fd_head->tvb_data = tvb_new_real_data(data, fd_head->datalen, fd_head->datalen);
-	tvb_set_free_cb(fd_head->tvb_data, g_free);
+	if (composite && fd_head->datalen) {
+		composite_tvb = tvb_new_composite();
+	} else {
+		data = (guint8 *) g_malloc(fd_head->datalen);
+		fd_head->tvb_data = tvb_new_real_data(data, fd_head->datalen, fd_head->datalen);
+		tvb_set_free_cb(fd_head->tvb_data, g_free);
+	}
 
 	/* add all data fragments */
 	for (dfpos=0,fd_i=fd_head;fd_i;fd_i=fd_i->next) {
@@ -1273,7 +1337,9 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 
 					fd_i->flags    |= FD_OVERLAP;
 					fd_head->flags |= FD_OVERLAP;
-					if ( memcmp(data + fd_i->offset,
+					/* For a composite, this is checked
+					 * below, once all the data is in it. */
+					if ( data && memcmp(data + fd_i->offset,
 							tvb_get_ptr(fd_i->tvb_data, 0, cmp_len),
 							cmp_len)
 							 ) {
@@ -1301,13 +1367,23 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 				 * out rather than mixed with the new ones?
 				 */
 				if (fd_i->offset + fraglen > dfpos) {
-					memcpy(data+dfpos,
-						tvb_get_ptr(fd_i->tvb_data, overlap, fraglen-overlap),
-						fraglen-overlap);
+					if (composite_tvb) {
+						fragment_composite_append(composite_tvb,
+							&composite_chain, fd_i->tvb_data,
+							overlap, fraglen-overlap);
+					} else {
+						memcpy(data+dfpos,
+							tvb_get_ptr(fd_i->tvb_data, overlap, fraglen-overlap),
+							fraglen-overlap);
+					}
 					dfpos = fd_i->offset + fraglen;
 				}
 			}
 
+			/* A composite keeps referring to the fragments' data */
+			if (composite_tvb)
+				continue;
+
 			if (fd_i->flags & FD_SUBSET_TVB)
 				fd_i->flags &= ~FD_SUBSET_TVB;
 			else if (fd_i->tvb_data)
@@ -1317,6 +1393,54 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 		}
 	}
 
+	if (composite_tvb) {
+		if (dfpos < fd_head->datalen) {
+			/*
+			 * Only if there was an error above; fill in the
+			 * rest, as a copy of the data would have.
+			 */
+			guint32 pad_len = fd_head->datalen - dfpos;
+			tvbuff_t *pad_tvb;
+
+			pad_tvb = tvb_new_real_data((guint8 *)g_malloc0(pad_len), pad_len, pad_len);
+			tvb_set_free_cb(pad_tvb, g_free);
+			fragment_composite_append(composite_tvb, &composite_chain,
+				pad_tvb, 0, pad_len);
+			tvb_add_to_chain(composite_chain, pad_tvb);
+		}
+		tvb_composite_finalize(composite_tvb);
+
+		/*
+		 * Make the reassembled tvbuff a proxy for the composite,
+		 * with everything made for it in its chain, so that freeing
+		 * it frees all of that.
+		 */
+		fd_head->tvb_data = tvb_new_proxy(composite_tvb);
+		tvb_add_to_chain(fd_head->tvb_data, composite_chain);
+
+		/* Check the overlapping data, now that it's all in place. */
+		for (dfpos=0,fd_i=fd_head->next;fd_i;fd_i=fd_i->next) {
+			if (!fd_i->len || !fd_i->tvb_data ||
+			    fd_i->offset >= fd_head->datalen ||
+			    fd_i->offset + fd_i->len < fd_i->offset)
+				continue;
+			overlap = dfpos - fd_i->offset;
+			if (overlap) {
+				guint32 cmp_len = MIN(fd_i->len,overlap);
+
+				if (tvb_memeql(fd_head->tvb_data, fd_i->offset,
+						tvb_get_ptr(fd_i->tvb_data, 0, cmp_len),
+						cmp_len)) {
+					fd_i->flags    |= FD_OVERLAPCONFLICT;
+					fd_head->flags |= FD_OVERLAPCONFLICT;
+				}
+			}
+			fraglen = MIN(fd_i->len, fd_head->datalen - fd_i->offset);
+			if (fd_i->offset + fraglen > dfpos)
+				dfpos = fd_i->offset + fraglen;
+		}
+	}
+
 	if (old_tvb_data)
 		tvb_add_to_chain(tvb, old_tvb_data);
 	/* mark this packet as defragmented.
@@ -1510,7 +1634,7 @@ fragment_add_common(reassembly_table *table, tvbuff_t *tvb, const int offset,
 	}
 
 	if (fragment_add_work(fd_head, tvb, offset, pinfo, frag_offset,
-		frag_data_len, more_frags)) {
+		frag_data_len, more_frags, table->composite)) {
 		/*
 		 * Reassembly is complete.
 		 */
@@ -1594,7 +1718,7 @@ fragment_add_check(reassembly_table *table, tvbuff_t *tvb, const int offset,
 	}
 
 	if (fragment_add_work(fd_head, tvb, offset, pinfo, frag_offset,
-		frag_data_len, more_frags)) {
+		frag_data_len, more_frags, table->composite)) {
 		/*
 		 * Reassembly is complete.
 		 * Remove this from the table of in-progress
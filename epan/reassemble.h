@@ -130,6 +130,7 @@ typedef struct {
 	fragment_temporary_key temporary_key_func;
 	fragment_persistent_key persistent_key_func;
 	GDestroyNotify free_temporary_key_func;		/* temporary key destruction function */
+	gboolean composite;				/* see reassembly_table_set_composite() */
 } reassembly_table;
 
 /*
@@ -175,6 +176,21 @@ reassembly_table_init(reassembly_table *table,
 WS_DLL_PUBLIC void
 reassembly_table_destroy(reassembly_table *table);
 
+/*
+ * Have fragment_add(), fragment_add_multiple_ok() and fragment_add_check()
+ * keep the data of each fragment once a datagram has been reassembled,
+ * and make the reassembled tvbuff a composite of the fragments' data
+ * rather than a copy of it.  Reassembling then doesn't copy any data, and extending
+ * a reassembly with fragment_set_partial_reassembly() doesn't copy the
+ * data reassembled so far again; the data is only put in one buffer if
+ * a dissector asks for a pointer to data spanning several fragments.
+ *
+ * This should be set when the table is registered, before anything is
+ * added to it.
+ */
+WS_DLL_PUBLIC void
+reassembly_table_set_composite(reassembly_table *table, gboolean composite);
+
 /*
  * This function adds a new fragment to the reassembly table
  * If this is the first fragment seen for this datagram, a new entry
@@ -1918,6 +1918,120 @@ test_fragment_add_partial_reassembly(void)
     ASSERT(!tvb_memeql(fd_head->tvb_data,190,data,40));
 }
 
+/* This tests fragment_set_partial_reassembly for fragment_add based
+ * reassembly into composite tvbuffs, with a conflicting duplicate.
+ *
+ * We add a sequence of fragments thus:
+ *    seq_off   frame  tvb_off   len   (initial) more_frags
+ *    -------   -----  -------   ---   --------------------
+ *        0       1       10      50   false
+ *       50       2        0      40   true
+ *       50       3        5      40   true (a conflicting duplicate)
+ *       90       4       20     100   false
+ *      190       5        0      40   false
+ */
+static void
+test_fragment_add_composite_partial_reassembly(void)
+{
+    fragment_head *fd_head;
+    fragment_item *fd;
+
+    printf("Starting test test_fragment_add_composite_partial_reassembly\n");
+
+    reassembly_table_set_composite(&test_reassembly_table, TRUE);
+
+    pinfo.num = 1;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 10, &pinfo, 12, NULL,
+                             0, 50, FALSE);
+
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(50,fd_head->datalen);
+    ASSERT_EQ(1,fd_head->reassembled_in);
+    ASSERT_EQ(FD_DEFRAGMENTED|FD_DATALEN_SET,fd_head->flags);
+    ASSERT_NE_POINTER(NULL,fd_head->tvb_data);
+
+    /* the fragment keeps its data */
+    ASSERT_EQ(0,fd_head->next->flags);
+    ASSERT_NE_POINTER(NULL,fd_head->next->tvb_data);
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+10,50));
+
+    fragment_set_partial_reassembly(&test_reassembly_table, &pinfo, 12, NULL);
+
+    pinfo.num = 2;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 0, &pinfo, 12, NULL,
+                         50, 40, TRUE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 3;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 5, &pinfo, 12, NULL,
+                         50, 40, TRUE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    fd_head=fragment_get(&test_reassembly_table, &pinfo, 12, NULL);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(0,fd_head->flags);
+
+    /* no subsets of the old reassembled data */
+    for (fd=fd_head->next; fd; fd=fd->next) {
+        ASSERT_EQ(0,fd->flags);
+        ASSERT_NE_POINTER(NULL,fd->tvb_data);
+    }
+
+    pinfo.num = 4;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 20, &pinfo, 12, NULL,
+                         90, 100, FALSE);
+
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(190,fd_head->datalen);
+    ASSERT_EQ(4,fd_head->reassembled_in);
+    ASSERT_EQ(FD_DEFRAGMENTED|FD_DATALEN_SET|FD_OVERLAP|FD_OVERLAPCONFLICT,fd_head->flags);
+    ASSERT_EQ(190,tvb_captured_length(fd_head->tvb_data));
+
+    fd=fd_head->next;
+    ASSERT_EQ(1,fd->frame);
+    ASSERT_EQ(0,fd->flags);
+    ASSERT_NE_POINTER(NULL,fd->tvb_data);
+    fd=fd->next;
+    ASSERT_EQ(2,fd->frame);
+    ASSERT_EQ(0,fd->flags);
+    ASSERT_NE_POINTER(NULL,fd->tvb_data);
+    fd=fd->next;
+    ASSERT_EQ(3,fd->frame);
+    ASSERT_EQ(FD_OVERLAP|FD_OVERLAPCONFLICT,fd->flags);
+    ASSERT_NE_POINTER(NULL,fd->tvb_data);
+    fd=fd->next;
+    ASSERT_EQ(4,fd->frame);
+    ASSERT_EQ(0,fd->flags);
+    ASSERT_NE_POINTER(NULL,fd->tvb_data);
+    ASSERT_EQ_POINTER(NULL,fd->next);
+
+    /* test the actual reassembly; the first copy of the duplicate wins */
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+10,50));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,50,data,40));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,90,data+20,100));
+
+    /* extend it once more */
+    fragment_set_partial_reassembly(&test_reassembly_table, &pinfo, 12, NULL);
+
+    pinfo.num = 5;
+    fragment_add(&test_reassembly_table, tvb, 0, &pinfo, 12, NULL,
+                 190, 40, FALSE);
+
+    fd_head=fragment_get(&test_reassembly_table, &pinfo, 12, NULL);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(230,fd_head->datalen);
+    ASSERT_EQ(5,fd_head->reassembled_in);
+    ASSERT_EQ(230,tvb_captured_length(fd_head->tvb_data));
+
+    /* a pointer to all of it puts it in one buffer */
+    ASSERT(!memcmp(tvb_get_ptr(fd_head->tvb_data,0,50),data+10,50));
+    ASSERT(!memcmp(tvb_get_ptr(fd_head->tvb_data,0,230)+50,data,40));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,90,data+20,100));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,190,data,40));
+
+    reassembly_table_set_composite(&test_reassembly_table, FALSE);
+}
+
 /* XXX: Is the proper behavior here really throwing an exception instead
  * of setting FD_OVERLAP?
  */
@@ -3301,6 +3415,7 @@ main(int argc _U_, char **argv _U_)
 #endif
         test_simple_fragment_add,              /* frag table only   */
         test_fragment_add_partial_reassembly,
+        test_fragment_add_composite_partial_reassembly,
         test_fragment_add_duplicate_first,
         test_fragment_add_duplicate_middle,
         test_fragment_add_duplicate_last,
@@ -95,6 +95,21 @@ typedef struct _tap_listener_t {
 
 static tap_listener_t *tap_listener_queue=NULL;
 
+/* The fields used by the tap listeners' filters, each of them once, so
+ * that every packet is primed with each field once however many listeners
+ * use it. Built on first use and discarded whenever the listeners or their
+ * filters change. */
+static GArray *tap_listener_hfids=NULL;
+
+static void
+tap_listeners_changed(void)
+{
+	if(tap_listener_hfids){
+		g_array_free(tap_listener_hfids, TRUE);
+		tap_listener_hfids=NULL;
+	}
+}
+
 static GSList *tap_plugins = NULL;
 
 #ifdef HAVE_PLUGINS
@@ -271,11 +286,15 @@ void tap_build_interesting (epan_dissect_t *edt)
 
 	/* loop over all tap listeners and build the list of all
 	   interesting hf_fields */
-	for(tl=tap_listener_queue;tl;tl=tl->next){
-		if(tl->code){
-			epan_dissect_prime_with_dfilter(edt, tl->code);
+	if(!tap_listener_hfids){
+		tap_listener_hfids=g_array_new(FALSE, FALSE, sizeof(int));
+		for(tl=tap_listener_queue;tl;tl=tl->next){
+			if(tl->code){
+				dfilter_add_interesting_fields(tl->code, tap_listener_hfids);
+			}
 		}
 	}
+	epan_dissect_prime_with_hfid_array(edt, tap_listener_hfids);
 }
 
 /* This function is used to delete/initialize the tap queue and prime an
@@ -573,6 +592,7 @@ register_tap_listener(const char *tapname, void *tapdata, const char *fstring,
 	tl->next=tap_listener_queue;
 
 	tap_listener_queue=tl;
+	tap_listeners_changed();
 
 	return NULL;
 }
@@ -604,6 +624,7 @@ set_tap_dfilter(void *tapdata, const char *fstring)
 	}
 
 	if(tl){
+		tap_listeners_changed();
 		if(tl->code){
 			dfilter_free(tl->code);
 			tl->code=NULL;
@@ -637,6 +658,7 @@ tap_listeners_dfilter_recompile(void)
 	dfilter_t *code;
 	gchar *err_msg;
 
+	tap_listeners_changed();
 	for(tl=tap_listener_queue;tl;tl=tl->next){
 		if(tl->code){
 			dfilter_free(tl->code);
@@ -685,6 +707,7 @@ remove_tap_listener(void *tapdata)
 			return;
 		}
 	}
+	tap_listeners_changed();
 	free_tap_listener(tl);
 }
 
@@ -768,6 +791,8 @@ void tap_cleanup(void)
 		head_lq = head_lq->next;
 		free_tap_listener(elem_lq);
 	}
+	tap_listener_queue = NULL;
+	tap_listeners_changed();
 
 	while(head_dl){
 		elem_dl = head_dl;
@@ -381,6 +381,169 @@ test(tvbuff_t *tvb, const gchar* name,
 	return TRUE;
 }
 
+#define MANY_MEMBERS	256
+
+/* Makes a composite out of many small real tvbuffs of varying length,
+ * filled with consecutive byte values, so that every lookup has to find
+ * the right member.  The caller frees the returned data and tvbuffs. */
+static tvbuff_t *
+make_many_member_composite(tvbuff_t *tvb_parent, guint num_members,
+			   guint8 **datap, guint *lengthp)
+{
+	tvbuff_t	*tvb_comp;
+	tvbuff_t	*tvb_member;
+	guint8		*data;
+	guint		length, member_length;
+	guint		i;
+
+	length = 0;
+	for (i = 0; i < num_members; i++)
+		length += 1 + (i % 15);
+	data = (guint8*)g_malloc(length);
+	for (i = 0; i < length; i++)
+		data[i] = (guint8)(i % 251);
+
+	tvb_comp = tvb_new_composite();
+	length = 0;
+	for (i = 0; i < num_members; i++) {
+		member_length = 1 + (i % 15);
+		tvb_member = tvb_new_real_data(&data[length], member_length,
+					       member_length);
+		tvb_set_child_real_data_tvbuff(tvb_parent, tvb_member);
+		tvb_composite_append(tvb_comp, tvb_member);
+		length += member_length;
+	}
+	tvb_composite_finalize(tvb_comp);
+
+	*datap = data;
+	*lengthp = length;
+	return tvb_comp;
+}
+
+/* Checks the searches and comparisons that look at a composite's
+ * members in place, rather than flattening it first. */
+static void
+test_many_members(tvbuff_t *tvb_parent)
+{
+	tvbuff_t		*tvb_comp;
+	guint8			*data;
+	guint			length, i, start;
+	gint			offset;
+	guchar			found_needle;
+	ws_mempbrk_pattern	pattern;
+
+	printf("Making Composite with %u members\n", MANY_MEMBERS);
+	tvb_comp = make_many_member_composite(tvb_parent, MANY_MEMBERS,
+					      &data, &length);
+
+	/* Search from up to 100 bytes, i.e. several members, before each
+	 * byte; values repeat every 251 bytes, so the first match is the
+	 * byte itself, found in a later member than the one searched
+	 * first.  A limit that stops just short of it finds nothing. */
+	for (i = 0; i < length; i++) {
+		start = i < 100 ? 0 : i - 100;
+		offset = tvb_find_guint8(tvb_comp, start, -1, data[i]);
+		if (offset != (gint)i) {
+			printf("14: Failed TVB=Many members Wrong offset for "
+					"guint8:%02x from %u, got %d, expected %u\n",
+					data[i], start, offset, i);
+			failed = TRUE;
+			goto done;
+		}
+		offset = tvb_find_guint8(tvb_comp, start, i - start, data[i]);
+		if (offset != -1) {
+			printf("14: Failed TVB=Many members Found guint8:%02x "
+					"at %d, beyond the limit %u from %u\n",
+					data[i], offset, i - start, start);
+			failed = TRUE;
+			goto done;
+		}
+	}
+	offset = tvb_find_guint8(tvb_comp, 0, -1, 251);
+	if (offset != -1) {
+		printf("14: Failed TVB=Many members Found guint8:%02x at %d, "
+				"which isn't there\n", 251, offset);
+		failed = TRUE;
+		goto done;
+	}
+
+	ws_mempbrk_compile(&pattern, "\xfa\x7f");
+	offset = tvb_ws_mempbrk_pattern_guint8(tvb_comp, 130, -1, &pattern,
+					       &found_needle);
+	if (offset != 250 || found_needle != 0xfa) {
+		printf("15: Failed TVB=Many members Wrong result for mempbrk, "
+				"got %d/%02x, expected 250/fa\n",
+				offset, found_needle);
+		failed = TRUE;
+		goto done;
+	}
+
+	for (i = 0; i + 100 <= length; i += 37) {
+		if (tvb_memeql(tvb_comp, i, &data[i], 100) != 0) {
+			printf("16: Failed TVB=Many members tvb_memeql at %u "
+					"didn't match\n", i);
+			failed = TRUE;
+			goto done;
+		}
+	}
+	if (tvb_memeql(tvb_comp, 1, data, 100) == 0 ||
+	    tvb_memeql(tvb_comp, length - 10, &data[length - 10], 11) == 0) {
+		printf("16: Failed TVB=Many members tvb_memeql matched "
+				"when it shouldn't have\n");
+		failed = TRUE;
+		goto done;
+	}
+
+	test(tvb_comp, "Many members", data, length, length);
+
+done:
+	tvb_free(tvb_comp);
+	g_free(data);
+}
+
+/* Times member lookups in a composite with many members.  This isn't
+ * run as part of the tests; run "tvbtest --benchmark" to see it. */
+static void
+run_benchmark(void)
+{
+	static const guint	member_counts[] = { 16, 256, 4096, 65536 };
+	tvbuff_t		*tvb_parent;
+	tvbuff_t		*tvb_comp;
+	guint8			*data;
+	guint			length, i, n;
+	guint32			sum;
+	gint64			start, elapsed;
+
+	tvb_parent = tvb_new_real_data((const guint8*)"", 0, 0);
+	for (n = 0; n < G_N_ELEMENTS(member_counts); n++) {
+		tvb_comp = make_many_member_composite(tvb_parent,
+						      member_counts[n], &data, &length);
+
+		/* Stride through the data so that the last member looked
+		 * up is rarely the one that's wanted. */
+		sum = 0;
+		start = g_get_monotonic_time();
+		for (i = 0; i < 1000000; i++)
+			sum += tvb_get_guint8(tvb_comp, (i * 7919) % length);
+		elapsed = g_get_monotonic_time() - start;
+		printf("%6u members: %" G_GINT64_FORMAT " us for 1000000 "
+				"lookups (checksum %u)\n",
+				member_counts[n], elapsed, sum);
+
+		start = g_get_monotonic_time();
+		for (i = 0; i < 100; i++)
+			sum += tvb_find_guint8(tvb_comp, 0, -1, 251) == -1;
+		elapsed = g_get_monotonic_time() - start;
+		printf("%6u members: %" G_GINT64_FORMAT " us for 100 "
+				"unsuccessful searches\n",
+				member_counts[n], elapsed);
+
+		tvb_free(tvb_comp);
+		g_free(data);
+	}
+	tvb_free_chain(tvb_parent);
+}
+
 static void
 run_tests(void)
 {
@@ -594,6 +757,9 @@ run_tests(void)
 	/* Test the subset of the composite. */
 	test(tvb_comp_subset, "Subset of Composite", comp_subset, comp_subset_length, comp_subset_reported_length);
 
+	/* Test a composite with many members. */
+	test_many_members(tvb_parent);
+
 	/* free memory. */
 	/* Don't free: comp[0] */
 	g_free(comp[1]);
@@ -607,13 +773,18 @@ run_tests(void)
 
 /* Note: valgrind can be used to check for tvbuff memory leaks */
 int
-main(void)
+main(int argc, char **argv)
 {
 	/* For valgrind: See GLib documentation: "Running GLib Applications" */
 	g_setenv("G_DEBUG", "gc-friendly", 1);
 	g_setenv("G_SLICE", "always-malloc", 1);
 
 	except_init();
+	if (argc > 1 && strcmp(argv[1], "--benchmark") == 0) {
+		run_benchmark();
+		except_deinit();
+		exit(0);
+	}
 	run_tests();
 	except_deinit();
 	exit(failed?1:0);
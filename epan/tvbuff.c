@@ -2592,6 +2592,26 @@ gint
 tvb_memeql(tvbuff_t *tvb, const gint offset, const guint8 *str, size_t size)
 {
 	const guint8 *ptr;
+	guint8        chunk[64];
+	guint         abs_offset, abs_length, done, n;
+
+	/*
+	 * If the data isn't in a single buffer, e.g. because this is
+	 * a composite tvbuff, compare it a piece at a time rather than
+	 * making all of the tvbuff's data contiguous.
+	 */
+	if (!tvb->real_data && tvb->ops->tvb_memcpy && size <= G_MAXINT) {
+		if (check_offset_length_no_exception(tvb, offset, (gint) size,
+						     &abs_offset, &abs_length))
+			return -1;
+		for (done = 0; done < abs_length; done += n) {
+			n = MIN(abs_length - done, (guint) sizeof chunk);
+			tvb->ops->tvb_memcpy(tvb, chunk, abs_offset + done, n);
+			if (memcmp(chunk, str + done, n) != 0)
+				return -1;
+		}
+		return 0;
+	}
 
 	ptr = ensure_contiguous_no_exception(tvb, offset, (gint) size, NULL);
 
@@ -22,6 +22,7 @@
 #include <wsutil/file_util.h>
 #include <wsutil/filesystem.h>
 #include <wsutil/json_dumper.h>
+#include <wsutil/str_util.h>
 #include <wsutil/wslog.h>
 #include <wsutil/ws_assert.h>
 #include <ui/version_info.h>
@@ -244,6 +245,15 @@ ws_get_frame_ts(struct packet_provider_data *prov, guint32 frame_num)
   return NULL;
 }
 
+static void
+ws_get_frame_shift_offset(struct packet_provider_data *prov, const frame_data *fd, nstime_t *shift_offset)
+{
+  if (prov->frames)
+    frame_data_sequence_get_shift_offset(prov->frames, fd, shift_offset);
+  else
+    nstime_set_zero(shift_offset);
+}
+
 static epan_t *
 ws_epan_new(capture_file *cf)
 {
@@ -251,7 +261,8 @@ ws_epan_new(capture_file *cf)
     ws_get_frame_ts,
     cap_file_provider_get_interface_name,
     cap_file_provider_get_interface_description,
-    cap_file_provider_get_modified_block
+    cap_file_provider_get_modified_block,
+    ws_get_frame_shift_offset
   };
 
   return epan_new(&cf->provider, &funcs);
@@ -1240,6 +1251,31 @@ add_packet_to_packet_list(frame_data *fdata, capture_file *cf,
   epan_dissect_reset(edt);
 }
 
+/*
+ * Mark an already-dissected frame as displayed without dissecting it
+ * again.  This is only valid if there's no display filter and nothing
+ * else (taps, columns, postdissectors) needs the results of a
+ * dissection; every frame then passes, and only the per-frame
+ * bookkeeping done by add_packet_to_packet_list() is needed.
+ */
+static void
+add_unfiltered_packet_to_packet_list(frame_data *fdata, capture_file *cf)
+{
+  frame_data_set_before_dissect(fdata, &cf->elapsed_time,
+                                &cf->provider.ref, cf->provider.prev_dis);
+  cf->provider.prev_cap = fdata;
+
+  fdata->passed_dfilter = 1;
+  cf->displayed_count++;
+
+  frame_data_set_after_dissect(fdata, &cf->cum_bytes);
+  cf->provider.prev_dis = fdata;
+
+  if (cf->first_displayed == 0)
+    cf->first_displayed = fdata->num;
+  cf->last_displayed = fdata->num;
+}
+
 /*
  * Read in a new record.
  * Returns TRUE if the packet was added to the packet (record) list,
@@ -1643,6 +1679,7 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
   gboolean    create_proto_tree;
   guint       tap_flags;
   gboolean    add_to_packet_list = FALSE;
+  gboolean    skip_dissection;
   gboolean    compiled _U_;
   guint32     frames_count;
   gboolean    queued_rescan_type = RESCAN_NONE;
@@ -1686,6 +1723,26 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
      (tap_flags & TL_REQUIRES_PROTO_TREE) ||
      (redissect && postdissectors_want_hfids()));
 
+  /*
+   * If we're just clearing the display filter, and nothing else wants
+   * the result of a dissection, every frame that's already been
+   * dissected passes, so there's no need to read and dissect it again;
+   * that turns "Clear filter" on a large file from a full rescan into a
+   * pass over the frame list.  Frames that haven't been visited yet
+   * (e.g. because a previous redissection was aborted) still get
+   * dissected.
+   *
+   * XXX - applying a non-empty filter still dissects every frame, one
+   * after another, on this thread.  Splitting the frames among worker
+   * threads, each with its own epan_dissect_t, would need dissection to
+   * be thread-safe, and it isn't: dissectors update conversations,
+   * reassembly tables, per-frame protocol data and the file scope
+   * allocator, and later frames depend on what was done for earlier
+   * ones.
+   */
+  skip_dissection = !redissect && dfcode == NULL && cinfo == NULL &&
+    !tap_listeners_require_dissection();
+
   reset_tap_listeners();
   /* Which frame, if any, is the currently selected frame?
      XXX - should the selected frame or the focus frame be the "current"
@@ -1858,7 +1915,8 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
     /* Frame dependencies from the previous dissection/filtering are no longer valid. */
     fdata->dependent_of_displayed = 0;
 
-    if (!cf_read_record(cf, fdata, &rec, &buf))
+    if (!(skip_dissection && fdata->visited) &&
+        !cf_read_record(cf, fdata, &rec, &buf))
       break; /* error reading the frame */
 
     /* If the previous frame is displayed, and we haven't yet seen the
@@ -1869,9 +1927,13 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
       preceding_frame = prev_frame;
     }
 
-    add_packet_to_packet_list(fdata, cf, &edt, dfcode,
-                                    cinfo, &rec, &buf,
-                                    add_to_packet_list);
+    if (skip_dissection && fdata->visited) {
+      add_unfiltered_packet_to_packet_list(fdata, cf);
+    } else {
+      add_packet_to_packet_list(fdata, cf, &edt, dfcode,
+                                      cinfo, &rec, &buf,
+                                      add_to_packet_list);
+    }
 
     /* If this frame is displayed, and this is the first frame we've
        seen displayed after the selected frame, remember this frame -
@@ -3360,6 +3422,7 @@ match_narrow(capture_file *cf, frame_data *fdata,
   guint32       i;
   guint8        c_char;
   size_t        c_match    = 0;
+  const guint8 *match;
 
   /* Load the frame's data. */
   if (!cf_read_record(cf, fdata, rec, buf)) {
@@ -3370,11 +3433,22 @@ match_narrow(capture_file *cf, frame_data *fdata,
   result = MR_NOTMATCHED;
   buf_len = fdata->cap_len;
   pd = ws_buffer_start_ptr(buf);
+
+  if (!cf->case_type) {
+    /* Case-sensitive, so this is a plain substring search. */
+    match = ws_memmem(pd, buf_len, ascii_text, textlen);
+    if (match != NULL) {
+      result = MR_MATCHED;
+      /* Save the position of the last character for highlighting the field. */
+      cf->search_pos = (guint32)(match - pd + textlen - 1);
+      cf->search_len = (guint32)textlen;
+    }
+    return result;
+  }
+
   i = 0;
   while (i < buf_len) {
-    c_char = pd[i];
-    if (cf->case_type)
-      c_char = g_ascii_toupper(c_char);
+    c_char = g_ascii_toupper(pd[i]);
     if (c_char == ascii_text[c_match]) {
       c_match += 1;
       if (c_match == textlen) {
@@ -3453,10 +3527,8 @@ match_binary(capture_file *cf, frame_data *fdata,
   const guint8 *binary_data = info->data;
   size_t        datalen     = info->data_len;
   match_result  result;
-  guint32       buf_len;
-  guint8       *pd;
-  guint32       i;
-  size_t        c_match     = 0;
+  const guint8 *pd;
+  const guint8 *match;
 
   /* Load the frame's data. */
   if (!cf_read_record(cf, fdata, rec, buf)) {
@@ -3465,26 +3537,13 @@ match_binary(capture_file *cf, frame_data *fdata,
   }
 
   result = MR_NOTMATCHED;
-  buf_len = fdata->cap_len;
   pd = ws_buffer_start_ptr(buf);
-  i = 0;
-  while (i < buf_len) {
-    if (pd[i] == binary_data[c_match]) {
-      c_match += 1;
-      if (c_match == datalen) {
-        result = MR_MATCHED;
-        cf->search_pos = i; /* Save the position of the last character
-                               for highlighting the field. */
-        cf->search_len = (guint32)datalen;
-        break;
-      }
-    }
-    else {
-      ws_assert(i>=c_match);
-      i -= (guint32)c_match;
-      c_match = 0;
-    }
-    i += 1;
+  match = ws_memmem(pd, fdata->cap_len, binary_data, datalen);
+  if (match != NULL) {
+    result = MR_MATCHED;
+    /* Save the position of the last character for highlighting the field. */
+    cf->search_pos = (guint32)(match - pd + datalen - 1);
+    cf->search_len = (guint32)datalen;
   }
   return result;
 }
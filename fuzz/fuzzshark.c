@@ -102,6 +102,7 @@ fuzzshark_epan_new(void)
 		fuzzshark_get_frame_ts,
 		NULL,
 		NULL,
+		NULL,
 		NULL
 	};
 
@@ -46,6 +46,13 @@
 
 #include "ui/failure_message.h"
 
+#define LONGOPT_BENCHMARK LONGOPT_BASE_APPLICATION+1
+
+typedef struct {
+  gboolean verbose;       /* report progress */
+  int      record_count;  /* records merged, once done */
+} merge_callback_data_t;
+
 /*
  * Show the usage
  */
@@ -68,6 +75,7 @@ print_usage(FILE *output)
   fprintf(output, "Miscellaneous:\n");
   fprintf(output, "  -h                display this help and exit.\n");
   fprintf(output, "  -v                verbose output.\n");
+  fprintf(output, "  --benchmark       report the time taken and the records merged per second.\n");
   fprintf(output, "  -V                print version information and exit.\n");
 }
 
@@ -119,10 +127,16 @@ list_idb_merge_modes(void) {
 static gboolean
 merge_callback(merge_event event, int num,
                const merge_in_file_t in_files[], const guint in_file_count,
-               void *data _U_)
+               void *data)
 {
+  merge_callback_data_t *cb_data = (merge_callback_data_t *)data;
   guint i;
 
+  if (event == MERGE_EVENT_DONE)
+    cb_data->record_count = num;
+  if (!cb_data->verbose)
+    return FALSE;
+
   switch (event) {
 
     case MERGE_EVENT_INPUT_FILES_OPENED:
@@ -201,10 +215,14 @@ main(int argc, char *argv[])
   static const struct ws_option long_options[] = {
       {"help", ws_no_argument, NULL, 'h'},
       {"version", ws_no_argument, NULL, 'V'},
+      {"benchmark", ws_no_argument, NULL, LONGOPT_BENCHMARK},
       {0, 0, 0, 0 }
   };
   gboolean            do_append          = FALSE;
   gboolean            verbose            = FALSE;
+  gboolean            benchmark          = FALSE;
+  gint64              start_time         = 0;
+  double              elapsed;
   int                 in_file_count      = 0;
   guint32             snaplen            = 0;
   int                 file_type          = WTAP_FILE_TYPE_SUBTYPE_UNKNOWN;
@@ -216,6 +234,7 @@ main(int argc, char *argv[])
   merge_result        status             = MERGE_OK;
   idb_merge_mode      mode               = IDB_MERGE_MODE_MAX;
   merge_progress_callback_t cb;
+  merge_callback_data_t cb_data;
 
   cmdarg_err_init(mergecap_cmdarg_err, mergecap_cmdarg_err_cont);
 
@@ -306,6 +325,10 @@ main(int argc, char *argv[])
       out_filename = ws_optarg;
       break;
 
+    case LONGOPT_BENCHMARK:
+      benchmark = TRUE;
+      break;
+
     case '?':              /* Bad options if GNU getopt */
       switch(ws_optopt) {
       case'F':
@@ -327,8 +350,10 @@ main(int argc, char *argv[])
   if (file_type == WTAP_FILE_TYPE_SUBTYPE_UNKNOWN)
     file_type = wtap_pcapng_file_type_subtype();
 
+  cb_data.verbose = verbose;
+  cb_data.record_count = 0;
   cb.callback_func = merge_callback;
-  cb.data = NULL;
+  cb.data = &cb_data;
 
   /* check for proper args; at a minimum, must have an output
    * filename and one input file
@@ -361,6 +386,9 @@ main(int argc, char *argv[])
     mode = IDB_MERGE_MODE_ALL_SAME;
   }
 
+  if (benchmark)
+    start_time = g_get_monotonic_time();
+
   /* open the outfile */
   if (strcmp(out_filename, "-") == 0) {
     /* merge the files to the standard output */
@@ -368,19 +396,27 @@ main(int argc, char *argv[])
                                    (const char *const *) &argv[ws_optind],
                                    in_file_count, do_append, mode, snaplen,
                                    get_appname_and_version(),
-                                   verbose ? &cb : NULL,
+                                   (verbose || benchmark) ? &cb : NULL,
                                    &err, &err_info, &err_fileno, &err_framenum);
   } else {
     /* merge the files to the outfile */
     status = merge_files(out_filename, file_type,
                          (const char *const *) &argv[ws_optind], in_file_count,
                          do_append, mode, snaplen, get_appname_and_version(),
-                         verbose ? &cb : NULL,
+                         (verbose || benchmark) ? &cb : NULL,
                          &err, &err_info, &err_fileno, &err_framenum);
   }
 
   switch (status) {
     case MERGE_OK:
+      if (benchmark) {
+        elapsed = (g_get_monotonic_time() - start_time) / 1000000.0;
+        fprintf(stderr, "mergecap: merged %d records from %d files in %.3f seconds",
+                cb_data.record_count, in_file_count, elapsed);
+        if (elapsed > 0.0)
+          fprintf(stderr, " (%.0f records/s)", cb_data.record_count / elapsed);
+        fprintf(stderr, "\n");
+      }
       break;
 
     case MERGE_USER_ABORTED:
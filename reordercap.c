@@ -18,6 +18,7 @@
 #include <wsutil/ws_getopt.h>
 
 #include <wiretap/wtap.h>
+#include <wiretap/frame_index.h>
 
 #include <ui/cmdarg_err.h>
 #include <ui/exit_codes.h>
@@ -131,6 +132,64 @@ frames_compare(gconstpointer a, gconstpointer b)
     return nstime_cmp(time1, time2);
 }
 
+/*
+ * If there's an up-to-date frame index for the input file, get the
+ * frame offsets and time stamps from it rather than by reading the
+ * whole file.  That's only possible if all the sections and interfaces
+ * of the file are known once it's been opened, as wtap_seek_read()
+ * relies on having seen them.
+ *
+ * Returns TRUE if the frames were taken from the index.
+ */
+static gboolean
+frames_from_frame_index(const char *infile, wtap *wth, GPtrArray *frames,
+                        guint *wrong_order_count)
+{
+    wtap_frame_index *idx;
+    wtapng_iface_descriptions_t *idb_inf;
+    guint num_interfaces;
+    FrameRecord_t *prevFrame = NULL;
+    guint32 i;
+
+    idx = wtap_frame_index_open(infile);
+    if (idx == NULL)
+        return FALSE;
+
+    idb_inf = wtap_file_get_idb_info(wth);
+    num_interfaces = idb_inf->interface_data->len;
+    g_free(idb_inf);
+    if (wtap_frame_index_num_shbs(idx) != wtap_file_get_num_shbs(wth) ||
+        wtap_frame_index_num_interfaces(idx) != num_interfaces) {
+        wtap_frame_index_close(idx);
+        return FALSE;
+    }
+
+    for (i = 0; i < wtap_frame_index_count(idx); i++) {
+        const wtap_frame_index_entry *entry = wtap_frame_index_get(idx, i);
+        FrameRecord_t *newFrameRecord;
+
+        newFrameRecord = g_slice_new(FrameRecord_t);
+        newFrameRecord->num = frames->len + 1;
+        newFrameRecord->offset = entry->file_off;
+        if (entry->presence_flags & WTAP_HAS_TS) {
+            newFrameRecord->frame_time.secs = (time_t)entry->ts_secs;
+            newFrameRecord->frame_time.nsecs = entry->ts_nsecs;
+        } else {
+            nstime_set_unset(&newFrameRecord->frame_time);
+        }
+
+        if (prevFrame && frames_compare(&newFrameRecord, &prevFrame) < 0) {
+           (*wrong_order_count)++;
+        }
+
+        g_ptr_array_add(frames, newFrameRecord);
+        prevFrame = newFrameRecord;
+    }
+
+    wtap_frame_index_close(idx);
+    return TRUE;
+}
+
 /*
  * General errors and warnings are reported with an console message
  * in reordercap.
@@ -297,34 +356,38 @@ main(int argc, char *argv[])
     /* Allocate the array of frame pointers. */
     frames = g_ptr_array_new();
 
-    /* Read each frame from infile */
-    wtap_rec_init(&rec);
-    ws_buffer_init(&buf, 1514);
-    while (wtap_read(wth, &rec, &buf, &err, &err_info, &data_offset)) {
-        FrameRecord_t *newFrameRecord;
-
-        newFrameRecord = g_slice_new(FrameRecord_t);
-        newFrameRecord->num = frames->len + 1;
-        newFrameRecord->offset = data_offset;
-        if (rec.presence_flags & WTAP_HAS_TS) {
-            newFrameRecord->frame_time = rec.ts;
-        } else {
-            nstime_set_unset(&newFrameRecord->frame_time);
+    /* Read each frame from infile, unless there's a frame index for it */
+    if (frames_from_frame_index(infile, wth, frames, &wrong_order_count)) {
+        DEBUG_PRINT("Using frame index for %s\n", infile);
+    } else {
+        wtap_rec_init(&rec);
+        ws_buffer_init(&buf, 1514);
+        while (wtap_read(wth, &rec, &buf, &err, &err_info, &data_offset)) {
+            FrameRecord_t *newFrameRecord;
+
+            newFrameRecord = g_slice_new(FrameRecord_t);
+            newFrameRecord->num = frames->len + 1;
+            newFrameRecord->offset = data_offset;
+            if (rec.presence_flags & WTAP_HAS_TS) {
+                newFrameRecord->frame_time = rec.ts;
+            } else {
+                nstime_set_unset(&newFrameRecord->frame_time);
+            }
+
+            if (prevFrame && frames_compare(&newFrameRecord, &prevFrame) < 0) {
+               wrong_order_count++;
+            }
+
+            g_ptr_array_add(frames, newFrameRecord);
+            prevFrame = newFrameRecord;
+            wtap_rec_reset(&rec);
         }
-
-        if (prevFrame && frames_compare(&newFrameRecord, &prevFrame) < 0) {
-           wrong_order_count++;
+        wtap_rec_cleanup(&rec);
+        ws_buffer_free(&buf);
+        if (err != 0) {
+          /* Print a message noting that the read failed somewhere along the line. */
+          cfile_read_failure_message(infile, err, err_info);
         }
-
-        g_ptr_array_add(frames, newFrameRecord);
-        prevFrame = newFrameRecord;
-        wtap_rec_reset(&rec);
-    }
-    wtap_rec_cleanup(&rec);
-    ws_buffer_free(&buf);
-    if (err != 0) {
-      /* Print a message noting that the read failed somewhere along the line. */
-      cfile_read_failure_message(infile, err, err_info);
     }
 
     printf("%u frames, %u out of order\n", frames->len, wrong_order_count);
@@ -52,19 +52,48 @@
 #endif
 
 #include "ringbuffer.h"
+#include "writecap/pcapio.h"
 #include <wsutil/file_util.h>
+#include <wsutil/wslog.h>
 
 #ifdef HAVE_ZLIB
 #include <zlib.h>
 #endif
 
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef HAVE_LZ4FRAME_H
+#include <lz4frame.h>
+#endif
+
+struct _rb_file;
+
+/* A ringbuffer file waiting to be, or being, compressed */
+typedef struct _rb_compress_job {
+  gchar           *name;
+  struct _rb_file *rfile;             /**< slot of the file, NULL once the slot has moved on */
+  gboolean         discard;           /**< the slot was reused; remove the file when done */
+} rb_compress_job;
+
 /* Ringbuffer file structure */
 typedef struct _rb_file {
-  gchar         *name;
+  gchar           *name;
+  rb_compress_job *compress_job;      /**< pending compression of the file, if any */
 } rb_file;
 
 #define MAX_FILENAME_QUEUE  100
 
+/*
+ * Number of threads compressing finished files, and the number of files
+ * that may be waiting for one of them.  If compression falls further
+ * behind than that, files are left uncompressed rather than holding up
+ * the capture.
+ */
+#define RINGBUF_COMPRESS_THREADS    2
+#define RINGBUF_COMPRESS_QUEUE_MAX  16
+
 /** Ringbuffer data structure */
 typedef struct _ringbuf_data {
   rb_file      *files;
@@ -84,6 +113,9 @@ typedef struct _ringbuf_data {
 
   GMutex        mutex;               /**< mutex for oldnames */
   gchar        *oldnames[MAX_FILENAME_QUEUE];       /**< filename list of pending to be deleted */
+
+  GThreadPool  *compress_pool;       /**< workers compressing finished files */
+  GMutex        compress_mutex;      /**< mutex for the compress jobs */
 } ringbuf_data;
 
 static ringbuf_data rb_data;
@@ -125,80 +157,354 @@ static void CleanupOldCap(gchar* name)
 }
 
 /*
- * compress capture file
+ * Extension added to the name of compressed files, or NULL if files
+ * aren't compressed.
  */
-static int ringbuf_exec_compress(gchar* name)
+static const char *ringbuf_compress_extension(void)
 {
-  guint8  *buffer = NULL;
-  gchar* outgz = NULL;
-  int  fd = -1;
-  ssize_t nread;
-  gboolean delete_org_file = TRUE;
-  gzFile fi = NULL;
+  if (rb_data.compress_type == NULL)
+    return NULL;
+  if (strcmp(rb_data.compress_type, "gzip") == 0)
+    return "gz";
+#ifdef HAVE_ZSTD
+  if (strcmp(rb_data.compress_type, "zstd") == 0)
+    return "zst";
+#endif
+#ifdef HAVE_LZ4FRAME_H
+  if (strcmp(rb_data.compress_type, "lz4") == 0)
+    return "lz4";
+#endif
+  return NULL;
+}
 
-  fd = ws_open(name, O_RDONLY | O_BINARY, 0000);
-  if (fd < 0) {
-    return -1;
+#define FS_READ_SIZE 65536
+
+/*
+ * zstd and lz4 output is split into independent frames of this much
+ * uncompressed data; wiretap can seek to the start of any frame
+ * rather than decompressing from the beginning of the file.
+ */
+#define COMPRESS_FRAME_SIZE (4 * 1024 * 1024)
+
+static gboolean write_all(int fd, const void *data, size_t len)
+{
+  const guint8 *p = (const guint8 *)data;
+  ssize_t nwritten;
+
+  while (len > 0) {
+    nwritten = ws_write(fd, p, (unsigned int)len);
+    if (nwritten <= 0)
+      return FALSE;
+    p += nwritten;
+    len -= nwritten;
   }
+  return TRUE;
+}
 
-  outgz = g_strdup_printf("%s.gz", name);
-  fi = gzopen(outgz, "wb");
-  g_free(outgz);
+static gboolean ringbuf_compress_gzip(int fd, const gchar *outname)
+{
+  guint8  *buffer;
+  ssize_t nread;
+  gboolean ok = TRUE;
+  gzFile fi;
+
+  fi = gzopen(outname, "wb");
   if (fi == NULL) {
-    ws_close(fd);
-    return -1;
+    return FALSE;
   }
 
-#define FS_READ_SIZE 65536
   buffer = (guint8*)g_malloc(FS_READ_SIZE);
-  if (buffer == NULL) {
-    ws_close(fd);
-    gzclose(fi);
-    return -1;
-  }
-
   while ((nread = ws_read(fd, buffer, FS_READ_SIZE)) > 0) {
     int n = gzwrite(fi, buffer, (unsigned int)nread);
     if (n <= 0) {
-      /* mark compression as failed */
-      delete_org_file = FALSE;
+      ok = FALSE;
       break;
     }
   }
   if (nread < 0) {
-    /* mark compression as failed */
-    delete_org_file = FALSE;
+    ok = FALSE;
+  }
+  if (gzclose(fi) != Z_OK) {
+    ok = FALSE;
   }
-  ws_close(fd);
-  gzclose(fi);
   g_free(buffer);
+  return ok;
+}
+
+#ifdef HAVE_ZSTD
+static gboolean zstd_end_frame(ZSTD_CStream *cstream, int out_fd, guint8 *out_buf, size_t out_size)
+{
+  ZSTD_outBuffer output;
+  size_t ret;
+
+  do {
+    output.dst = out_buf;
+    output.size = out_size;
+    output.pos = 0;
+    ret = ZSTD_endStream(cstream, &output);
+    if (ZSTD_isError(ret) || !write_all(out_fd, out_buf, output.pos))
+      return FALSE;
+  } while (ret != 0);
+  return TRUE;
+}
+
+static gboolean ringbuf_compress_zstd(int fd, int out_fd)
+{
+  ZSTD_CStream *cstream;
+  size_t in_size = ZSTD_CStreamInSize();
+  size_t out_size = ZSTD_CStreamOutSize();
+  guint8 *in_buf, *out_buf;
+  ZSTD_inBuffer input;
+  ZSTD_outBuffer output;
+  ssize_t nread = 0;
+  size_t frame_len = 0;
+  size_t ret;
+  gboolean ok = TRUE;
+
+  cstream = ZSTD_createCStream();
+  if (cstream == NULL || ZSTD_isError(ZSTD_initCStream(cstream, 3))) {
+    ZSTD_freeCStream(cstream);
+    return FALSE;
+  }
+  in_buf = (guint8*)g_malloc(in_size);
+  out_buf = (guint8*)g_malloc(out_size);
+
+  while (ok && (nread = ws_read(fd, in_buf, (unsigned int)in_size)) > 0) {
+    if (frame_len >= COMPRESS_FRAME_SIZE) {
+      if (!zstd_end_frame(cstream, out_fd, out_buf, out_size) ||
+          ZSTD_isError(ZSTD_initCStream(cstream, 3))) {
+        ok = FALSE;
+        break;
+      }
+      frame_len = 0;
+    }
+    input.src = in_buf;
+    input.size = nread;
+    input.pos = 0;
+    while (input.pos < input.size) {
+      output.dst = out_buf;
+      output.size = out_size;
+      output.pos = 0;
+      ret = ZSTD_compressStream(cstream, &output, &input);
+      if (ZSTD_isError(ret) || !write_all(out_fd, out_buf, output.pos)) {
+        ok = FALSE;
+        break;
+      }
+    }
+    frame_len += nread;
+  }
+  if (nread < 0) {
+    ok = FALSE;
+  }
+  if (ok) {
+    ok = zstd_end_frame(cstream, out_fd, out_buf, out_size);
+  }
+
+  ZSTD_freeCStream(cstream);
+  g_free(in_buf);
+  g_free(out_buf);
+  return ok;
+}
+#endif
+
+#ifdef HAVE_LZ4FRAME_H
+static gboolean ringbuf_compress_lz4(int fd, int out_fd)
+{
+  LZ4F_cctx *cctx;
+  size_t out_size = LZ4F_compressBound(FS_READ_SIZE, NULL) + 64;
+  guint8 *in_buf, *out_buf;
+  ssize_t nread = 0;
+  size_t frame_len = 0;
+  size_t ret;
+  gboolean ok = TRUE;
+
+  if (LZ4F_isError(LZ4F_createCompressionContext(&cctx, LZ4F_VERSION))) {
+    return FALSE;
+  }
+  in_buf = (guint8*)g_malloc(FS_READ_SIZE);
+  out_buf = (guint8*)g_malloc(out_size);
+
+  ret = LZ4F_compressBegin(cctx, out_buf, out_size, NULL);
+  if (LZ4F_isError(ret) || !write_all(out_fd, out_buf, ret)) {
+    ok = FALSE;
+  }
+  while (ok && (nread = ws_read(fd, in_buf, FS_READ_SIZE)) > 0) {
+    if (frame_len >= COMPRESS_FRAME_SIZE) {
+      ret = LZ4F_compressEnd(cctx, out_buf, out_size, NULL);
+      if (LZ4F_isError(ret) || !write_all(out_fd, out_buf, ret)) {
+        ok = FALSE;
+        break;
+      }
+      ret = LZ4F_compressBegin(cctx, out_buf, out_size, NULL);
+      if (LZ4F_isError(ret) || !write_all(out_fd, out_buf, ret)) {
+        ok = FALSE;
+        break;
+      }
+      frame_len = 0;
+    }
+    ret = LZ4F_compressUpdate(cctx, out_buf, out_size, in_buf, nread, NULL);
+    if (LZ4F_isError(ret) || !write_all(out_fd, out_buf, ret)) {
+      ok = FALSE;
+    }
+    frame_len += nread;
+  }
+  if (ok && nread < 0) {
+    ok = FALSE;
+  }
+  if (ok) {
+    ret = LZ4F_compressEnd(cctx, out_buf, out_size, NULL);
+    if (LZ4F_isError(ret) || !write_all(out_fd, out_buf, ret)) {
+      ok = FALSE;
+    }
+  }
+
+  LZ4F_freeCompressionContext(cctx);
+  g_free(in_buf);
+  g_free(out_buf);
+  return ok;
+}
+#endif
+
+/*
+ * compress capture file
+ */
+static int ringbuf_exec_compress(const gchar* name)
+{
+  const char *ext = ringbuf_compress_extension();
+  gchar* outname = NULL;
+  int  fd = -1;
+  int  out_fd;
+  gboolean ok = FALSE;
+
+  fd = ws_open(name, O_RDONLY | O_BINARY, 0000);
+  if (fd < 0) {
+    return -1;
+  }
+
+  outname = g_strdup_printf("%s.%s", name, ext);
+  if (strcmp(ext, "gz") == 0) {
+    ok = ringbuf_compress_gzip(fd, outname);
+  } else {
+    out_fd = ws_open(outname, O_WRONLY|O_BINARY|O_TRUNC|O_CREAT,
+                     rb_data.group_read_access ? 0640 : 0600);
+    if (out_fd >= 0) {
+#ifdef HAVE_ZSTD
+      if (strcmp(ext, "zst") == 0)
+        ok = ringbuf_compress_zstd(fd, out_fd);
+#endif
+#ifdef HAVE_LZ4FRAME_H
+      if (strcmp(ext, "lz4") == 0)
+        ok = ringbuf_compress_lz4(fd, out_fd);
+#endif
+      if (ws_close(out_fd) != 0)
+        ok = FALSE;
+    }
+  }
+  ws_close(fd);
 
   /* delete the original file only if compression succeeds */
-  if (delete_org_file) {
+  if (ok) {
     ws_unlink(name);
     CleanupOldCap(name);
+  } else {
+    ws_unlink(outname);
   }
-  g_free(name);
-  return 0;
+  g_free(outname);
+  return ok ? 0 : -1;
 }
 
 /*
- * thread to compress capture file
+ * remove a ringbuffer file, compressed or not
  */
-static void* exec_compress_thread(void* arg)
+static void ringbuf_unlink_name(const gchar *name)
 {
-  ringbuf_exec_compress((gchar*)arg);
-  return NULL;
+  const char *ext = ringbuf_compress_extension();
+
+  ws_unlink(name);
+  if (ext != NULL) {
+    gchar *compressed_name = g_strdup_printf("%s.%s", name, ext);
+    ws_unlink(compressed_name);
+    g_free(compressed_name);
+  }
 }
 
 /*
- * start a thread to compress capture file
+ * worker compressing a capture file
  */
-static int ringbuf_start_compress_file(rb_file* rfile)
+static void exec_compress_job(gpointer data, gpointer user_data _U_)
 {
-  gchar* name = g_strdup(rfile->name);
-  g_thread_new("exec_compress", &exec_compress_thread, name);
-  return 0;
+  rb_compress_job *job = (rb_compress_job *)data;
+  gboolean discard;
+
+  g_mutex_lock(&rb_data.compress_mutex);
+  discard = job->discard;
+  g_mutex_unlock(&rb_data.compress_mutex);
+
+  if (!discard) {
+    ringbuf_exec_compress(job->name);
+
+    g_mutex_lock(&rb_data.compress_mutex);
+    discard = job->discard;
+    if (job->rfile != NULL)
+      job->rfile->compress_job = NULL;
+    g_mutex_unlock(&rb_data.compress_mutex);
+  }
+
+  /* the ring has wrapped around to this file's slot in the meantime */
+  if (discard)
+    ringbuf_unlink_name(job->name);
+
+  g_free(job->name);
+  g_free(job);
+}
+
+/*
+ * queue a capture file for compression
+ */
+static void ringbuf_start_compress_file(rb_file* rfile)
+{
+  rb_compress_job *job;
+
+  if (rb_data.compress_pool == NULL) {
+    rb_data.compress_pool = g_thread_pool_new(exec_compress_job, NULL,
+                                              RINGBUF_COMPRESS_THREADS,
+                                              FALSE, NULL);
+  }
+
+  /*
+   * Don't wait for the workers if they've fallen behind; the capture
+   * matters more than the compression.
+   */
+  if (g_thread_pool_unprocessed(rb_data.compress_pool) >= RINGBUF_COMPRESS_QUEUE_MAX) {
+    ws_warning("Compression is falling behind the capture; leaving %s uncompressed",
+               rfile->name);
+    return;
+  }
+
+  job = g_new(rb_compress_job, 1);
+  job->name = g_strdup(rfile->name);
+  job->discard = FALSE;
+
+  g_mutex_lock(&rb_data.compress_mutex);
+  /* With an unlimited number of files the slot is reused for every file. */
+  if (rfile->compress_job != NULL)
+    rfile->compress_job->rfile = NULL;
+  job->rfile = rfile;
+  rfile->compress_job = job;
+  g_mutex_unlock(&rb_data.compress_mutex);
+
+  g_thread_pool_push(rb_data.compress_pool, job, NULL);
+}
+
+/*
+ * wait for all the files being compressed
+ */
+static void ringbuf_join_compress_threads(void)
+{
+  if (rb_data.compress_pool == NULL)
+    return;
+  g_thread_pool_free(rb_data.compress_pool, FALSE, TRUE);
+  rb_data.compress_pool = NULL;
 }
 
 /*
@@ -213,11 +519,24 @@ static int ringbuf_open_file(rb_file *rfile, int *err)
 
   if (rfile->name != NULL) {
     if (rb_data.unlimited == FALSE) {
+      gboolean compressing = FALSE;
+
+      /*
+       * If the old file is still waiting to be compressed, or being
+       * compressed, the worker removes it when it's done with it.
+       */
+      g_mutex_lock(&rb_data.compress_mutex);
+      if (rfile->compress_job != NULL) {
+        rfile->compress_job->discard = TRUE;
+        rfile->compress_job->rfile = NULL;
+        rfile->compress_job = NULL;
+        compressing = TRUE;
+      }
+      g_mutex_unlock(&rb_data.compress_mutex);
+
       /* remove old file (if any, so ignore error) */
-      ws_unlink(rfile->name);
-    }
-    else if (rb_data.compress_type != NULL && strcmp(rb_data.compress_type, "gzip") == 0) {
-      ringbuf_start_compress_file(rfile);
+      if (!compressing)
+        ringbuf_unlink_name(rfile->name);
     }
     g_free(rfile->name);
   }
@@ -279,6 +598,8 @@ ringbuf_init(const char *capfile_name, guint num_files, gboolean group_read_acce
   rb_data.name_h = NULL;
   rb_data.compress_type = compress_type;
   g_mutex_init(&rb_data.mutex);
+  g_mutex_init(&rb_data.compress_mutex);
+  rb_data.compress_pool = NULL;
 
   /* just to be sure ... */
   if (num_files <= RINGBUFFER_MAX_NUM_FILES) {
@@ -337,6 +658,7 @@ ringbuf_init(const char *capfile_name, guint num_files, gboolean group_read_acce
 
   for (i=0; i < rb_data.num_files; i++) {
     rb_data.files[i].name = NULL;
+    rb_data.files[i].compress_job = NULL;
   }
 
   /* create the first file */
@@ -403,16 +725,8 @@ ringbuf_init_libpcap_fdopen(int *err)
       *err = errno;
     }
   } else {
-    size_t buffsize = IO_BUF_SIZE;
-#ifdef HAVE_STRUCT_STAT_ST_BLKSIZE
-    ws_statb64 statb;
+    size_t buffsize = pcapio_write_buffer_size(rb_data.fd);
 
-    if (ws_fstat64(rb_data.fd, &statb) == 0) {
-      if (statb.st_blksize > IO_BUF_SIZE) {
-        buffsize = statb.st_blksize;
-      }
-    }
-#endif
     /* Increase the size of the IO buffer */
     rb_data.io_buffer = (char *)g_realloc(rb_data.io_buffer, buffsize);
     setvbuf(rb_data.pdh, rb_data.io_buffer, _IOFBF, buffsize);
@@ -452,6 +766,11 @@ ringbuf_switch_file(FILE **pdh, gchar **save_file, int *save_file_fd, int *err)
     fflush(rb_data.name_h);
   }
 
+  /* compress the file we've just finished, in the background */
+  if (ringbuf_compress_extension() != NULL) {
+    ringbuf_start_compress_file(&rb_data.files[rb_data.curr_file_num % rb_data.num_files]);
+  }
+
   /* get the next file number and open it */
 
   rb_data.curr_file_num++ /* = next_file_num*/;
@@ -520,6 +839,8 @@ ringbuf_free(void)
 {
   unsigned int i;
 
+  ringbuf_join_compress_threads();
+
   if (rb_data.files != NULL) {
     for (i=0; i < rb_data.num_files; i++) {
       if (rb_data.files[i].name != NULL) {
@@ -564,10 +885,12 @@ ringbuf_error_cleanup(void)
     rb_data.fd = -1;
   }
 
+  ringbuf_join_compress_threads();
+
   if (rb_data.files != NULL) {
     for (i=0; i < rb_data.num_files; i++) {
       if (rb_data.files[i].name != NULL) {
-        ws_unlink(rb_data.files[i].name);
+        ringbuf_unlink_name(rb_data.files[i].name);
       }
     }
   }
@@ -12,6 +12,7 @@ import fixtures
 import glob
 import hashlib
 import os
+import re
 import socket
 import subprocess
 import subprocesstest
@@ -27,15 +28,17 @@ testout_pcapng = 'testout.pcapng'
 snapshot_len = 96
 
 class UdpTrafficGenerator(threading.Thread):
-    def __init__(self):
+    def __init__(self, burst=1):
         super().__init__(daemon=True)
         self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
         self.stopped = False
+        self.burst = burst
 
     def run(self):
         while not self.stopped:
             time.sleep(.05)
-            self.sock.sendto(b'Wireshark test\n', ('127.0.0.1', 9))
+            for _ in range(self.burst):
+                self.sock.sendto(b'Wireshark test\n', ('127.0.0.1', 9))
 
     def stop(self):
         if not self.stopped:
@@ -49,12 +52,13 @@ def traffic_generator():
     Traffic generator factory. Invoking it returns a tuple (start_func, cfilter)
     where cfilter is a capture filter to match the generated traffic.
     start_func can be invoked to start generating traffic and returns a function
-    which can be used to stop traffic generation early.
+    which can be used to stop traffic generation early. start_func takes an
+    optional number of packets to send back to back each time.
     Currently generates a bunch of UDP traffic to localhost.
     '''
     threads = []
-    def start_processes():
-        thread = UdpTrafficGenerator()
+    def start_processes(burst=1):
+        thread = UdpTrafficGenerator(burst)
         thread.start()
         threads.append(thread)
         return thread.stop
@@ -306,6 +310,77 @@ def check_dumpcap_ringbuffer_stdin(cmd_dumpcap):
     return check_dumpcap_ringbuffer_stdin_real
 
 
+@fixtures.fixture
+def check_dumpcap_ringbuffer_compress(cmd_dumpcap):
+    def check_dumpcap_ringbuffer_compress_real(self, compress_type, extension):
+        # 100 packets, 20 per file, in a ring of 3 files. The last file is
+        # left uncompressed; the first two are removed as the ring wraps.
+        rb_unique = 'dhcp_rb_' + uuid.uuid4().hex[:6] # Random ID
+        testout_file = '{}.{}.pcapng'.format(self.id(), rb_unique)
+        testout_glob = '{}.{}_*.pcapng*'.format(self.id(), rb_unique)
+        cat100_dhcp_cmd = subprocesstest.cat_dhcp_command('cat100')
+
+        cmd_ = '"{}"'.format(cmd_dumpcap)
+        capture_cmd = ' '.join((cmd_,
+            '-i', '-',
+            '-w', testout_file,
+            '-b', 'packets:20',
+            '-b', 'files:3',
+            '--compress-type', compress_type,
+        ))
+        self.assertRun(cat100_dhcp_cmd + ' | ' + capture_cmd, shell=True)
+
+        rb_files = sorted(glob.glob(testout_glob))
+        for rbf in rb_files:
+            self.cleanup_files.append(rbf)
+
+        compressed = [rbf for rbf in rb_files if rbf.endswith('.pcapng.' + extension)]
+        uncompressed = [rbf for rbf in rb_files if rbf.endswith('.pcapng')]
+        self.assertEqual(len(rb_files), 3, rb_files)
+        self.assertEqual(len(compressed), 2, rb_files)
+        self.assertEqual(len(uncompressed), 1, rb_files)
+        # The uncompressed file is the current one, after the other two.
+        self.assertGreater(uncompressed[0], compressed[-1])
+
+        for rbf in compressed:
+            # The raw file is removed once it's been compressed.
+            self.assertFalse(os.path.exists(rbf[:-len(extension) - 1]))
+            self.checkPacketCount(20, cap_file=rbf)
+        self.checkPacketCount(20, cap_file=uncompressed[0])
+    return check_dumpcap_ringbuffer_compress_real
+
+
+@fixtures.fixture
+def check_dumpcap_autostop_no_drops(capture_interface, cmd_dumpcap, traffic_generator):
+    start_traffic, cfilter = traffic_generator
+    def check_dumpcap_autostop_no_drops_real(self, *stop_args):
+        # Bursts of packets, so that pcap hands dumpcap several at once.
+        rb_unique = 'drops_' + uuid.uuid4().hex[:6] # Random ID
+        testout_file = '{}.{}.pcapng'.format(self.id(), rb_unique)
+        testout_glob = '{}.{}*.pcapng'.format(self.id(), rb_unique)
+        stop_traffic = start_traffic(burst=20)
+        capture_proc = self.runProcess(capture_command(cmd_dumpcap,
+            '-i', capture_interface,
+            '-p',
+            '-w', testout_file,
+            '-a', 'duration:{}'.format(capture_duration),
+            '-f', cfilter,
+            *stop_args
+        ))
+        stop_traffic()
+        for outfile in glob.glob(testout_glob):
+            self.cleanup_files.append(outfile)
+        self.assertEqual(capture_proc.returncode, 0)
+        # Packets left in a batch when a limit stops the capture aren't
+        # dropped; they just weren't captured.
+        drops = re.search(r"Packets received/dropped on interface '.*': (\d+)/(\d+)",
+            capture_proc.stderr_str)
+        self.assertIsNotNone(drops)
+        self.assertGreater(int(drops.group(1)), 0)
+        self.assertEqual(int(drops.group(2)), 0)
+    return check_dumpcap_autostop_no_drops_real
+
+
 @fixtures.fixture
 def check_dumpcap_pcapng_sections(cmd_dumpcap, cmd_tshark, capture_file):
     if sys.platform == 'win32':
@@ -562,6 +637,22 @@ class case_dumpcap_autostop(subprocesstest.SubprocessTestCase):
         check_dumpcap_autostop_stdin(self, packets=97) # Last prime before 100. Arbitrary.
 
 
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_dumpcap_autostop_drops(subprocesstest.SubprocessTestCase):
+    def test_dumpcap_autostop_filesize_no_drops(self, check_dumpcap_autostop_no_drops):
+        '''Stopping at a file size limit doesn't report drops'''
+        check_dumpcap_autostop_no_drops(self, '-a', 'filesize:2')
+
+    def test_dumpcap_autostop_files_no_drops(self, check_dumpcap_autostop_no_drops):
+        '''Stopping at a file count limit doesn't report drops'''
+        check_dumpcap_autostop_no_drops(self, '-b', 'filesize:1', '-a', 'files:2')
+
+    def test_dumpcap_autostop_packets_no_drops(self, check_dumpcap_autostop_no_drops):
+        '''Stopping at a packet count limit doesn't report drops'''
+        check_dumpcap_autostop_no_drops(self, '-c', '50')
+
+
 @fixtures.mark_usefixtures('base_env')
 @fixtures.uses_fixtures
 class case_dumpcap_ringbuffer(subprocesstest.SubprocessTestCase):
@@ -575,6 +666,26 @@ class case_dumpcap_ringbuffer(subprocesstest.SubprocessTestCase):
         check_dumpcap_ringbuffer_stdin(self, packets=47) # Last prime before 50. Arbitrary.
 
 
+@fixtures.mark_usefixtures('base_env')
+@fixtures.uses_fixtures
+class case_dumpcap_ringbuffer_compress(subprocesstest.SubprocessTestCase):
+    def test_dumpcap_ringbuffer_compress_gzip(self, check_dumpcap_ringbuffer_compress):
+        '''Capture from stdin using Dumpcap into a ring of gzip-compressed files'''
+        check_dumpcap_ringbuffer_compress(self, 'gzip', 'gz')
+
+    def test_dumpcap_ringbuffer_compress_zstd(self, check_dumpcap_ringbuffer_compress, features):
+        '''Capture from stdin using Dumpcap into a ring of zstd-compressed files'''
+        if not features.have_zstd:
+            self.skipTest('Requires Zstandard.')
+        check_dumpcap_ringbuffer_compress(self, 'zstd', 'zst')
+
+    def test_dumpcap_ringbuffer_compress_lz4(self, check_dumpcap_ringbuffer_compress, features):
+        '''Capture from stdin using Dumpcap into a ring of lz4-compressed files'''
+        if not features.have_lz4:
+            self.skipTest('Requires LZ4.')
+        check_dumpcap_ringbuffer_compress(self, 'lz4', 'lz4')
+
+
 @fixtures.mark_usefixtures('base_env')
 @fixtures.uses_fixtures
 class case_dumpcap_pcapng_sections(subprocesstest.SubprocessTestCase):
@@ -75,3 +75,52 @@ def checkDFilterSucceed(cmd_dftest, base_env):
             assert expect_stdout in outs, \
                 'Expected the string %s in the output' % expect_stdout
     return checkDFilterSucceed_real
+
+@fixtures.fixture
+def getDFilterCode(cmd_dftest, base_env):
+    def getDFilterCode_real(dfilter, env=None):
+        """Compile a display filter with dftest -s and return the dump
+        of its bytecode, without the "Filter:" line."""
+        proc = subprocess.Popen([cmd_dftest, '-s', dfilter],
+                                stdout=subprocess.PIPE,
+                                stderr=subprocess.PIPE,
+                                universal_newlines=True,
+                                env=env if env is not None else base_env)
+        outs, errs = proc.communicate()
+        assert proc.returncode == 0, \
+            'Unexpected dftest exit code: %d. stderr:\n%s\n' % \
+            (proc.returncode, errs)
+        return outs.split('\n', 1)[1]
+    return getDFilterCode_real
+
+@fixtures.fixture
+def checkDFilterInsnCount(getDFilterCode):
+    def checkDFilterInsnCount_real(dfilter, unoptimized, optimized):
+        """Compile a display filter and expect a certain number of
+        instructions before and after optimization."""
+        code = getDFilterCode(dfilter)
+        for label, expected in (('before', unoptimized), ('after', optimized)):
+            line = 'Instructions %s optimization: %d\n' % (label, expected)
+            assert line in code, \
+                'Expected "%s" in the output:\n%s' % (line.strip(), code)
+    return checkDFilterInsnCount_real
+
+@fixtures.fixture
+def checkDFilterCountSpecialized(dfilter_cmd, base_env):
+    def checkDFilterCountSpecialized_real(dfilter, expected_count):
+        """Run a display filter with and without specialized instructions
+        and expect a certain number of packets both times."""
+        generic_env = dict(base_env)
+        generic_env['WIRESHARK_DFILTER_NO_SPECIALIZE'] = '1'
+        for env in (base_env, generic_env):
+            output = subprocess.check_output(dfilter_cmd(dfilter),
+                                             universal_newlines=True,
+                                             stderr=subprocess.STDOUT,
+                                             env=env)
+
+            dfp_count = output.count("\n")
+            msg = "Expected %d, got: %s (%s)\noutput: %r" % \
+                (expected_count, dfp_count,
+                 'generic' if env is generic_env else 'specialized', output)
+            assert dfp_count == expected_count, msg
+    return checkDFilterCountSpecialized_real
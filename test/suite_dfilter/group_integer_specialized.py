@@ -0,0 +1,173 @@
+#
+# Wireshark tests
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+import unittest
+import fixtures
+from suite_dfilter.dfiltertest import *
+
+
+# Comparisons of integer fields with constants are run as INT_CMP
+# instructions unless WIRESHARK_DFILTER_NO_SPECIALIZE is set; every
+# test here is run both ways.
+#
+# In the single packet of http.pcap, tcp.seq_raw (FT_UINT32) is
+# 2818602631, which doesn't fit in a gint32, tcp.window_size_value
+# (FT_UINT16) is 64240, and tcp.window_size_scalefactor (FT_INT32) is
+# -1 as the SYN wasn't captured.
+@fixtures.uses_fixtures
+class case_integer_specialized(unittest.TestCase):
+    trace_file = "http.pcap"
+
+    def test_u32_eq_1(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.seq_raw == 2818602631"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_u32_eq_2(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.seq_raw == 2818602630"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_u32_ne_1(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.seq_raw != 2818602631"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_u32_ne_2(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.seq_raw ~= 2818602630"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_u32_gt_1(self, checkDFilterCountSpecialized):
+        # Would fail if the values were compared as signed.
+        dfilter = "tcp.seq_raw > 2147483647"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_u32_gt_2(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.seq_raw > 2818602630"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_u32_gt_3(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.seq_raw > 2818602631"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_u32_ge_1(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.seq_raw >= 2818602631"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_u32_ge_2(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.seq_raw >= 2818602632"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_u32_lt_1(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.seq_raw < 2818602631"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_u32_lt_2(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.seq_raw < 4294967295"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_u32_lt_3(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.seq_raw < 1"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_u32_le_1(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.seq_raw <= 2818602631"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_u32_le_2(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.seq_raw <= 2818602630"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_u16_gt_1(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.window_size_value > 64239"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_u16_gt_2(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.window_size_value > 64240"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_u16_le_1(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.window_size_value <= 64240"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_u16_le_2(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.window_size_value <= 64239"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_s32_eq_1(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.window_size_scalefactor == -1"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_s32_eq_2(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.window_size_scalefactor == -2"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_s32_ne_1(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.window_size_scalefactor != -1"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_s32_gt_1(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.window_size_scalefactor > -2"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_s32_gt_2(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.window_size_scalefactor > -1"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_s32_gt_3(self, checkDFilterCountSpecialized):
+        # Would match if the values were compared as unsigned.
+        dfilter = "tcp.window_size_scalefactor > 0"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_s32_ge_1(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.window_size_scalefactor >= -1"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_s32_ge_2(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.window_size_scalefactor >= 0"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_s32_lt_1(self, checkDFilterCountSpecialized):
+        # Wouldn't match if the values were compared as unsigned.
+        dfilter = "tcp.window_size_scalefactor < 0"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_s32_lt_2(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.window_size_scalefactor < -1"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_s32_lt_3(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.window_size_scalefactor < 2147483647"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_s32_le_1(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.window_size_scalefactor <= -1"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_s32_le_2(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.window_size_scalefactor <= -2"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_s32_le_3(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.window_size_scalefactor <= -2147483648"
+        checkDFilterCountSpecialized(dfilter, 0)
+
+    def test_in_set_1(self, checkDFilterCountSpecialized):
+        # The element tests of a small "in" set are specialized too.
+        dfilter = "tcp.window_size_scalefactor in {-2, -1}"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_in_set_2(self, checkDFilterCountSpecialized):
+        dfilter = "tcp.seq_raw in {1, 2818602631}"
+        checkDFilterCountSpecialized(dfilter, 1)
+
+    def test_code_specialized(self, getDFilterCode, base_env):
+        dfilter = "tcp.seq_raw > 2147483647 and tcp.window_size_scalefactor < 0"
+        code = getDFilterCode(dfilter)
+        self.assertEqual(code.count('INT_CMP'), 2, code)
+
+        generic_env = dict(base_env)
+        generic_env['WIRESHARK_DFILTER_NO_SPECIALIZE'] = '1'
+        code = getDFilterCode(dfilter, env=generic_env)
+        self.assertNotIn('INT_CMP', code)
+        self.assertIn('ANY_GT', code)
+        self.assertIn('ANY_LT', code)
@@ -90,3 +90,24 @@ class case_membership(unittest.TestCase):
     def test_membership_12_value_string(self, checkDFilterCount):
         dfilter = 'tcp.checksum.status in {"Unverified", "Good"}'
         checkDFilterCount(dfilter, 1)
+
+    def test_membership_13_large_set_match(self, checkDFilterCount):
+        # Large sets of constants are compiled to a single set lookup.
+        dfilter = 'tcp.port in {1, 2, 3, 4, 5, 6, 7, 80, 9000}'
+        checkDFilterCount(dfilter, 1)
+
+    def test_membership_14_large_set_no_match(self, checkDFilterCount):
+        dfilter = 'tcp.port in {1, 2, 3, 4, 5, 6, 7, 8, 9}'
+        checkDFilterCount(dfilter, 0)
+
+    def test_membership_15_large_set_overlapping_ranges(self, checkDFilterCount):
+        dfilter = 'tcp.port in {1 .. 10, 5 .. 20, 30, 40, 50, 60, 70, 3000 .. 3300}'
+        checkDFilterCount(dfilter, 1)
+
+    def test_membership_16_large_set_empty_range(self, checkDFilterCount):
+        dfilter = 'tcp.port in {90 .. 70, 1, 2, 3, 4, 5, 6, 7, 8}'
+        checkDFilterCount(dfilter, 0)
+
+    def test_membership_17_large_set_ip(self, checkDFilterCount):
+        dfilter = 'ip.addr in {192.168.0.1, 192.168.0.2, 192.168.0.3, 192.168.0.4, 10.0.0.5 .. 10.0.0.9, 10.0.0.1 .. 10.0.0.1}'
+        checkDFilterCount(dfilter, 1)
@@ -0,0 +1,118 @@
+#
+# Wireshark tests
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+import unittest
+import fixtures
+from suite_dfilter.dfiltertest import *
+
+
+# http.pcap has a single packet, with tcp.port 80 and 3267.
+@fixtures.uses_fixtures
+class case_optimizer(unittest.TestCase):
+    trace_file = "http.pcap"
+
+    def test_reorder_and_1(self, checkDFilterCount, getDFilterCode):
+        # The cheaper comparison is evaluated first, whichever way
+        # round it was written.
+        dfilter = 'frame contains "HTTP" and tcp.port == 80'
+        checkDFilterCount(dfilter, 1)
+        self.assertEqual(getDFilterCode(dfilter),
+                         getDFilterCode('tcp.port == 80 and frame contains "HTTP"'))
+
+    def test_reorder_and_2(self, checkDFilterCount):
+        dfilter = 'frame contains "HTTP" and tcp.port == 81'
+        checkDFilterCount(dfilter, 0)
+
+    def test_reorder_or_1(self, checkDFilterCount, getDFilterCode):
+        dfilter = 'frame matches "xyzzy" or tcp.port == 80'
+        checkDFilterCount(dfilter, 1)
+        self.assertEqual(getDFilterCode(dfilter),
+                         getDFilterCode('tcp.port == 80 or frame matches "xyzzy"'))
+
+    def test_reorder_or_2(self, checkDFilterCount):
+        dfilter = 'frame matches "xyzzy" or tcp.port == 81'
+        checkDFilterCount(dfilter, 0)
+
+    def test_reorder_chain_1(self, checkDFilterCount, getDFilterCode):
+        # A chain of "and"s is sorted as a whole, and comparisons that
+        # cost the same keep the order they were written in.
+        dfilter = 'frame contains "HTTP" and ip.proto == 6 and tcp.port == 80'
+        checkDFilterCount(dfilter, 1)
+        self.assertEqual(getDFilterCode(dfilter),
+                         getDFilterCode('ip.proto == 6 and tcp.port == 80 and frame contains "HTTP"'))
+        self.assertNotEqual(getDFilterCode(dfilter),
+                            getDFilterCode('tcp.port == 80 and ip.proto == 6 and frame contains "HTTP"'))
+
+    def test_reorder_chain_2(self, getDFilterCode):
+        # The last operand of "a or b or c" isn't moved in front of
+        # the others just because "a or b" costs more than it does.
+        dfilter = 'ip.proto == 6 or tcp.port == 80 or udp.port == 53'
+        self.assertNotEqual(getDFilterCode(dfilter),
+                            getDFilterCode('udp.port == 53 or ip.proto == 6 or tcp.port == 80'))
+
+    def test_reorder_chain_3(self, checkDFilterCount, getDFilterCode):
+        # Parentheses don't stop a chain of the same operator from
+        # being sorted.
+        dfilter = 'frame matches "xyzzy" or (ip.proto == 17 or tcp.port == 80)'
+        checkDFilterCount(dfilter, 1)
+        self.assertEqual(getDFilterCode(dfilter),
+                         getDFilterCode('ip.proto == 17 or tcp.port == 80 or frame matches "xyzzy"'))
+
+    def test_reorder_insn_count(self, checkDFilterInsnCount):
+        dfilter = 'frame contains "HTTP" and tcp.port == 80'
+        checkDFilterInsnCount(dfilter, 8, 8)
+
+    def test_shared_load_and_1(self, checkDFilterCount, checkDFilterInsnCount):
+        # The second READ_TREE of tcp.port and its branch are dropped.
+        dfilter = 'tcp.port > 1000 and tcp.port < 4000'
+        checkDFilterCount(dfilter, 1)
+        checkDFilterInsnCount(dfilter, 8, 6)
+
+    def test_shared_load_and_2(self, checkDFilterCount):
+        dfilter = 'tcp.port > 4000 and tcp.port < 5000'
+        checkDFilterCount(dfilter, 0)
+
+    def test_shared_load_or_1(self, checkDFilterCount, checkDFilterInsnCount):
+        dfilter = 'tcp.port == 1 or tcp.port == 80'
+        checkDFilterCount(dfilter, 1)
+        checkDFilterInsnCount(dfilter, 8, 6)
+
+    def test_shared_load_or_2(self, checkDFilterCount):
+        dfilter = 'tcp.port == 1 or tcp.port == 2'
+        checkDFilterCount(dfilter, 0)
+
+    def test_shared_load_nested_1(self, checkDFilterCount, checkDFilterInsnCount):
+        # The "or" is more expensive, so it's moved after the
+        # comparison that loads tcp.port, and its own load of tcp.port
+        # is dropped; udp.port still has to be loaded.
+        dfilter = '(tcp.port == 1 or udp.port == 53) and tcp.port == 80'
+        checkDFilterCount(dfilter, 0)
+        checkDFilterInsnCount(dfilter, 12, 10)
+
+    def test_shared_load_nested_2(self, checkDFilterCount, checkDFilterInsnCount):
+        dfilter = 'tcp.port == 80 and (tcp.port == 3267 or udp.port == 53)'
+        checkDFilterCount(dfilter, 1)
+        checkDFilterInsnCount(dfilter, 12, 10)
+
+    def test_not_1(self, checkDFilterCount, checkDFilterInsnCount):
+        # tcp.port isn't known to be loaded after a "not", so the
+        # second load has to stay.
+        dfilter = '!(tcp.port == 80) and tcp.port == 3267'
+        checkDFilterCount(dfilter, 0)
+        checkDFilterInsnCount(dfilter, 9, 9)
+
+    def test_not_2(self, checkDFilterCount, checkDFilterInsnCount):
+        dfilter = '!(tcp.port == 1) and tcp.port == 3267'
+        checkDFilterCount(dfilter, 1)
+        checkDFilterInsnCount(dfilter, 9, 9)
+
+    def test_not_3(self, checkDFilterCount, checkDFilterInsnCount):
+        dfilter = '!tcp.port or tcp.port == 80'
+        checkDFilterCount(dfilter, 1)
+        checkDFilterInsnCount(dfilter, 7, 7)
+
+    def test_not_4(self, checkDFilterCount):
+        dfilter = '!udp.port or udp.port == 53'
+        checkDFilterCount(dfilter, 1)
@@ -51,6 +51,37 @@ class case_syntax(unittest.TestCase):
         dfilter = '"a" matches "b"'
         checkDFilterFail(dfilter, "not a valid operand for matches")
 
+    def test_matches_6(self, checkDFilterCount):
+        # The literal text required by the pattern is compared caselessly,
+        # like the pattern itself.
+        dfilter = r'http.host matches r"UPDATE\.Microsoft\.com"'
+        checkDFilterCount(dfilter, 1)
+
+    def test_matches_7(self, checkDFilterCount):
+        dfilter = r'http.host matches r"update\.example"'
+        checkDFilterCount(dfilter, 0)
+
+    def test_matches_8(self, checkDFilterCount):
+        # Optional characters are not part of the required text.
+        dfilter = r'http.host matches r"updatesx?\.microsoft"'
+        checkDFilterCount(dfilter, 0)
+        dfilter = r'http.host matches r"updatex?\.microsoft"'
+        checkDFilterCount(dfilter, 1)
+
+    def test_matches_9(self, checkDFilterCount):
+        # A POSIX class doesn't end the bracket expression it's in, so
+        # "microsoftcom" is part of the class, not required text.
+        dfilter = r'http.host matches r"update[[:punct:]microsoftcom]microsoft"'
+        checkDFilterCount(dfilter, 1)
+
+    def test_matches_10(self, checkDFilterCount):
+        # In extended mode white space isn't part of the text to match,
+        # so "upd ate" must not be required as literal text.
+        dfilter = r'http.host matches r"(?x)upd ate \.micro soft"'
+        checkDFilterCount(dfilter, 1)
+        dfilter = 'frame matches "(?x)a b c"'
+        checkDFilterCount(dfilter, 0)
+
     def test_equal_1(self, checkDFilterCount):
         dfilter = 'ip.addr == 10.0.0.5'
         checkDFilterCount(dfilter, 1)
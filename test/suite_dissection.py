@@ -9,6 +9,7 @@
 '''Dissection tests'''
 
 import os.path
+import struct
 import subprocesstest
 import unittest
 import fixtures
@@ -398,6 +399,35 @@ class case_dissect_protobuf(subprocesstest.SubprocessTestCase):
         self.assertFalse(self.grepOutput('.last_field_for_wireshark_test'))
         self.assertFalse(self.grepOutput('Protobuf: Error'))
 
+
+def write_tcp_pcap(filename, segments, client_isn, server_isn):
+    '''
+    Write a pcap of a single TCP connection between 10.0.0.1:40000 (the
+    client) and 10.0.0.2:40001 (the server). Each segment is a tuple of
+    (time, from client, relative seq, relative ack, flags, payload length);
+    relative numbers are offsets from the sender's and receiver's ISNs.
+    '''
+    client = (bytes((10, 0, 0, 1)), 40000, client_isn)
+    server = (bytes((10, 0, 0, 2)), 40001, server_isn)
+    with open(filename, 'wb') as f:
+        # Microsecond pcap, Ethernet.
+        f.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1))
+        for (ts, from_client, seq, ack, flags, length) in segments:
+            src, dst = (client, server) if from_client else (server, client)
+            tcp = struct.pack('>HHIIBBHHH', src[1], dst[1],
+                (src[2] + seq) & 0xffffffff, (dst[2] + ack) & 0xffffffff if ack is not None else 0,
+                5 << 4, flags, 65535, 0, 0) + bytes(length)
+            ip = struct.pack('>BBHHHBBH4s4s', 0x45, 0, 20 + len(tcp), 0, 0x4000,
+                64, 6, 0, src[0], dst[0])
+            frame = bytes((0, 0, 0, 0, 0, 2 if from_client else 1)) + \
+                bytes((0, 0, 0, 0, 0, 1 if from_client else 2)) + b'\x08\x00' + ip + tcp
+            usecs = int(round(ts * 1000000))
+            f.write(struct.pack('<IIII', 1000000000 + usecs // 1000000, usecs % 1000000,
+                len(frame), len(frame)))
+            f.write(frame)
+
+TH_FIN, TH_SYN, TH_PUSH, TH_ACK = 0x01, 0x02, 0x08, 0x10
+
 @fixtures.mark_usefixtures('test_env')
 @fixtures.uses_fixtures
 class case_dissect_tcp(subprocesstest.SubprocessTestCase):
@@ -513,6 +543,114 @@ class case_dissect_tcp(subprocesstest.SubprocessTestCase):
             '-Ytls', '-Tfields', '-eframe.number', '-etls.record.length', '-2'))
         self.assertEqual(proc.stdout_str, '2\t16\n')
 
+    def tcp_analysis(self, cmd_tshark, capfile):
+        proc = self.assertRun((cmd_tshark, '-r', capfile,
+            '-o', 'tcp.analyze_sequence_numbers:TRUE',
+            '-Tfields', '-eframe.number', '-etcp.analysis.acks_frame',
+            '-etcp.analysis.bytes_in_flight', '-etcp.analysis.out_of_order',
+            '-etcp.analysis.retransmission', '-etcp.analysis.lost_segment',
+            '-etcp.analysis.rto_frame',
+            ))
+        return proc.stdout_str.splitlines()
+
+    def test_tcp_analysis_reordering_and_partial_ack(self, cmd_tshark):
+        '''
+        Sequence analysis of out-of-order, retransmitted and partially
+        acknowledged segments. The expected values are those of the
+        analysis before unacked segments were kept in a sorted ring.
+        '''
+        capfile = self.filename_from_id('tcp-analysis.pcap')
+        data = TH_PUSH|TH_ACK
+        write_tcp_pcap(capfile, (
+            (0.000, True,  0, None, TH_SYN, 0),
+            (0.005, False, 0, 1, TH_SYN|TH_ACK, 0),
+            (0.010, True,  1, 1, TH_ACK, 0),
+            (0.100, True,  1, 1, data, 100),
+            # 101-200 turns up after 201-300, within the initial RTT.
+            (0.101, True,  201, 1, data, 100),
+            (0.102, True,  101, 1, data, 100),
+            (0.150, False, 1, 301, TH_ACK, 0),
+            # 301-400 is sent again after 300 ms.
+            (0.200, True,  301, 1, data, 100),
+            (0.500, True,  301, 1, data, 100),
+            (0.550, False, 1, 401, TH_ACK, 0),
+            # Half of 401-1400 is acknowledged.
+            (0.600, True,  401, 1, data, 1000),
+            (0.650, False, 1, 901, TH_ACK, 0),
+            (0.651, True,  1401, 1, data, 100),
+            (0.700, False, 1, 1501, TH_ACK, 0),
+        ), 1000, 5000)
+        self.assertEqual(self.tcp_analysis(cmd_tshark, capfile), [
+            '1\t\t\t\t\t\t',
+            '2\t1\t\t\t\t\t',
+            '3\t2\t\t\t\t\t',
+            '4\t\t100\t\t\t\t',
+            # Bytes in flight aren't tracked after a gap until the next ACK.
+            '5\t\t\t\t\t1\t',
+            '6\t\t\t1\t\t\t',
+            # The ACK of the highest segment is matched with it, not
+            # with the out-of-order one.
+            '7\t5\t\t\t\t\t',
+            '8\t\t100\t\t\t\t',
+            '9\t\t100\t\t1\t\t8',
+            # Of a segment and its retransmission, the first one sent is acked.
+            '10\t8\t\t\t\t\t',
+            '11\t\t1000\t\t\t\t',
+            '12\t\t\t\t\t\t',
+            # Only the unacknowledged half of frame 11 is still in flight.
+            '13\t\t600\t\t\t\t',
+            '14\t13\t\t\t\t\t',
+        ])
+
+    def test_tcp_analysis_wraparound_many_in_flight(self, cmd_tshark):
+        '''
+        Sequence analysis with 40 segments in flight, more than the initial
+        size of the ring of unacked segments, and sequence numbers that
+        wrap around in the middle of segment 20. After the ACK of the first
+        20 segments, a retransmission is placed among the others and a
+        partial ACK ends in the middle of a segment.
+        '''
+        capfile = self.filename_from_id('tcp-analysis-wrap.pcap')
+        data = TH_PUSH|TH_ACK
+        segments = [
+            (0.000, True,  0, None, TH_SYN, 0),
+            (0.005, False, 0, 1, TH_SYN|TH_ACK, 0),
+            (0.010, True,  1, 1, TH_ACK, 0),
+        ]
+        # Segment n is 1 + 100 * n to 101 + 100 * n, in frame 4 + n.
+        for n in range(40):
+            segments.append((1.000 + n * 0.001, True, 1 + 100 * n, 1, data, 100))
+        segments += [
+            (1.100, False, 1, 2001, TH_ACK, 0),
+            (1.101, True,  4001, 1, data, 100),
+            (2.000, True,  2501, 1, data, 100),
+            (2.050, False, 1, 2601, TH_ACK, 0),
+            (2.100, False, 1, 2651, TH_ACK, 0),
+            (2.101, True,  4101, 1, data, 100),
+            (2.200, False, 1, 4201, TH_ACK, 0),
+        ]
+        write_tcp_pcap(capfile, segments, 0xfffff800, 5000)
+        expected = [
+            '1\t\t\t\t\t\t',
+            '2\t1\t\t\t\t\t',
+            '3\t2\t\t\t\t\t',
+        ]
+        for n in range(40):
+            expected.append('{}\t\t{}\t\t\t\t'.format(4 + n, 100 * (n + 1)))
+        expected += [
+            # Acks segment 19, leaving segments 20 to 39 in the ring.
+            '44\t23\t\t\t\t\t',
+            '45\t\t2100\t\t\t\t',
+            # Segment 25 again; the oldest unacked segment is 20.
+            '46\t\t2100\t\t1\t\t24',
+            '47\t29\t\t\t\t\t',
+            '48\t\t\t\t\t\t',
+            # From the middle of segment 26 to the end of segment 41.
+            '49\t\t1550\t\t\t\t',
+            '50\t49\t\t\t\t\t',
+        ]
+        self.assertEqual(self.tcp_analysis(cmd_tshark, capfile), expected)
+
 @fixtures.mark_usefixtures('test_env')
 @fixtures.uses_fixtures
 class case_dissect_git(subprocesstest.SubprocessTestCase):
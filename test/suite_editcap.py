@@ -0,0 +1,268 @@
+#
+# Wireshark tests
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+'''Editcap tests'''
+
+import os
+import shutil
+import struct
+import subprocesstest
+import fixtures
+
+# sizeof (frame_index_header) and sizeof (wtap_frame_index_entry) in
+# wiretap/frame_index.c and wiretap/frame_index.h.
+frame_index_header_size = 56
+frame_index_entry_size = 40
+
+# Number of packets in dhcp.pcap.
+dhcp_packet_count = 4
+
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_editcap_frame_index(subprocesstest.SubprocessTestCase):
+    def copy_capture(self, capture_file):
+        '''Copy dhcp.pcap to a file we're allowed to change.'''
+        infile = self.filename_from_id('dhcp.pcap')
+        shutil.copyfile(capture_file('dhcp.pcap'), infile)
+        self.filename_from_id('dhcp.pcap.frameidx')
+        return infile
+
+    def reordercap_uses_index(self, cmd_reordercap, infile, packet_count=dhcp_packet_count):
+        '''Run reordercap on infile and report whether it used a frame index.'''
+        testout_file = self.filename_from_id('reordered.pcap')
+        proc = self.assertRun((cmd_reordercap, '--log-level=debug', infile, testout_file))
+        self.checkPacketCount(packet_count, cap_file=testout_file)
+        if 'using frame index' in proc.stderr_str:
+            return True
+        self.assertIn('capture file has changed', proc.stderr_str)
+        return False
+
+    def test_frame_index_write(self, cmd_editcap, capture_file):
+        '''Write a frame index covering every packet'''
+        infile = self.copy_capture(capture_file)
+        self.assertRun((cmd_editcap, '--write-frame-index',
+            infile, self.filename_from_id('testout.pcap')))
+        index_file = infile + '.frameidx'
+        self.assertTrue(os.path.isfile(index_file))
+        self.assertEqual(os.path.getsize(index_file),
+            frame_index_header_size + dhcp_packet_count * frame_index_entry_size)
+        self.assertFalse(os.path.exists(index_file + '.tmp'))
+
+    def test_frame_index_write_all_selected(self, cmd_editcap, capture_file):
+        '''Write a frame index when the last selected packet is the last packet'''
+        infile = self.copy_capture(capture_file)
+        self.assertRun((cmd_editcap, '--write-frame-index', '-r',
+            infile, self.filename_from_id('testout.pcap'),
+            '1-{}'.format(dhcp_packet_count)))
+        self.assertTrue(os.path.isfile(infile + '.frameidx'))
+
+    def test_frame_index_write_stopped_early(self, cmd_editcap, capture_file):
+        '''Don't write a frame index if reading stopped before the end'''
+        infile = self.copy_capture(capture_file)
+        self.assertRun((cmd_editcap, '--write-frame-index', '-r',
+            infile, self.filename_from_id('testout.pcap'), '1-2'))
+        self.assertFalse(os.path.exists(infile + '.frameidx'))
+        self.assertFalse(os.path.exists(infile + '.frameidx.tmp'))
+
+    def test_frame_index_load(self, cmd_editcap, cmd_reordercap, capture_file):
+        '''Load a matching frame index'''
+        infile = self.copy_capture(capture_file)
+        self.assertRun((cmd_editcap, '--write-frame-index',
+            infile, self.filename_from_id('testout.pcap')))
+        self.assertTrue(self.reordercap_uses_index(cmd_reordercap, infile))
+
+    def test_frame_index_size_mismatch(self, cmd_editcap, cmd_reordercap, capture_file):
+        '''Ignore a frame index if the capture file has grown'''
+        infile = self.copy_capture(capture_file)
+        self.assertRun((cmd_editcap, '--write-frame-index',
+            infile, self.filename_from_id('testout.pcap')))
+        st = os.stat(infile)
+        # Append a copy of the first packet record, which follows the
+        # 24-byte file header and is a 16-byte record header plus the
+        # captured length in its third field.
+        with open(infile, 'r+b') as f:
+            f.seek(24)
+            rec_hdr = f.read(16)
+            caplen = int.from_bytes(rec_hdr[8:12], 'little')
+            rec_data = f.read(caplen)
+            f.seek(0, os.SEEK_END)
+            f.write(rec_hdr + rec_data)
+        os.utime(infile, ns=(st.st_atime_ns, st.st_mtime_ns))
+        self.assertFalse(self.reordercap_uses_index(cmd_reordercap, infile,
+            packet_count=dhcp_packet_count + 1))
+
+    def test_frame_index_mtime_mismatch(self, cmd_editcap, cmd_reordercap, capture_file):
+        '''Ignore a frame index if the capture file has been touched'''
+        infile = self.copy_capture(capture_file)
+        self.assertRun((cmd_editcap, '--write-frame-index',
+            infile, self.filename_from_id('testout.pcap')))
+        st = os.stat(infile)
+        os.utime(infile, (st.st_atime, st.st_mtime + 60))
+        self.assertFalse(self.reordercap_uses_index(cmd_reordercap, infile))
+
+    def test_frame_index_crc_mismatch(self, cmd_editcap, cmd_reordercap, capture_file):
+        '''Ignore a frame index if the capture file was rewritten in place'''
+        infile = self.copy_capture(capture_file)
+        self.assertRun((cmd_editcap, '--write-frame-index',
+            infile, self.filename_from_id('testout.pcap')))
+        st = os.stat(infile)
+        # Change the last byte of packet data, keeping size and mtime.
+        with open(infile, 'r+b') as f:
+            f.seek(-1, os.SEEK_END)
+            last = f.read(1)
+            f.seek(-1, os.SEEK_END)
+            f.write(bytes([last[0] ^ 0xff]))
+        os.utime(infile, ns=(st.st_atime_ns, st.st_mtime_ns))
+        self.assertFalse(self.reordercap_uses_index(cmd_reordercap, infile))
+
+
+def write_pcap(filename, packets):
+    '''Write a microsecond Ethernet pcap of (secs, usecs, data) packets.'''
+    with open(filename, 'wb') as f:
+        f.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1))
+        for secs, usecs, data in packets:
+            f.write(struct.pack('<IIII', secs, usecs, len(data), len(data)))
+            f.write(data)
+
+
+def read_pcap(filename):
+    '''Read the (secs, usecs, data) packets of a pcap written by write_pcap.'''
+    packets = []
+    with open(filename, 'rb') as f:
+        f.read(24)
+        while True:
+            rec_hdr = f.read(16)
+            if not rec_hdr:
+                break
+            secs, usecs, caplen, _ = struct.unpack('<IIII', rec_hdr)
+            packets.append((secs, usecs, f.read(caplen)))
+    return packets
+
+
+def frame(payload_id):
+    '''An Ethernet frame, with a local experimental EtherType, identified by payload_id.'''
+    return bytes(12) + b'\x88\xb5' + struct.pack('<I', payload_id) + bytes(46)
+
+
+def dedup_by_window(packets, window):
+    '''editcap -d/-D as it was before the window was indexed by digest.
+
+    The window is a ring of window entries, including the current packet,
+    which is compared with every other entry.
+    '''
+    ring = [None] * max(window, 1)
+    cur = 0
+    kept = []
+    for packet in packets:
+        cur += 1
+        if cur >= window:
+            cur = 0
+        ring[cur] = packet[2]
+        if not any(i != cur and ring[i] == packet[2] for i in range(window)):
+            kept.append(packet)
+    return kept
+
+
+def dedup_by_time(packets, window_usecs):
+    '''editcap -w as it was before the window was indexed by digest.
+
+    Earlier packets are checked from the most recent backwards, skipping
+    later time stamps and stopping at the first packet outside the time
+    window, whatever its contents.
+    '''
+    kept = []
+    for i, (secs, usecs, data) in enumerate(packets):
+        now = secs * 1000000 + usecs
+        duplicate = False
+        for (prev_secs, prev_usecs, prev_data) in reversed(packets[:i]):
+            delta = now - (prev_secs * 1000000 + prev_usecs)
+            if delta < 0:
+                continue
+            if delta > window_usecs:
+                break
+            if prev_data == data:
+                duplicate = True
+                break
+        if not duplicate:
+            kept.append((secs, usecs, data))
+    return kept
+
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_editcap_dedup(subprocesstest.SubprocessTestCase):
+    def run_editcap(self, cmd_editcap, packets, *args):
+        '''Run editcap with args on packets and return the packets it keeps.'''
+        infile = self.filename_from_id('dedup-in.pcap')
+        outfile = self.filename_from_id('dedup-out.pcap')
+        write_pcap(infile, packets)
+        self.assertRun((cmd_editcap, '-F', 'pcap') + args + (infile, outfile))
+        return read_pcap(outfile)
+
+    def cycling_packets(self, count, period):
+        '''count packets, one per second, repeating every period packets.'''
+        return [(1000 + i, 0, frame(i % period)) for i in range(count)]
+
+    def test_dedup_default_window(self, cmd_editcap):
+        '''-d removes copies of any of the last four packets'''
+        for period in range(1, 8):
+            packets = self.cycling_packets(30, period)
+            kept = self.run_editcap(cmd_editcap, packets, '-d')
+            self.assertEqual(kept, dedup_by_window(packets, 5), 'period {}'.format(period))
+        self.assertEqual(len(self.run_editcap(cmd_editcap, self.cycling_packets(30, 4), '-d')), 4)
+        self.assertEqual(len(self.run_editcap(cmd_editcap, self.cycling_packets(30, 5), '-d')), 30)
+
+    def test_dedup_window_zero(self, cmd_editcap):
+        '''-D 0 and -D 1 remove nothing'''
+        packets = self.cycling_packets(20, 1)
+        self.assertEqual(self.run_editcap(cmd_editcap, packets, '-D', '0'), packets)
+        self.assertEqual(self.run_editcap(cmd_editcap, packets, '-D', '1'), packets)
+
+    def test_dedup_window_wraparound(self, cmd_editcap):
+        '''-D N matches the old ring after it has wrapped around many times'''
+        for window in (2, 3, 4, 7):
+            for period in (1, window - 1, window, window + 1):
+                if period < 1:
+                    continue
+                packets = self.cycling_packets(10 * window + 3, period)
+                kept = self.run_editcap(cmd_editcap, packets, '-D', str(window))
+                self.assertEqual(kept, dedup_by_window(packets, window),
+                    'window {} period {}'.format(window, period))
+
+    def test_dedup_window_mixed(self, cmd_editcap):
+        '''-D N with copies at irregular distances, including copies of copies'''
+        ids = [1, 2, 1, 3, 3, 4, 2, 5, 6, 7, 1, 1, 8, 2, 9, 9, 9, 10, 3, 11]
+        packets = [(1000 + i, 0, frame(n)) for i, n in enumerate(ids)]
+        for window in (2, 3, 5, 8, 100):
+            kept = self.run_editcap(cmd_editcap, packets, '-D', str(window))
+            self.assertEqual(kept, dedup_by_window(packets, window), 'window {}'.format(window))
+
+    def test_dedup_time_window(self, cmd_editcap):
+        '''-w removes copies within the time window'''
+        # Packets 100 ms apart, repeating every 4 packets.
+        packets = [(1000 + i // 10, (i % 10) * 100000, frame(i % 4)) for i in range(40)]
+        for window, usecs in (('0.2', 200000), ('0.3', 300000), ('0.4', 400000), ('1', 1000000)):
+            kept = self.run_editcap(cmd_editcap, packets, '-w', window)
+            self.assertEqual(kept, dedup_by_time(packets, usecs), 'window {}'.format(window))
+        self.assertEqual(len(self.run_editcap(cmd_editcap, packets, '-w', '0.3')), 40)
+        self.assertEqual(len(self.run_editcap(cmd_editcap, packets, '-w', '0.4')), 4)
+
+    def test_dedup_time_window_out_of_order(self, cmd_editcap):
+        '''-w with time stamps out of order'''
+        packets = [
+            (1000, 0, frame(1)),
+            (1000, 100000, frame(2)),
+            (999, 0, frame(3)),         # earlier than the window: stops the search
+            (1000, 200000, frame(1)),   # so this isn't a duplicate of the first packet
+            (1002, 0, frame(4)),        # later than the next packet: skipped
+            (1000, 300000, frame(2)),
+            (1000, 400000, frame(1)),   # a copy of the fourth packet
+            (1000, 900000, frame(4)),   # the copy at 1002 is later; not a duplicate
+        ]
+        kept = self.run_editcap(cmd_editcap, packets, '-w', '0.5')
+        self.assertEqual(kept, dedup_by_time(packets, 500000))
+        self.assertEqual([p[2] for p in kept],
+            [frame(1), frame(2), frame(3), frame(1), frame(4), frame(2), frame(4)])
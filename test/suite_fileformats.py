@@ -8,7 +8,13 @@
 #
 '''File format conversion tests'''
 
+import gzip
+import os
 import os.path
+import random
+import shutil
+import struct
+import subprocess
 import subprocesstest
 import unittest
 import fixtures
@@ -249,3 +255,95 @@ class case_fileformat_mime(subprocesstest.SubprocessTestCase):
                 '-e', 'pcapng.block.length_trailer',
             ))
         self.assertEqual(proc.stdout_str.strip(), '480\t128,88,132,132\t128,88,132,132')
+
+
+def write_big_pcap(filename, packet_count=6000, packet_len=1400):
+    '''Write a pcap of several MB of partly compressible Ethernet frames.'''
+    rand = random.Random(1)
+    with open(filename, 'wb') as f:
+        # Microsecond pcap, Ethernet.
+        f.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1))
+        for num in range(packet_count):
+            # Local experimental EtherType, so the payload is just data.
+            frame = bytes(12) + b'\x88\xb5' + struct.pack('<I', num)
+            payload = bytes(rand.getrandbits(8) for _ in range(packet_len // 4))
+            frame += (payload + b'abcdefgh' * packet_len)[:packet_len - len(frame)]
+            f.write(struct.pack('<IIII', 1000000000 + num, 0, len(frame), len(frame)))
+            f.write(frame)
+
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_fileformat_gzip(subprocesstest.SubprocessTestCase):
+    def frame_hashes(self, cmd_tshark, capfile, *extra_args):
+        proc = self.assertRun((cmd_tshark, '-2', '-r', capfile,
+                '-o', 'frame.generate_md5_hash:TRUE',
+                '-Tfields', '-e', 'frame.number', '-e', 'frame.md5_hash',
+            ) + extra_args)
+        return proc
+
+    def test_gzip_second_pass(self, cmd_tshark):
+        '''The second pass over a gzip file gets the same frames as over the uncompressed file.'''
+        if (os.cpu_count() or 1) < 2:
+            self.skipTest('Parallel decompression needs more than one CPU.')
+        capfile = self.filename_from_id('big.pcap')
+        write_big_pcap(capfile)
+        gzfile = self.filename_from_id('big.pcap.gz')
+        with open(capfile, 'rb') as fin, gzip.open(gzfile, 'wb') as fout:
+            fout.write(fin.read())
+        expected = self.frame_hashes(cmd_tshark, capfile).stdout_str
+        proc = self.frame_hashes(cmd_tshark, gzfile, '--log-level=debug')
+        self.assertEqual(proc.stdout_str, expected)
+        # The second pass reads the file again with the fast seek points
+        # from the first, so the spans between them are decompressed by
+        # worker threads.
+        self.assertIn('decompressing with up to', proc.stderr_str)
+
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_fileformat_multiframe(subprocesstest.SubprocessTestCase):
+    # Every 1000th frame, so the second pass skips forward about 1.4 MB,
+    # more than the fast seek span, between frames.
+    sparse_filter = 'frame.number in {1 1001 2001 3001 4001 5001}'
+
+    def frame_hashes(self, cmd_tshark, capfile, *extra_args):
+        proc = self.assertRun((cmd_tshark, '-2', '-r', capfile,
+                '-o', 'frame.generate_md5_hash:TRUE',
+                '-Tfields', '-e', 'frame.number', '-e', 'frame.md5_hash',
+            ) + extra_args)
+        return proc.stdout_str
+
+    def check_multiframe(self, cmd_tshark, compressor, suffix):
+        '''Compress a capture as one frame per 1 MB chunk, and read it back.'''
+        if shutil.which(compressor) is None:
+            self.skipTest('Requires the {} command.'.format(compressor))
+        capfile = self.filename_from_id('big.pcap')
+        write_big_pcap(capfile)
+        compfile = self.filename_from_id('big.pcap' + suffix)
+        with open(capfile, 'rb') as fin, open(compfile, 'wb') as fout:
+            while True:
+                chunk = fin.read(1000 * 1000)
+                if not chunk:
+                    break
+                fout.write(subprocess.run((compressor, '-q', '-c'),
+                    input=chunk, stdout=subprocess.PIPE, check=True).stdout)
+        # The second pass seeks to every frame, or to every 1000th frame
+        # with a read filter, using the seek points recorded at the start
+        # of each compressed frame in the first pass.
+        self.assertEqual(self.frame_hashes(cmd_tshark, compfile),
+            self.frame_hashes(cmd_tshark, capfile))
+        self.assertEqual(self.frame_hashes(cmd_tshark, compfile, '-R', self.sparse_filter),
+            self.frame_hashes(cmd_tshark, capfile, '-R', self.sparse_filter))
+
+    def test_zstd_multiframe(self, cmd_tshark, features):
+        '''Random access to a zstd file of several frames.'''
+        if not features.have_zstd:
+            self.skipTest('Requires Zstandard.')
+        self.check_multiframe(cmd_tshark, 'zstd', '.zst')
+
+    def test_lz4_multiframe(self, cmd_tshark, features):
+        '''Random access to an lz4 file of several frames.'''
+        if not features.have_lz4:
+            self.skipTest('Requires LZ4.')
+        self.check_multiframe(cmd_tshark, 'lz4', '.lz4')
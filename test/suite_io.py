@@ -69,6 +69,34 @@ class case_tshark_io(subprocesstest.SubprocessTestCase):
         '''Read direct and write direct using TShark'''
         check_io_4_packets(self, capture_file, cmd=cmd_tshark)
 
+    def check_read_ahead(self, cmd_tshark, capture_file, capname, *output_args):
+        '''-2 output is the same with and without --read-ahead'''
+        args = (cmd_tshark, '-2', '-r', capture_file(capname)) + output_args
+        expected = self.assertRun(args).stdout_str
+        self.assertNotEqual(expected, '')
+        # A ring smaller and larger than the number of packets.
+        for count in ('1', '3', '1000'):
+            proc = self.assertRun(args + ('--read-ahead', count))
+            self.assertEqual(proc.stdout_str, expected)
+
+    def test_tshark_io_read_ahead_text(self, cmd_tshark, capture_file):
+        '''Second pass with --read-ahead, detailed text output'''
+        self.check_read_ahead(cmd_tshark, capture_file, 'http2-data-reassembly.pcap', '-V')
+
+    def test_tshark_io_read_ahead_json(self, cmd_tshark, capture_file):
+        '''Second pass with --read-ahead, JSON output'''
+        self.check_read_ahead(cmd_tshark, capture_file, 'dns+icmp.pcapng.gz', '-Tjson')
+
+    def test_tshark_io_read_ahead_filtered(self, cmd_tshark, capture_file):
+        '''Second pass with --read-ahead and a display filter'''
+        self.check_read_ahead(cmd_tshark, capture_file, 'http2-data-reassembly.pcap',
+            '-Y', 'http2', '-Tfields', '-e', 'frame.number', '-e', 'http2.streamid')
+
+    def test_tshark_io_read_ahead_without_2(self, cmd_tshark, capture_file):
+        '''--read-ahead needs -2'''
+        self.assertRun((cmd_tshark, '-r', capture_file('dhcp.pcap'), '--read-ahead', '4'),
+            expected_return=self.exit_command_line)
+
 
 @fixtures.mark_usefixtures('test_env')
 @fixtures.uses_fixtures
@@ -19,10 +19,22 @@ import fixtures
 
 @fixtures.uses_fixtures
 class case_unittests(subprocesstest.SubprocessTestCase):
+    def test_unit_conversation_test(self, program, base_env):
+        '''conversation_test'''
+        self.assertRun((program('conversation_test'),
+            '--verbose'
+        ), env=base_env)
+
     def test_unit_exntest(self, program, base_env):
         '''exntest'''
         self.assertRun(program('exntest'), env=base_env)
 
+    def test_unit_frame_data_sequence_test(self, program, base_env):
+        '''frame_data_sequence_test'''
+        self.assertRun((program('frame_data_sequence_test'),
+            '--verbose'
+        ), env=base_env)
+
     def test_unit_oids_test(self, program, base_env):
         '''oids_test'''
         self.assertRun(program('oids_test'), env=base_env)
@@ -31,6 +43,12 @@ class case_unittests(subprocesstest.SubprocessTestCase):
         '''reassemble_test'''
         self.assertRun(program('reassemble_test'), env=base_env)
 
+    def test_unit_time_shift_test(self, program, base_env):
+        '''time_shift_test'''
+        self.assertRun((program('time_shift_test'),
+            '--verbose'
+        ), env=base_env)
+
     def test_unit_tvbtest(self, program, base_env):
         '''tvbtest'''
         self.assertRun(program('tvbtest'), env=base_env)
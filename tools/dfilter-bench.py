@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+#
+# Time display filter evaluation with and without specialized instructions.
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+'''Time display filter evaluation with and without specialized instructions.
+
+Runs "tshark -r <capture> -Y <filter>" several times with and without
+WIRESHARK_DFILTER_NO_SPECIALIZE set and reports the best time of each.
+The default filter "or"s together many integer comparisons so that
+evaluating it, rather than dissection, dominates the run time. Use a
+capture with many packets, such as a few hundred MB of TCP traffic.
+'''
+
+import argparse
+import os
+import os.path
+import subprocess
+import sys
+import time
+
+def default_filter(terms):
+    return ' or '.join('tcp.port == {}'.format(port) for port in range(1, terms + 1)) + \
+        ' or ' + ' or '.join('tcp.len > {}'.format(65536 + n) for n in range(terms))
+
+def best_time(cmd, env, runs):
+    best = None
+    for _ in range(runs):
+        start = time.perf_counter()
+        subprocess.run(cmd, env=env, stdout=subprocess.DEVNULL, check=True)
+        elapsed = time.perf_counter() - start
+        if best is None or elapsed < best:
+            best = elapsed
+    return best
+
+def main():
+    parser = argparse.ArgumentParser(description='Display filter benchmark')
+    parser.add_argument('-p', '--program-path', default=os.path.curdir, help='Path to TShark.')
+    parser.add_argument('-f', '--filter', help='Display filter to time. By default a long "or" of integer comparisons is used.')
+    parser.add_argument('-t', '--terms', type=int, default=200, help='Number of comparisons of each kind in the default filter.')
+    parser.add_argument('-n', '--runs', type=int, default=5, help='Number of runs in each mode.')
+    parser.add_argument('capture', help='Capture file to read.')
+    args = parser.parse_args()
+
+    tshark_path = os.path.join(args.program_path, 'tshark')
+    if not os.path.isfile(tshark_path):
+        print('tshark not found at {}\n'.format(tshark_path))
+        parser.print_usage()
+        sys.exit(1)
+
+    dfilter = args.filter if args.filter else default_filter(args.terms)
+    cmd = (tshark_path, '-n', '-r', args.capture, '-Y', dfilter)
+
+    specialized_env = os.environ.copy()
+    specialized_env.pop('WIRESHARK_DFILTER_NO_SPECIALIZE', None)
+    generic_env = os.environ.copy()
+    generic_env['WIRESHARK_DFILTER_NO_SPECIALIZE'] = '1'
+
+    generic = best_time(cmd, generic_env, args.runs)
+    specialized = best_time(cmd, specialized_env, args.runs)
+
+    print('Generic:     {:8.3f} s'.format(generic))
+    print('Specialized: {:8.3f} s ({:.1f}% of generic)'.format(specialized, 100.0 * specialized / generic))
+
+if __name__ == '__main__':
+    main()
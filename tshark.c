@@ -52,6 +52,7 @@
 #include <cli_main.h>
 #include <ui/version_info.h>
 #include <wiretap/wtap_opttypes.h>
+#include <wiretap/frame_index.h>
 
 #include "globals.h"
 #include <epan/timestamp.h>
@@ -87,6 +88,7 @@
 #include <epan/epan_dissect.h>
 #include <epan/tap.h>
 #include <epan/stat_tap_ui.h>
+#include <epan/conversation.h>
 #include <epan/conversation_table.h>
 #include <epan/srt_table.h>
 #include <epan/rtd_table.h>
@@ -134,6 +136,11 @@
 #define LONGOPT_ELASTIC_MAPPING_FILTER  LONGOPT_BASE_APPLICATION+4
 #define LONGOPT_EXPORT_TLS_SESSION_KEYS LONGOPT_BASE_APPLICATION+5
 #define LONGOPT_CAPTURE_COMMENT         LONGOPT_BASE_APPLICATION+6
+#define LONGOPT_READ_AHEAD              LONGOPT_BASE_APPLICATION+7
+#define LONGOPT_WRITE_FRAME_INDEX       LONGOPT_BASE_APPLICATION+8
+#define LONGOPT_PREFETCH                LONGOPT_BASE_APPLICATION+9
+#define LONGOPT_MAX_CONVERSATIONS       LONGOPT_BASE_APPLICATION+10
+#define LONGOPT_CONVERSATION_IDLE       LONGOPT_BASE_APPLICATION+11
 
 capture_file cfile;
 
@@ -143,6 +150,12 @@ static frame_data prev_dis_frame;
 static frame_data prev_cap_frame;
 
 static gboolean perform_two_pass_analysis;
+static guint read_ahead_count = 0;  /* records to read ahead in the second pass, 0 = off */
+static guint prefetch_kbytes = 0;   /* KiB of the file to read ahead, 0 = off */
+static gboolean write_frame_index = FALSE;
+static guint max_conversations = 0;         /* conversations to keep, 0 = no limit */
+static guint conversation_idle_packets = 0; /* packets an unused conversation is kept, 0 = no limit */
+static wtap_frame_index_writer *frame_index_writer = NULL;
 static guint32 epan_auto_reset_count = 0;
 static gboolean epan_auto_reset = FALSE;
 
@@ -223,6 +236,7 @@ static void capture_input_cfilter_error(capture_session *cap_session,
 static void capture_input_closed(capture_session *cap_session, gchar *msg);
 
 static void report_counts(void);
+static void log_conversation_counts(void);
 #ifdef _WIN32
 static BOOL WINAPI capture_cleanup(DWORD);
 #else /* _WIN32 */
@@ -389,6 +403,16 @@ print_usage(FILE *output)
   fprintf(output, "\n");
   fprintf(output, "Processing:\n");
   fprintf(output, "  -2                       perform a two-pass analysis\n");
+  fprintf(output, "  --read-ahead <count>     with -2, read up to <count> records of the second\n");
+  fprintf(output, "                           pass ahead on a separate thread\n");
+  fprintf(output, "  --prefetch <kbytes>      have the OS read up to <kbytes> KiB of the file\n");
+  fprintf(output, "                           ahead of the packet being read\n");
+  fprintf(output, "  --max-conversations <count>\n");
+  fprintf(output, "                           keep at most <count> conversations, dropping the\n");
+  fprintf(output, "                           least recently used ones (not with -2)\n");
+  fprintf(output, "  --conversation-idle <packet count>\n");
+  fprintf(output, "                           drop conversations not seen in the last\n");
+  fprintf(output, "                           <packet count> packets (not with -2)\n");
   fprintf(output, "  -M <packet count>        perform session auto reset\n");
   fprintf(output, "  -R <read filter>, --read-filter <read filter>\n");
   fprintf(output, "                           packet Read filter in Wireshark display filter syntax\n");
@@ -419,6 +443,7 @@ print_usage(FILE *output)
   fprintf(output, "                           (or '-' for stdout)\n");
   fprintf(output, "  --capture-comment <comment>\n");
   fprintf(output, "                           add a capture file comment, if supported\n");
+  fprintf(output, "  --write-frame-index      write a frame index for the file read with -r\n");
   fprintf(output, "  -C <config profile>      start with specified configuration profile\n");
   fprintf(output, "  -F <output file type>    set the output file type, default is pcapng\n");
   fprintf(output, "                           an empty \"-F\" option will list the file types\n");
@@ -700,6 +725,11 @@ main(int argc, char *argv[])
     {"no-duplicate-keys", ws_no_argument, NULL, LONGOPT_NO_DUPLICATE_KEYS},
     {"elastic-mapping-filter", ws_required_argument, NULL, LONGOPT_ELASTIC_MAPPING_FILTER},
     {"capture-comment", ws_required_argument, NULL, LONGOPT_CAPTURE_COMMENT},
+    {"read-ahead", ws_required_argument, NULL, LONGOPT_READ_AHEAD},
+    {"write-frame-index", ws_no_argument, NULL, LONGOPT_WRITE_FRAME_INDEX},
+    {"prefetch", ws_required_argument, NULL, LONGOPT_PREFETCH},
+    {"max-conversations", ws_required_argument, NULL, LONGOPT_MAX_CONVERSATIONS},
+    {"conversation-idle", ws_required_argument, NULL, LONGOPT_CONVERSATION_IDLE},
     {0, 0, 0, 0 }
   };
   gboolean             arg_error = FALSE;
@@ -1470,6 +1500,21 @@ main(int argc, char *argv[])
       }
       g_ptr_array_add(capture_comments, g_strdup(ws_optarg));
       break;
+    case LONGOPT_READ_AHEAD:  /* read records ahead in the second pass */
+      read_ahead_count = get_positive_int(ws_optarg, "read-ahead record count");
+      break;
+    case LONGOPT_WRITE_FRAME_INDEX:  /* write a frame index for the input file */
+      write_frame_index = TRUE;
+      break;
+    case LONGOPT_PREFETCH:  /* read the file ahead */
+      prefetch_kbytes = get_positive_int(ws_optarg, "prefetch size");
+      break;
+    case LONGOPT_MAX_CONVERSATIONS:  /* limit the number of conversations */
+      max_conversations = get_positive_int(ws_optarg, "maximum conversation count");
+      break;
+    case LONGOPT_CONVERSATION_IDLE:  /* free idle conversations */
+      conversation_idle_packets = get_positive_int(ws_optarg, "conversation idle packet count");
+      break;
     default:
     case '?':        /* Bad flag - print usage message */
       switch(ws_optopt) {
@@ -1635,6 +1680,21 @@ main(int argc, char *argv[])
     goto clean_exit;
   }
 
+  if (read_ahead_count != 0 && !perform_two_pass_analysis) {
+    cmdarg_err("--read-ahead can only be used with -2.");
+    exit_status = INVALID_OPTION;
+    goto clean_exit;
+  }
+
+  if ((max_conversations != 0 || conversation_idle_packets != 0) &&
+      perform_two_pass_analysis) {
+    /* The second pass would look up conversations that have been freed. */
+    cmdarg_err("--max-conversations and --conversation-idle can't be used with -2.");
+    exit_status = INVALID_OPTION;
+    goto clean_exit;
+  }
+  conversation_set_eviction(max_conversations, conversation_idle_packets);
+
 #ifdef HAVE_LIBPCAP
   if (caps_queries) {
     /* We're supposed to list the link-layer/timestamp types for an interface;
@@ -2472,6 +2532,7 @@ tshark_epan_new(capture_file *cf)
     cap_file_provider_get_interface_name,
     cap_file_provider_get_interface_description,
     NULL,
+    NULL,
   };
 
   return epan_new(&cf->provider, &funcs);
@@ -2609,6 +2670,7 @@ capture(void)
       }
 #endif
     }
+    log_conversation_counts();
   }
   CATCH(OutOfMemoryError) {
     fprintf(stderr,
@@ -3110,6 +3172,52 @@ typedef enum {
   PASS_INTERRUPTED
 } pass_status_t;
 
+/*
+ * Frame index generation (--write-frame-index).  The index is written
+ * while the file is read sequentially, and only kept if the whole file
+ * was read.
+ */
+static void
+frame_index_add(capture_file *cf, gint64 offset, wtap_rec *rec)
+{
+  int err;
+
+  if (frame_index_writer == NULL)
+    return;
+  if (!wtap_frame_index_writer_add(frame_index_writer, offset, rec, &err)) {
+    cmdarg_err("Can't write a frame index for \"%s\": %s", cf->filename,
+               g_strerror(err));
+    wtap_frame_index_writer_abort(frame_index_writer);
+    frame_index_writer = NULL;
+  }
+}
+
+static void
+frame_index_discard(void)
+{
+  if (frame_index_writer != NULL) {
+    wtap_frame_index_writer_abort(frame_index_writer);
+    frame_index_writer = NULL;
+  }
+}
+
+static void
+frame_index_finish(capture_file *cf, pass_status_t status)
+{
+  int err;
+
+  if (frame_index_writer == NULL)
+    return;
+  if (status != PASS_SUCCEEDED) {
+    frame_index_discard();
+    return;
+  }
+  if (!wtap_frame_index_writer_close(frame_index_writer, cf->provider.wth, &err))
+    cmdarg_err("Can't write a frame index for \"%s\": %s", cf->filename,
+               g_strerror(err));
+  frame_index_writer = NULL;
+}
+
 static pass_status_t
 process_cap_file_first_pass(capture_file *cf, int max_packet_count,
                             gint64 max_byte_count, int *err, gchar **err_info)
@@ -3157,6 +3265,7 @@ process_cap_file_first_pass(capture_file *cf, int max_packet_count,
       status = PASS_INTERRUPTED;
       break;
     }
+    frame_index_add(cf, data_offset, &rec);
     if (process_packet_first_pass(cf, edt, data_offset, &rec, &buf)) {
       /* Stop reading if we have the maximum number of packets;
        * When the -c option has not been used, max_packet_count
@@ -3167,6 +3276,7 @@ process_cap_file_first_pass(capture_file *cf, int max_packet_count,
         ws_debug("tshark: max_packet_count (%d) or max_byte_count (%" G_GINT64_MODIFIER "d/%" G_GINT64_MODIFIER "d) reached",
                       max_packet_count, data_offset, max_byte_count);
         *err = 0; /* This is not an error */
+        frame_index_discard();
         break;
       }
     }
@@ -3175,6 +3285,8 @@ process_cap_file_first_pass(capture_file *cf, int max_packet_count,
   if (*err != 0)
     status = PASS_READ_ERROR;
 
+  frame_index_finish(cf, status);
+
   if (edt)
     epan_dissect_free(edt);
 
@@ -3304,6 +3416,145 @@ process_new_idbs(wtap *wth, wtap_dumper *pdh, int *err, gchar **err_info)
   return TRUE;
 }
 
+/*
+ * Second-pass read-ahead.
+ *
+ * Once the first pass is done we know the file offset of every frame
+ * to be processed in the second pass, so a separate thread can fetch
+ * the records with wtap_seek_read() while the main thread dissects and
+ * prints the earlier ones.  Dissection itself stays on the main thread,
+ * in frame order, as the dissection engine isn't thread-safe.
+ *
+ * Frame n is read into slots[(n - 1) % n_slots]; the reader thread may
+ * run at most n_slots frames ahead of the main thread.
+ */
+typedef struct {
+  wtap_rec  rec;
+  Buffer    buf;
+  gboolean  ok;
+  int       err;
+  gchar    *err_info;
+} read_ahead_slot_t;
+
+typedef struct {
+  capture_file      *cf;
+  read_ahead_slot_t *slots;
+  guint              n_slots;
+  guint32            next_read;     /* next frame the reader thread will read */
+  guint32            next_consume;  /* next frame the main thread will process */
+  gboolean           stop;
+  GMutex             mtx;
+  GCond              cond;
+  GThread           *thread;
+} read_ahead_t;
+
+static gpointer
+read_ahead_thread(gpointer data)
+{
+  read_ahead_t      *ra = (read_ahead_t *)data;
+  read_ahead_slot_t *slot;
+  frame_data        *fdata;
+  guint32            framenum;
+
+  for (framenum = 1; framenum <= ra->cf->count; framenum++) {
+    g_mutex_lock(&ra->mtx);
+    while (!ra->stop && framenum - ra->next_consume >= ra->n_slots)
+      g_cond_wait(&ra->cond, &ra->mtx);
+    if (ra->stop) {
+      g_mutex_unlock(&ra->mtx);
+      break;
+    }
+    g_mutex_unlock(&ra->mtx);
+
+    slot = &ra->slots[(framenum - 1) % ra->n_slots];
+    fdata = frame_data_sequence_find(ra->cf->provider.frames, framenum);
+    slot->err_info = NULL;
+    slot->ok = wtap_seek_read(ra->cf->provider.wth, fdata->file_off,
+                              &slot->rec, &slot->buf, &slot->err,
+                              &slot->err_info);
+
+    g_mutex_lock(&ra->mtx);
+    ra->next_read = framenum + 1;
+    g_cond_signal(&ra->cond);
+    g_mutex_unlock(&ra->mtx);
+
+    if (!slot->ok)
+      break;
+  }
+  return NULL;
+}
+
+static read_ahead_t *
+read_ahead_start(capture_file *cf, guint n_slots)
+{
+  read_ahead_t *ra = g_new0(read_ahead_t, 1);
+  guint         i;
+
+  ra->cf = cf;
+  ra->n_slots = n_slots;
+  ra->slots = g_new0(read_ahead_slot_t, n_slots);
+  for (i = 0; i < n_slots; i++) {
+    wtap_rec_init(&ra->slots[i].rec);
+    ws_buffer_init(&ra->slots[i].buf, 1514);
+  }
+  ra->next_read = 1;
+  ra->next_consume = 1;
+  g_mutex_init(&ra->mtx);
+  g_cond_init(&ra->cond);
+  ra->thread = g_thread_new("tshark read-ahead", read_ahead_thread, ra);
+  return ra;
+}
+
+/*
+ * Wait for the reader thread to have read the record for frame
+ * framenum, which must be the next frame to be processed.
+ */
+static read_ahead_slot_t *
+read_ahead_get(read_ahead_t *ra, guint32 framenum)
+{
+  g_mutex_lock(&ra->mtx);
+  while (ra->next_read <= framenum)
+    g_cond_wait(&ra->cond, &ra->mtx);
+  g_mutex_unlock(&ra->mtx);
+
+  return &ra->slots[(framenum - 1) % ra->n_slots];
+}
+
+/*
+ * Hand the slot for frame framenum back to the reader thread.
+ */
+static void
+read_ahead_release(read_ahead_t *ra, guint32 framenum)
+{
+  wtap_rec_reset(&ra->slots[(framenum - 1) % ra->n_slots].rec);
+
+  g_mutex_lock(&ra->mtx);
+  ra->next_consume = framenum + 1;
+  g_cond_signal(&ra->cond);
+  g_mutex_unlock(&ra->mtx);
+}
+
+static void
+read_ahead_stop(read_ahead_t *ra)
+{
+  guint i;
+
+  g_mutex_lock(&ra->mtx);
+  ra->stop = TRUE;
+  g_cond_signal(&ra->cond);
+  g_mutex_unlock(&ra->mtx);
+  g_thread_join(ra->thread);
+
+  g_mutex_clear(&ra->mtx);
+  g_cond_clear(&ra->cond);
+  for (i = 0; i < ra->n_slots; i++) {
+    ws_buffer_free(&ra->slots[i].buf);
+    wtap_rec_cleanup(&ra->slots[i].rec);
+  }
+  g_free(ra->slots);
+  g_free(ra);
+}
+
 static pass_status_t
 process_cap_file_second_pass(capture_file *cf, wtap_dumper *pdh,
                              int *err, gchar **err_info,
@@ -3317,6 +3568,10 @@ process_cap_file_second_pass(capture_file *cf, wtap_dumper *pdh,
   guint           tap_flags;
   epan_dissect_t *edt = NULL;
   pass_status_t   status = PASS_SUCCEEDED;
+  read_ahead_t   *read_ahead = NULL;
+  read_ahead_slot_t *slot;
+  wtap_rec       *recp;
+  Buffer         *bufp;
 
   /*
    * Process whatever IDBs we haven't seen yet.  This will be all
@@ -3372,26 +3627,44 @@ process_cap_file_second_pass(capture_file *cf, wtap_dumper *pdh,
    */
   set_resolution_synchrony(TRUE);
 
+  if (read_ahead_count != 0 && cf->count != 0)
+    read_ahead = read_ahead_start(cf, read_ahead_count);
+
   for (framenum = 1; framenum <= cf->count; framenum++) {
     if (read_interrupted) {
       status = PASS_INTERRUPTED;
       break;
     }
     fdata = frame_data_sequence_find(cf->provider.frames, framenum);
-    if (!wtap_seek_read(cf->provider.wth, fdata->file_off, &rec, &buf, err,
-                        err_info)) {
-      /* Error reading from the input file. */
-      status = PASS_READ_ERROR;
-      break;
+    if (read_ahead != NULL) {
+      slot = read_ahead_get(read_ahead, framenum);
+      if (!slot->ok) {
+        /* Error reading from the input file. */
+        *err = slot->err;
+        *err_info = slot->err_info;
+        status = PASS_READ_ERROR;
+        break;
+      }
+      recp = &slot->rec;
+      bufp = &slot->buf;
+    } else {
+      if (!wtap_seek_read(cf->provider.wth, fdata->file_off, &rec, &buf, err,
+                          err_info)) {
+        /* Error reading from the input file. */
+        status = PASS_READ_ERROR;
+        break;
+      }
+      recp = &rec;
+      bufp = &buf;
     }
     ws_debug("tshark: invoking process_packet_second_pass() for frame #%d", framenum);
-    if (process_packet_second_pass(cf, edt, fdata, &rec, &buf, tap_flags)) {
+    if (process_packet_second_pass(cf, edt, fdata, recp, bufp, tap_flags)) {
       /* Either there's no read filtering or this packet passed the
          filter, so, if we're writing to a capture file, write
          this packet out. */
       if (pdh != NULL) {
         ws_debug("tshark: writing packet #%d to outfile", framenum);
-        if (!wtap_dump(pdh, &rec, ws_buffer_start_ptr(&buf), err, err_info)) {
+        if (!wtap_dump(pdh, recp, ws_buffer_start_ptr(bufp), err, err_info)) {
           /* Error writing to the output file. */
           ws_debug("tshark: error writing to a capture file (%d)", *err);
           *err_framenum = framenum;
@@ -3400,9 +3673,15 @@ process_cap_file_second_pass(capture_file *cf, wtap_dumper *pdh,
         }
       }
     }
-    wtap_rec_reset(&rec);
+    if (read_ahead != NULL)
+      read_ahead_release(read_ahead, framenum);
+    else
+      wtap_rec_reset(&rec);
   }
 
+  if (read_ahead != NULL)
+    read_ahead_stop(read_ahead);
+
   if (edt)
     epan_dissect_free(edt);
 
@@ -3488,6 +3767,7 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
       break;
     }
     framenum++;
+    frame_index_add(cf, data_offset, &rec);
 
     /*
      * Process whatever IDBs we haven't seen yet.
@@ -3526,6 +3806,7 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
       ws_debug("tshark: max_packet_count (%d) or max_byte_count (%" G_GINT64_MODIFIER "d/%" G_GINT64_MODIFIER "d) reached",
                     max_packet_count, data_offset, max_byte_count);
       *err = 0; /* This is not an error */
+      frame_index_discard();
       break;
     }
     wtap_rec_reset(&rec);
@@ -3535,6 +3816,8 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
     status = PASS_READ_ERROR;
   }
 
+  frame_index_finish(cf, status);
+
   if (edt)
     epan_dissect_free(edt);
 
@@ -3633,6 +3916,21 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
     sigaction(SIGHUP, &action, NULL);
 #endif /* _WIN32 */
 
+  if (write_frame_index) {
+    frame_index_writer = wtap_frame_index_writer_open(cf->filename, &err);
+    if (frame_index_writer == NULL) {
+      cmdarg_err("Can't write a frame index for \"%s\": %s", cf->filename,
+                 g_strerror(err));
+      err = 0;
+    }
+  }
+
+  if (prefetch_kbytes != 0)
+    wtap_set_prefetch(cf->provider.wth, (gint64)prefetch_kbytes * 1024);
+
+  /* This is a file we were given to read, not one we're capturing to. */
+  wtap_set_mmap(cf->provider.wth, TRUE);
+
   if (perform_two_pass_analysis) {
     ws_debug("tshark: perform_two_pass_analysis, do_dissection=%s", do_dissection ? "TRUE" : "FALSE");
 
@@ -3673,6 +3971,10 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
                                                       &err_framenum);
   }
 
+  ws_info("tshark: waited %.3f seconds for file reads",
+          wtap_read_stall_time(cf->provider.wth) / 1000000.0);
+  log_conversation_counts();
+
   if (first_pass_status != PASS_SUCCEEDED ||
       second_pass_status != PASS_SUCCEEDED) {
     /*
@@ -4522,6 +4824,16 @@ tshark_cmdarg_err_cont(const char *msg_format, va_list ap)
   fprintf(stderr, "\n");
 }
 
+static void
+log_conversation_counts(void)
+{
+  if (max_conversations == 0 && conversation_idle_packets == 0)
+    return;
+
+  ws_info("tshark: %u conversations kept, %" G_GUINT64_FORMAT " freed",
+          conversation_get_live_count(), conversation_get_evicted_count());
+}
+
 static void reset_epan_mem(capture_file *cf,epan_dissect_t *edt, gboolean tree, gboolean visual)
 {
   if (!epan_auto_reset || (cf->count < epan_auto_reset_count))
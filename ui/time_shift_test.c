@@ -0,0 +1,210 @@
+/* time_shift_test.c
+ * Standalone program to test the Time Shift routines, which keep their
+ * offsets in the capture file's frame_data_sequence.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include <epan/frame_data.h>
+#include <epan/frame_data_sequence.h>
+
+#include "cfile.h"
+#include "ui/time_shift.h"
+#include "ui/ws_ui_util.h"
+
+#define TEST_FRAME_COUNT 3
+
+/* A sequence of frames one second apart, starting at 1000 s. */
+static frame_data_sequence *
+time_shift_test_frames_new(void)
+{
+    frame_data_sequence *fds;
+    frame_data fdlocal;
+    guint32 num;
+
+    fds = new_frame_data_sequence();
+    for (num = 1; num <= TEST_FRAME_COUNT; num++) {
+        memset(&fdlocal, 0, sizeof fdlocal);
+        fdlocal.num = num;
+        fdlocal.has_ts = 1;
+        fdlocal.abs_ts.secs = 999 + num;
+        fdlocal.abs_ts.nsecs = 0;
+        frame_data_sequence_add(fds, &fdlocal);
+    }
+    return fds;
+}
+
+/* ui/time_shift.c asks the GUI to redraw; there's no GUI here. */
+void
+packet_list_queue_draw(void)
+{
+}
+
+/* A capture file with just the frames that ui/time_shift.c looks at. */
+static void
+time_shift_test_cf_init(capture_file *cf)
+{
+    memset(cf, 0, sizeof *cf);
+    cf->provider.frames = time_shift_test_frames_new();
+    cf->count = TEST_FRAME_COUNT;
+}
+
+static void
+time_shift_test_assert_ts(frame_data *fd, time_t secs, int nsecs)
+{
+    g_assert_cmpint(fd->abs_ts.secs, ==, secs);
+    g_assert_cmpint(fd->abs_ts.nsecs, ==, nsecs);
+}
+
+/*
+ * Shift the file with Time Shift, redissect it the way rescan_packets()
+ * in file.c does, then undo the shift.
+ */
+static void
+time_shift_test_all(void)
+{
+    capture_file cf;
+    frame_data *fd;
+    nstime_t shift_offset;
+    guint32 num;
+
+    time_shift_test_cf_init(&cf);
+    fd = frame_data_sequence_find(cf.provider.frames, 2);
+
+    /* Frames start out unshifted. */
+    frame_data_sequence_get_shift_offset(cf.provider.frames, fd, &shift_offset);
+    g_assert_true(nstime_is_zero(&shift_offset));
+    g_assert_false(fd->has_shift_offset);
+
+    /* Shifting applies to every frame. */
+    g_assert_null(time_shift_all(&cf, "5.25"));
+    g_assert_true(cf.unsaved_changes);
+    for (num = 1; num <= TEST_FRAME_COUNT; num++) {
+        fd = frame_data_sequence_find(cf.provider.frames, num);
+        g_assert_true(fd->has_shift_offset);
+        time_shift_test_assert_ts(fd, 1004 + num, 250000000);
+        frame_data_sequence_get_shift_offset(cf.provider.frames, fd, &shift_offset);
+        g_assert_cmpint(shift_offset.secs, ==, 5);
+        g_assert_cmpint(shift_offset.nsecs, ==, 250000000);
+    }
+
+    /* Shifting again accumulates, in either direction. */
+    g_assert_null(time_shift_all(&cf, "5.25"));
+    g_assert_null(time_shift_all(&cf, "-1:00"));
+    fd = frame_data_sequence_find(cf.provider.frames, 2);
+    frame_data_sequence_get_shift_offset(cf.provider.frames, fd, &shift_offset);
+    g_assert_cmpint(shift_offset.secs, ==, -49);
+    g_assert_cmpint(shift_offset.nsecs, ==, -500000000);
+    time_shift_test_assert_ts(fd, 951, 500000000);
+
+    /* A shift of zero is refused, and changes nothing. */
+    g_assert_nonnull(time_shift_all(&cf, "0"));
+    time_shift_test_assert_ts(fd, 951, 500000000);
+
+    /*
+     * Redissect.  Every frame is reset, and the selected one has its
+     * per-frame data destroyed when the epan session is replaced; neither
+     * may lose the shift.
+     */
+    for (num = 1; num <= TEST_FRAME_COUNT; num++)
+        frame_data_reset(frame_data_sequence_find(cf.provider.frames, num));
+    frame_data_destroy(fd);
+    g_assert_true(fd->has_shift_offset);
+    frame_data_sequence_get_shift_offset(cf.provider.frames, fd, &shift_offset);
+    g_assert_cmpint(shift_offset.secs, ==, -49);
+    g_assert_cmpint(shift_offset.nsecs, ==, -500000000);
+
+    /* Undo puts the time stamps back and drops the offsets. */
+    g_assert_null(time_shift_undo(&cf));
+    for (num = 1; num <= TEST_FRAME_COUNT; num++) {
+        fd = frame_data_sequence_find(cf.provider.frames, num);
+        g_assert_false(fd->has_shift_offset);
+        time_shift_test_assert_ts(fd, 999 + num, 0);
+        frame_data_sequence_get_shift_offset(cf.provider.frames, fd, &shift_offset);
+        g_assert_true(nstime_is_zero(&shift_offset));
+    }
+
+    /* Shifting works again after an undo. */
+    g_assert_null(time_shift_all(&cf, "1"));
+    time_shift_test_assert_ts(fd, 1000 + TEST_FRAME_COUNT, 0);
+
+    /* Frames added after a shift start out unshifted. */
+    {
+        frame_data fdlocal;
+
+        memset(&fdlocal, 0, sizeof fdlocal);
+        fdlocal.num = TEST_FRAME_COUNT + 1;
+        fdlocal.has_ts = 1;
+        fdlocal.abs_ts.secs = 999 + fdlocal.num;
+        fd = frame_data_sequence_add(cf.provider.frames, &fdlocal);
+        cf.count++;
+        frame_data_sequence_get_shift_offset(cf.provider.frames, fd, &shift_offset);
+        g_assert_true(nstime_is_zero(&shift_offset));
+        g_assert_null(time_shift_all(&cf, "1"));
+        time_shift_test_assert_ts(fd, 1000 + cf.count, 0);
+    }
+
+    /* Freeing a sequence with shifted frames releases their offsets. */
+    free_frame_data_sequence(cf.provider.frames);
+}
+
+/* Each capture file has its own offsets. */
+static void
+time_shift_test_per_file(void)
+{
+    capture_file cf1, cf2;
+    frame_data *fd1, *fd2;
+    nstime_t shift_offset;
+
+    time_shift_test_cf_init(&cf1);
+    time_shift_test_cf_init(&cf2);
+    fd1 = frame_data_sequence_find(cf1.provider.frames, 1);
+    fd2 = frame_data_sequence_find(cf2.provider.frames, 1);
+
+    g_assert_null(time_shift_all(&cf1, "3"));
+    frame_data_sequence_get_shift_offset(cf2.provider.frames, fd2, &shift_offset);
+    g_assert_true(nstime_is_zero(&shift_offset));
+    time_shift_test_assert_ts(fd2, 1000, 0);
+
+    /* Closing the other file leaves the first one's offsets alone. */
+    free_frame_data_sequence(cf2.provider.frames);
+    frame_data_sequence_get_shift_offset(cf1.provider.frames, fd1, &shift_offset);
+    g_assert_cmpint(shift_offset.secs, ==, 3);
+    g_assert_cmpint(shift_offset.nsecs, ==, 0);
+
+    free_frame_data_sequence(cf1.provider.frames);
+}
+
+int
+main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/time_shift/all", time_shift_test_all);
+    g_test_add_func("/time_shift/per_file", time_shift_test_per_file);
+
+    return g_test_run();
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -24,6 +24,10 @@
 
 #include <wsutil/file_util.h>
 
+#ifdef HAVE_POSIX_FADVISE
+#include <fcntl.h>
+#endif
+
 #ifdef HAVE_ZLIB
 #define ZLIB_CONST
 #include <zlib.h>
@@ -193,6 +197,7 @@ struct wtap_reader {
     /* zlib inflate stream */
     z_stream strm;              /* stream structure in-place (not a pointer) */
     gboolean dont_check_crc;    /* TRUE if we aren't supposed to check the CRC */
+    struct gz_parallel *parallel; /* spans being decompressed by other threads, if any */
 #endif
     /* fast seeking */
     GPtrArray *fast_seek;
@@ -203,6 +208,17 @@ struct wtap_reader {
 #ifdef USE_LZ4
     LZ4F_dctx *lz4_dctx;
 #endif
+
+    /* memory-mapped regular file */
+    GMappedFile *mapped;        /* mapping of the file, if any */
+    const unsigned char *map;   /* contents of the mapping */
+    gint64 map_size;            /* size of the file when it was mapped */
+    gboolean fd_stale;          /* TRUE if the fd's offset isn't raw_pos */
+
+    /* read-ahead */
+    gint64 prefetch_window;     /* how far ahead of raw_pos to request data, 0 if not */
+    gint64 prefetch_end;        /* end of the data requested so far */
+    gint64 stall_time;          /* microseconds spent blocked reading or paging in file data */
 };
 
 /* Current read offset within a buffer. */
@@ -241,16 +257,57 @@ buf_reset(struct wtap_reader_buf *buf)
     buf->avail = 0;
 }
 
+/*
+ * If read-ahead is enabled, ask the OS to start reading the data in the
+ * read-ahead window into its cache, so that it's there by the time we
+ * want it rather than our waiting for it a block at a time.  To keep
+ * the number of requests down, the window is only topped up once half
+ * of it has been used.
+ */
+static void
+file_prefetch(FILE_T state)
+{
+#ifdef HAVE_POSIX_FADVISE
+    gint64 ahead, start;
+
+    if (state->prefetch_window == 0 || state->fd == -1)
+        return;
+    ahead = state->prefetch_end - state->raw_pos;
+    if (ahead > state->prefetch_window / 2 && ahead <= state->prefetch_window)
+        return;
+    /* If we've seeked outside the window, start again from here. */
+    start = (ahead > 0 && ahead <= state->prefetch_window) ?
+        state->prefetch_end : state->raw_pos;
+    state->prefetch_end = state->raw_pos + state->prefetch_window;
+    (void)posix_fadvise(state->fd, start, state->prefetch_end - start,
+                        POSIX_FADV_WILLNEED);
+#else
+    (void)state;
+#endif
+}
+
 static int
 buf_read(FILE_T state, struct wtap_reader_buf *buf)
 {
     guint space_left, to_read;
     unsigned char *read_ptr;
     ssize_t ret;
+    gint64 start_time;
 
     /* How much space is left at the end of the buffer?
        XXX - the output buffer actually has state->size * 2 bytes. */
     space_left = state->size - bytes_in_buffer(buf);
+
+    /* If we've been reading from the mapping, the fd hasn't moved. */
+    if (state->fd_stale) {
+        if (ws_lseek64(state->fd, state->raw_pos, SEEK_SET) == -1) {
+            state->err = errno;
+            state->err_info = NULL;
+            return -1;
+        }
+        state->fd_stale = FALSE;
+    }
+
     if (space_left == 0) {
         /* There's no space left, so we start fresh at the beginning
            of the buffer. */
@@ -266,7 +323,10 @@ buf_read(FILE_T state, struct wtap_reader_buf *buf)
         to_read = space_left;
     }
 
+    file_prefetch(state);
+    start_time = g_get_monotonic_time();
     ret = ws_read(state->fd, read_ptr, to_read);
+    state->stall_time += g_get_monotonic_time() - start_time;
     if (ret < 0) {
         state->err = errno;
         state->err_info = NULL;
@@ -279,6 +339,60 @@ buf_read(FILE_T state, struct wtap_reader_buf *buf)
     return 0;
 }
 
+/*
+ * Number of bytes of uncompressed data that can be taken straight from
+ * the mapping of the file, without going through the output buffer.
+ */
+static gint64
+mapped_avail(FILE_T state)
+{
+    if (state->map == NULL || state->compression != UNCOMPRESSED ||
+        state->in.avail != 0 || state->raw_pos >= state->map_size)
+        return 0;
+    return state->map_size - state->raw_pos;
+}
+
+/*
+ * Minimum buffer size to use once we know the file is compressed.
+ * Decompressing in bigger chunks means fewer read() calls and fewer
+ * trips through the decompressor's setup code per byte of output;
+ * compressed files are rarely read at random without decompressing
+ * a good deal of data anyway, so the larger reads cost little there.
+ */
+#define COMPRESSED_BUF_SIZE (256U * 1024)
+
+/*
+ * Switch to buffers of at least COMPRESSED_BUF_SIZE.  This is done when
+ * the output buffer is empty, i.e. while looking for a compression
+ * header; what's in the input buffer is kept.  If we can't allocate the
+ * memory, we just keep using the buffers we have.
+ */
+static void
+grow_buffers(FILE_T state)
+{
+    unsigned char *in_buf, *out_buf;
+    guint offset;
+
+    if (state->size >= COMPRESSED_BUF_SIZE || state->out.avail != 0)
+        return;
+
+    out_buf = (unsigned char *)g_try_malloc(COMPRESSED_BUF_SIZE << 1);
+    if (out_buf == NULL)
+        return;
+    offset = offset_in_buffer(&state->in);
+    in_buf = (unsigned char *)g_try_realloc(state->in.buf, COMPRESSED_BUF_SIZE);
+    if (in_buf == NULL) {
+        g_free(out_buf);
+        return;
+    }
+    state->in.buf = in_buf;
+    state->in.next = in_buf + offset;
+    g_free(state->out.buf);
+    state->out.buf = out_buf;
+    state->out.next = out_buf;
+    state->size = COMPRESSED_BUF_SIZE;
+}
+
 static int /* gz_avail */
 fill_in_buffer(FILE_T state)
 {
@@ -319,15 +433,20 @@ struct zlib_cur_seek_point {
 };
 
 #define SPAN G_GINT64_CONSTANT(1048576)
-static struct fast_seek_point *
-fast_seek_find(FILE_T file, gint64 pos)
+
+/*
+ * Find the index of the last fast seek point at or before pos; returns
+ * FALSE if there isn't one.
+ */
+static gboolean
+fast_seek_find_index(FILE_T file, gint64 pos, guint *idx)
 {
-    struct fast_seek_point *smallest = NULL;
     struct fast_seek_point *item;
+    gboolean found = FALSE;
     guint low, i, max;
 
     if (!file->fast_seek)
-        return NULL;
+        return FALSE;
 
     for (low = 0, max = file->fast_seek->len; low < max; ) {
         i = (low + max) / 2;
@@ -336,13 +455,25 @@ fast_seek_find(FILE_T file, gint64 pos)
         if (pos < item->out)
             max = i;
         else if (pos > item->out) {
-            smallest = item;
+            *idx = i;
+            found = TRUE;
             low = i + 1;
         } else {
-            return item;
+            *idx = i;
+            return TRUE;
         }
     }
-    return smallest;
+    return found;
+}
+
+static struct fast_seek_point *
+fast_seek_find(FILE_T file, gint64 pos)
+{
+    guint i;
+
+    if (!fast_seek_find_index(file, pos, &i))
+        return NULL;
+    return (struct fast_seek_point *)file->fast_seek->pdata[i];
 }
 
 static void
@@ -570,6 +701,16 @@ zlib_read(FILE_T state, unsigned char *buf, unsigned int count)
     unsigned char *buf2 = buf;
     unsigned int count2 = count;
 
+    /*
+     * Only stop at the end of each deflate block if we're recording
+     * fast seek points, which can only be put at block boundaries.
+     */
+#ifdef Z_BLOCK
+    int flush = state->fast_seek_cur != NULL ? Z_BLOCK : Z_NO_FLUSH;
+#else
+    int flush = Z_NO_FLUSH;
+#endif
+
     strm->avail_out = count;
     strm->next_out = buf;
 
@@ -588,11 +729,7 @@ zlib_read(FILE_T state, unsigned char *buf, unsigned int count)
         strm->avail_in = state->in.avail;
         strm->next_in = state->in.next;
         /* decompress and handle errors */
-#ifdef Z_BLOCK
-        ret = inflate(strm, Z_BLOCK);
-#else
-        ret = inflate(strm, Z_NO_FLUSH);
-#endif
+        ret = inflate(strm, flush);
         state->in.avail = strm->avail_in;
 #ifdef z_const
 DIAG_OFF(cast-qual)
@@ -819,6 +956,7 @@ gz_head(FILE_T state)
                 state->strm.adler = crc32(0L, Z_NULL, 0);
                 state->compression = ZLIB;
                 state->is_compressed = TRUE;
+                grow_buffers(state);
 #ifdef Z_BLOCK
                 if (state->fast_seek) {
                     struct zlib_cur_seek_point *cur = g_new(struct zlib_cur_seek_point,1);
@@ -861,9 +999,23 @@ gz_head(FILE_T state)
     /* FD 37 7A 58 5A 00 */
 #endif
 
+    /*
+     * The zstd and lz4 magic numbers are 4 bytes long.  If this isn't
+     * the first frame in the file, it may start anywhere in the input
+     * buffer, so make sure we have all of it.
+     */
+    if (state->in.avail < 4 && !state->eof) {
+        if (state->in.next != state->in.buf) {
+            memmove(state->in.buf, state->in.next, state->in.avail);
+            state->in.next = state->in.buf;
+        }
+        if (fill_in_buffer(state) == -1)
+            return -1;
+    }
+
     if (state->in.avail >= 4
-        && state->in.buf[0] == 0x28 && state->in.buf[1] == 0xb5
-        && state->in.buf[2] == 0x2f && state->in.buf[3] == 0xfd) {
+        && state->in.next[0] == 0x28 && state->in.next[1] == 0xb5
+        && state->in.next[2] == 0x2f && state->in.next[3] == 0xfd) {
 #ifdef HAVE_ZSTD
         const size_t ret = ZSTD_initDStream(state->zstd_dctx);
         if (ZSTD_isError(ret)) {
@@ -872,8 +1024,15 @@ gz_head(FILE_T state)
             return -1;
         }
 
+        /*
+         * Each frame can be decompressed independently, so the start of
+         * a frame is a place to which we can seek.
+         */
+        if (state->fast_seek)
+            fast_seek_header(state, state->raw_pos - state->in.avail, state->pos, ZSTD);
         state->compression = ZSTD;
         state->is_compressed = TRUE;
+        grow_buffers(state);
         return 0;
 #else
         state->err = WTAP_ERR_DECOMPRESSION_NOT_SUPPORTED;
@@ -883,8 +1042,8 @@ gz_head(FILE_T state)
     }
 
     if (state->in.avail >= 4
-        && state->in.buf[0] == 0x04 && state->in.buf[1] == 0x22
-        && state->in.buf[2] == 0x4d && state->in.buf[3] == 0x18) {
+        && state->in.next[0] == 0x04 && state->in.next[1] == 0x22
+        && state->in.next[2] == 0x4d && state->in.next[3] == 0x18) {
 #ifdef USE_LZ4
 #if LZ4_VERSION_NUMBER >= 10800
         LZ4F_resetDecompressionContext(state->lz4_dctx);
@@ -897,8 +1056,12 @@ gz_head(FILE_T state)
             return -1;
         }
 #endif
+        /* As with zstd, each frame starts a seek point. */
+        if (state->fast_seek)
+            fast_seek_header(state, state->raw_pos - state->in.avail, state->pos, LZ4);
         state->compression = LZ4;
         state->is_compressed = TRUE;
+        grow_buffers(state);
         return 0;
 #else
         state->err = WTAP_ERR_DECOMPRESSION_NOT_SUPPORTED;
@@ -929,6 +1092,476 @@ gz_head(FILE_T state)
     return 0;
 }
 
+#ifdef HAVE_ZLIB
+/*
+ * Set up the inflate stream to decompress from a fast seek point.  The
+ * file must already be positioned at the start of the point's data.
+ */
+static int
+zlib_seek_setup(FILE_T state, struct fast_seek_point *here)
+{
+    z_stream *strm = &state->strm;
+
+    inflateReset(strm);
+    strm->adler = here->data.zlib.adler;
+    strm->total_out = here->data.zlib.total_out;
+#ifdef HAVE_INFLATEPRIME
+    if (here->data.zlib.bits) {
+        int ret = GZ_GETC();
+
+        if (ret == -1) {
+            if (state->err == 0) {
+                /* EOF */
+                state->err = WTAP_ERR_SHORT_READ;
+                state->err_info = NULL;
+            }
+            return -1;
+        }
+        (void)inflatePrime(strm, here->data.zlib.bits, ret >> (8 - here->data.zlib.bits));
+    }
+#endif
+    (void)inflateSetDictionary(strm, here->data.zlib.window, ZLIB_WINSIZE);
+    state->compression = ZLIB;
+    return 0;
+}
+
+/*
+ * Parallel decompression.
+ *
+ * Once the fast seek points of a gzip file are known, i.e. when it's
+ * read again after the first pass, the data between two consecutive
+ * points can be decompressed independently of everything else: each
+ * point has the 32K window needed to start inflating there.  When the
+ * file is read sequentially from such a point, we read the compressed
+ * data of the following spans ourselves and hand it to a pool of
+ * worker threads to decompress, and fill the output buffer from the
+ * spans they've finished.
+ *
+ * The number of spans queued starts at one and doubles with every
+ * span read, so that random reads, which rarely get through a whole
+ * span, don't set off much decompression that won't be used.  Once
+ * we run out of spans, we carry on decompressing ourselves from the
+ * last point.
+ */
+#define GZ_PARALLEL_MAX_THREADS 8
+
+/* Don't bother with spans with an implausible amount of data. */
+#define GZ_SPAN_MAX_SIZE (64U * 1024 * 1024)
+
+struct gz_span {
+    gint64 out;                 /* offset of the span in uncompressed data */
+    gint64 in_end;              /* offset in the file past its compressed data */
+    guint out_len;              /* length of the uncompressed data */
+    guint pos;                  /* how much of it has been delivered */
+    unsigned char *in;          /* compressed data */
+    guint in_len;               /* length of the compressed data */
+    int bits;                   /* bits to use from the first byte of in, or 0 */
+    unsigned char window[ZLIB_WINSIZE]; /* preceding 32K of uncompressed data */
+    guint32 adler;              /* CRC of the uncompressed data before the span */
+    guint32 end_adler;          /* CRC of the uncompressed data up to its end */
+    gboolean check_crc;         /* TRUE if end_adler is to be checked */
+    unsigned char *data;        /* uncompressed data */
+
+    /* set by the worker */
+    int err;                    /* error code */
+    const char *err_info;       /* additional error information string */
+
+    /* protected by the mutex */
+    gboolean done;              /* TRUE once the worker is done with the span */
+    gboolean abandoned;         /* TRUE if the reader no longer wants it */
+};
+
+struct gz_parallel {
+    GThreadPool *pool;          /* workers */
+    GMutex mutex;
+    GCond cond;                 /* signalled when a span is done */
+    GQueue spans;               /* queued spans in file order; the first is being delivered */
+    guint next_point;           /* fast seek point at which the next span to queue starts */
+    guint depth;                /* number of spans to keep queued */
+    guint max_depth;
+    gboolean resync;            /* TRUE if our own inflate stream is behind the data delivered */
+};
+
+static void
+gz_span_free(struct gz_span *span)
+{
+    g_free(span->in);
+    g_free(span->data);
+    g_free(span);
+}
+
+/* Worker function: decompress a span. */
+static void
+gz_span_inflate(gpointer data, gpointer user_data)
+{
+    struct gz_span *span = (struct gz_span *)data;
+    struct gz_parallel *par = (struct gz_parallel *)user_data;
+    z_stream strm;
+    gboolean abandoned;
+    int ret;
+
+    g_mutex_lock(&par->mutex);
+    abandoned = span->abandoned;
+    g_mutex_unlock(&par->mutex);
+    if (abandoned) {
+        gz_span_free(span);
+        return;
+    }
+
+    memset(&strm, 0, sizeof strm);
+    if (inflateInit2(&strm, -15) != Z_OK) {     /* raw inflate */
+        span->err = ENOMEM;
+        span->err_info = NULL;
+    } else {
+        strm.next_in = span->in;
+        strm.avail_in = span->in_len;
+#ifdef HAVE_INFLATEPRIME
+        if (span->bits) {
+            (void)inflatePrime(&strm, span->bits, span->in[0] >> (8 - span->bits));
+            strm.next_in++;
+            strm.avail_in--;
+        }
+#endif
+        (void)inflateSetDictionary(&strm, span->window, ZLIB_WINSIZE);
+        strm.next_out = span->data;
+        strm.avail_out = span->out_len;
+        do {
+            ret = inflate(&strm, Z_NO_FLUSH);
+        } while (ret == Z_OK && strm.avail_out != 0 && strm.avail_in != 0);
+
+        if (ret == Z_MEM_ERROR) {
+            span->err = ENOMEM;
+            span->err_info = NULL;
+        } else if (ret == Z_NEED_DICT) {
+            span->err = WTAP_ERR_DECOMPRESS;
+            span->err_info = "preset dictionary needed";
+        } else if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            span->err = WTAP_ERR_DECOMPRESS;
+            span->err_info = strm.msg;
+        } else if (strm.avail_out != 0) {
+            span->err = WTAP_ERR_SHORT_READ;
+            span->err_info = NULL;
+        } else if (span->check_crc &&
+                   (guint32)crc32(span->adler, span->data, span->out_len) != span->end_adler) {
+            span->err = WTAP_ERR_DECOMPRESS;
+            span->err_info = "bad CRC";
+        }
+        inflateEnd(&strm);
+    }
+    g_free(span->in);
+    span->in = NULL;
+
+    g_mutex_lock(&par->mutex);
+    span->done = TRUE;
+    abandoned = span->abandoned;
+    g_cond_broadcast(&par->cond);
+    g_mutex_unlock(&par->mutex);
+    if (abandoned)
+        gz_span_free(span);
+}
+
+/* Free a span, or leave it to its worker if it's still running. */
+static void
+gz_span_release(struct gz_parallel *par, struct gz_span *span)
+{
+    gboolean done;
+
+    g_mutex_lock(&par->mutex);
+    done = span->done;
+    if (!done)
+        span->abandoned = TRUE;
+    g_mutex_unlock(&par->mutex);
+    if (done)
+        gz_span_free(span);
+}
+
+/*
+ * Can the data from fast seek point i to the next one be decompressed
+ * on its own?
+ */
+static gboolean
+gz_span_usable(FILE_T state, guint i)
+{
+    struct fast_seek_point *here, *next;
+
+    if (state->fast_seek == NULL || i + 1 >= state->fast_seek->len)
+        return FALSE;
+    here = (struct fast_seek_point *)state->fast_seek->pdata[i];
+    next = (struct fast_seek_point *)state->fast_seek->pdata[i + 1];
+    return here->compression == ZLIB && next->compression == ZLIB &&
+           next->in > here->in && next->out > here->out &&
+           next->out - here->out <= GZ_SPAN_MAX_SIZE &&
+           next->in - here->in <= GZ_SPAN_MAX_SIZE;
+}
+
+/* Read raw data from the file, without disturbing our input buffer. */
+static gboolean
+gz_read_raw(FILE_T state, gint64 off, unsigned char *buf, guint len)
+{
+    ssize_t ret;
+    gint64 start_time;
+
+    if (ws_lseek64(state->fd, off, SEEK_SET) == -1)
+        return FALSE;
+    state->fd_stale = TRUE;
+    start_time = g_get_monotonic_time();
+    while (len != 0) {
+        ret = ws_read(state->fd, buf, len);
+        if (ret <= 0)
+            break;
+        buf += ret;
+        len -= (guint)ret;
+    }
+    state->stall_time += g_get_monotonic_time() - start_time;
+    return len == 0;
+}
+
+/*
+ * Queue the span starting at par->next_point for decompression.
+ * Returns FALSE if it can't be.
+ */
+static gboolean
+gz_span_queue(FILE_T state, struct gz_parallel *par)
+{
+    struct fast_seek_point *here, *next;
+    struct gz_span *span;
+    gint64 in_start;
+
+    if (!gz_span_usable(state, par->next_point))
+        return FALSE;
+    here = (struct fast_seek_point *)state->fast_seek->pdata[par->next_point];
+    next = (struct fast_seek_point *)state->fast_seek->pdata[par->next_point + 1];
+
+    span = g_try_new0(struct gz_span, 1);
+    if (span == NULL)
+        return FALSE;
+    in_start = here->in;
+#ifdef HAVE_INFLATEPRIME
+    span->bits = here->data.zlib.bits;
+    if (span->bits)
+        in_start--;
+#endif
+    span->out = here->out;
+    span->out_len = (guint)(next->out - here->out);
+    span->in_end = next->in;
+    span->in_len = (guint)(next->in - in_start);
+    span->in = (unsigned char *)g_try_malloc(span->in_len);
+    span->data = (unsigned char *)g_try_malloc(span->out_len);
+    if (span->in == NULL || span->data == NULL ||
+        !gz_read_raw(state, in_start, span->in, span->in_len)) {
+        gz_span_free(span);
+        return FALSE;
+    }
+    memcpy(span->window, here->data.zlib.window, ZLIB_WINSIZE);
+    span->adler = here->data.zlib.adler;
+    span->end_adler = next->data.zlib.adler;
+    span->check_crc = !state->dont_check_crc;
+
+    g_queue_push_tail(&par->spans, span);
+    g_thread_pool_push(par->pool, span, NULL);
+    par->next_point++;
+    return TRUE;
+}
+
+/* Drop all the queued spans. */
+static void
+gz_parallel_drop(struct gz_parallel *par)
+{
+    struct gz_span *span;
+
+    while ((span = (struct gz_span *)g_queue_pop_head(&par->spans)) != NULL)
+        gz_span_release(par, span);
+}
+
+/*
+ * Called when our own inflate stream is being repositioned, so whatever
+ * has been queued is of no more use.
+ */
+static void
+gz_parallel_reset(FILE_T state)
+{
+    if (state->parallel == NULL)
+        return;
+    gz_parallel_drop(state->parallel);
+    state->parallel->resync = FALSE;
+}
+
+static void
+gz_parallel_free(FILE_T state)
+{
+    struct gz_parallel *par = state->parallel;
+
+    if (par == NULL)
+        return;
+    gz_parallel_drop(par);
+    /* Wait for the workers to finish with the spans we've abandoned. */
+    g_thread_pool_free(par->pool, FALSE, TRUE);
+    g_mutex_clear(&par->mutex);
+    g_cond_clear(&par->cond);
+    g_free(par);
+    state->parallel = NULL;
+}
+
+/* Will a seek forward to pos get to data that's been queued? */
+static gboolean
+gz_parallel_covers(FILE_T state, gint64 pos)
+{
+    struct gz_span *last;
+
+    if (state->parallel == NULL || pos < state->pos)
+        return FALSE;
+    last = (struct gz_span *)g_queue_peek_tail(&state->parallel->spans);
+    return last != NULL && pos < last->out + last->out_len;
+}
+
+/*
+ * Fill the output buffer with data decompressed by the workers, if we
+ * can.  Returns 1 if we did, -1 on an error, and 0 if the caller should
+ * decompress the data itself; in that case *count is reduced, if need
+ * be, so that the caller stops at the start of the next span that the
+ * workers can decompress.
+ */
+static int
+gz_parallel_fill(FILE_T state, guint *count)
+{
+    struct gz_parallel *par = state->parallel;
+    struct gz_span *span;
+    struct fast_seek_point *here;
+    guint i, n;
+    gint64 off;
+    GError *gerr = NULL;
+
+    if (state->fast_seek == NULL)
+        return 0;
+
+    if (par == NULL) {
+        guint threads = MIN(g_get_num_processors(), GZ_PARALLEL_MAX_THREADS);
+
+        if (threads < 2)
+            return 0;
+        par = g_new0(struct gz_parallel, 1);
+        par->pool = g_thread_pool_new(gz_span_inflate, par, (gint)threads,
+                                      FALSE, &gerr);
+        if (par->pool == NULL) {
+            g_error_free(gerr);
+            g_free(par);
+            return 0;
+        }
+        g_mutex_init(&par->mutex);
+        g_cond_init(&par->cond);
+        g_queue_init(&par->spans);
+        par->max_depth = threads * 2;
+        state->parallel = par;
+        ws_debug("decompressing with up to %u threads", threads);
+    }
+
+    /* Are we done with the span we've been delivering? */
+    span = (struct gz_span *)g_queue_peek_head(&par->spans);
+    if (span != NULL && span->pos == span->out_len) {
+        g_queue_pop_head(&par->spans);
+        gz_span_release(par, span);
+        par->depth = MIN(par->depth * 2, par->max_depth);
+        span = (struct gz_span *)g_queue_peek_head(&par->spans);
+    }
+
+    if (span == NULL) {
+        /* Can we start queueing spans here? */
+        if (fast_seek_find_index(state, state->pos, &i) &&
+            ((struct fast_seek_point *)state->fast_seek->pdata[i])->out == state->pos &&
+            gz_span_usable(state, i)) {
+            par->next_point = i;
+            if (!par->resync)
+                par->depth = 1;
+        } else
+            par->next_point = G_MAXUINT;
+    }
+
+    /* Keep the workers busy. */
+    while (g_queue_get_length(&par->spans) < par->depth &&
+           gz_span_queue(state, par))
+        ;
+
+    span = (struct gz_span *)g_queue_peek_head(&par->spans);
+    if (span == NULL) {
+        /*
+         * We'll have to decompress the data ourselves.  If the workers
+         * got us here, we stopped at a fast seek point; carry on from
+         * there.
+         */
+        if (par->resync) {
+            if (!fast_seek_find_index(state, state->pos, &i)) {
+                state->err = WTAP_ERR_INTERNAL;
+                state->err_info = "parallel decompression stopped without a fast seek point";
+                return -1;
+            }
+            here = (struct fast_seek_point *)state->fast_seek->pdata[i];
+            ws_assert(here->out == state->pos);
+            off = here->in;
+#ifdef HAVE_INFLATEPRIME
+            /* zlib_seek_setup() wants the partial byte first. */
+            if (here->data.zlib.bits)
+                off--;
+#endif
+            if (ws_lseek64(state->fd, off, SEEK_SET) == -1) {
+                state->err = errno;
+                state->err_info = NULL;
+                return -1;
+            }
+            state->fd_stale = FALSE;
+            fast_seek_reset(state);
+            state->raw_pos = off;
+            state->eof = FALSE;
+            buf_reset(&state->in);
+            if (zlib_seek_setup(state, here) == -1)
+                return -1;
+            par->resync = FALSE;
+        }
+
+        /* Stop where the workers can take over, if they can. */
+        if (fast_seek_find_index(state, state->pos, &i))
+            i++;
+        else
+            i = 0;
+        if (gz_span_usable(state, i)) {
+            here = (struct fast_seek_point *)state->fast_seek->pdata[i];
+            if (here->out > state->pos && here->out - state->pos < *count)
+                *count = (guint)(here->out - state->pos);
+        }
+        return 0;
+    }
+
+    /* Wait for the first span.  This is waiting for decompression, not
+       for the file, so it isn't counted in stall_time; the reads done
+       to queue the spans are, in gz_read_raw(). */
+    g_mutex_lock(&par->mutex);
+    while (!span->done)
+        g_cond_wait(&par->cond, &par->mutex);
+    g_mutex_unlock(&par->mutex);
+
+    /* From here on, our own inflate stream isn't where the data is. */
+    if (!par->resync) {
+        par->resync = TRUE;
+        state->eof = FALSE;
+        buf_reset(&state->in);
+    }
+
+    if (span->err != 0) {
+        state->err = span->err;
+        state->err_info = span->err_info;
+        gz_parallel_drop(par);
+        return -1;
+    }
+
+    n = MIN(span->out_len - span->pos, *count);
+    memcpy(state->out.buf, span->data + span->pos, n);
+    state->out.next = state->out.buf;
+    state->out.avail = n;
+    span->pos += n;
+    state->raw_pos = span->in_end;
+    return 1;
+}
+#endif
+
 static int /* gz_make */
 fill_out_buffer(FILE_T state)
 {
@@ -944,7 +1577,13 @@ fill_out_buffer(FILE_T state)
     }
 #ifdef HAVE_ZLIB
     else if (state->compression == ZLIB) {      /* decompress */
-        zlib_read(state, state->out.buf, state->size << 1);
+        guint count = state->size << 1;
+        int ret = gz_parallel_fill(state, &count);
+
+        if (ret == -1)
+            return -1;
+        if (ret == 0)
+            zlib_read(state, state->out.buf, count);
     }
 #endif
 #ifdef HAVE_ZSTD
@@ -1014,6 +1653,7 @@ static int
 gz_skip(FILE_T state, gint64 len)
 {
     guint n;
+    gint64 avail;
 
     /* skip over len bytes or reach end-of-file, whichever comes first */
     while (len)
@@ -1036,6 +1676,14 @@ gz_skip(FILE_T state, gint64 len)
             /* We have nothing in the output buffer, and
                we're at the end of the input; just return. */
             break;
+        } else if ((avail = mapped_avail(state)) != 0) {
+            /* The data is in the mapping; just move past it. */
+            if (avail > len)
+                avail = len;
+            state->raw_pos += avail;
+            state->fd_stale = TRUE;
+            state->pos += avail;
+            len -= avail;
         } else {
             /* We have nothing in the output buffer, and
                we can generate more data; get more output,
@@ -1058,6 +1706,9 @@ gz_reset(FILE_T state)
     state->err_info = NULL;
     state->pos = 0;               /* no uncompressed data yet */
     buf_reset(&state->in);        /* no input data yet */
+#ifdef HAVE_ZLIB
+    gz_parallel_reset(state);     /* no spans being decompressed */
+#endif
 }
 
 FILE_T
@@ -1236,6 +1887,48 @@ err:
     return NULL;
 }
 
+/*
+ * Map a regular file into memory, so that file_read() can copy
+ * uncompressed data straight from the mapping instead of reading it
+ * into the output buffer first.  Data appended to the file after it's
+ * mapped is read with ws_read() as usual.  If the file can't be mapped,
+ * we just don't use a mapping.
+ *
+ * Accessing a mapping past the end of a file that's been truncated
+ * since it was mapped raises SIGBUS, so this is only done on request,
+ * by programs that read files nobody else is writing.
+ */
+static void
+file_map(FILE_T state)
+{
+    ws_statb64 st;
+    GError *gerr = NULL;
+
+    if (state->mapped != NULL || state->fd == -1)
+        return;
+    if (ws_fstat64(state->fd, &st) == -1 || !S_ISREG(st.st_mode) ||
+        st.st_size == 0)
+        return;
+    state->mapped = g_mapped_file_new_from_fd(state->fd, FALSE, &gerr);
+    if (state->mapped == NULL) {
+        g_error_free(gerr);
+        return;
+    }
+    state->map = (const unsigned char *)g_mapped_file_get_contents(state->mapped);
+    state->map_size = (gint64)g_mapped_file_get_length(state->mapped);
+}
+
+static void
+file_unmap(FILE_T state)
+{
+    if (state->mapped != NULL) {
+        g_mapped_file_unref(state->mapped);
+        state->mapped = NULL;
+        state->map = NULL;
+        state->map_size = 0;
+    }
+}
+
 FILE_T
 file_open(const char *path)
 {
@@ -1294,6 +1987,36 @@ file_set_random_access(FILE_T stream, gboolean random_flag _U_, GPtrArray *seek)
     stream->fast_seek = seek;
 }
 
+void
+file_set_prefetch(FILE_T stream, gint64 window)
+{
+    stream->prefetch_window = window;
+    stream->prefetch_end = 0;
+#ifdef HAVE_POSIX_FADVISE
+    /* This also makes the OS's own read-ahead more aggressive. */
+    if (window != 0 && stream->fd != -1)
+        (void)posix_fadvise(stream->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+void
+file_set_mmap(FILE_T stream, gboolean mmap_flag)
+{
+    if (mmap_flag) {
+        file_map(stream);
+    } else if (stream->mapped != NULL) {
+        file_unmap(stream);
+        /* We may have been reading from the mapping. */
+        stream->fd_stale = TRUE;
+    }
+}
+
+gint64
+file_stall_time(FILE_T stream)
+{
+    return stream->stall_time;
+}
+
 gint64
 file_seek(FILE_T file, gint64 offset, int whence, int *err)
 {
@@ -1404,10 +2127,21 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
      * outside the span for compressed files or is this an uncompressed
      * file?
      *
+     * A zstd or lz4 point is the start of a frame, which may be well
+     * behind the current position; only go back to it if we're seeking
+     * backwards, or if it's ahead of us, as otherwise skipping forward
+     * from here decompresses less.
+     *
      * XXX, profile
      */
     if ((here = fast_seek_find(file, file->pos + offset)) &&
-        (offset < 0 || offset > SPAN || here->compression == UNCOMPRESSED)) {
+        ((here->compression == ZSTD || here->compression == LZ4) ?
+            (offset < 0 || here->out > file->pos) :
+            (offset < 0 || offset > SPAN || here->compression == UNCOMPRESSED))
+#ifdef HAVE_ZLIB
+        && !gz_parallel_covers(file, file->pos + offset)
+#endif
+        ) {
         gint64 off, off2;
 
         /*
@@ -1429,7 +2163,11 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
             off2 = here->out;
         } else
 #endif
-        {
+        if (here->compression == ZSTD || here->compression == LZ4) {
+            /* Start of a frame; decompress from there. */
+            off = here->in;
+            off2 = here->out;
+        } else {
             off2 = (file->pos + offset);
             off = here->in + (off2 - here->out);
         }
@@ -1439,6 +2177,9 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
             return -1;
         }
         fast_seek_reset(file);
+#ifdef HAVE_ZLIB
+        gz_parallel_reset(file);
+#endif
 
         file->raw_pos = off;
         buf_reset(&file->out);
@@ -1450,29 +2191,10 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
 
 #ifdef HAVE_ZLIB
         if (here->compression == ZLIB) {
-            z_stream *strm = &file->strm;
-
-            inflateReset(strm);
-            strm->adler = here->data.zlib.adler;
-            strm->total_out = here->data.zlib.total_out;
-#ifdef HAVE_INFLATEPRIME
-            if (here->data.zlib.bits) {
-                FILE_T state = file;
-                int ret = GZ_GETC();
-
-                if (ret == -1) {
-                    if (state->err == 0) {
-                        /* EOF */
-                        *err = WTAP_ERR_SHORT_READ;
-                    } else
-                        *err = state->err;
-                    return -1;
-                }
-                (void)inflatePrime(strm, here->data.zlib.bits, ret >> (8 - here->data.zlib.bits));
+            if (zlib_seek_setup(file, here) == -1) {
+                *err = file->err;
+                return -1;
             }
-#endif
-            (void)inflateSetDictionary(strm, here->data.zlib.window, ZLIB_WINSIZE);
-            file->compression = ZLIB;
         } else if (here->compression == GZIP_AFTER_HEADER) {
             z_stream *strm = &file->strm;
 
@@ -1481,6 +2203,10 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
             file->compression = ZLIB;
         } else
 #endif
+        if (here->compression == ZSTD || here->compression == LZ4) {
+            /* Have gz_head() set up the decompressor for the frame. */
+            file->compression = UNKNOWN;
+        } else
             file->compression = here->compression;
 
         offset = (file->pos + offset) - off2;
@@ -1513,8 +2239,17 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
     {
         /*
          * Yes.  Just seek there within the file.
+         *
+         * If the file is mapped, we'll probably be reading from the
+         * mapping, so leave it to buf_read() to seek the fd if it
+         * turns out that we need it.  If the fd's offset is already
+         * stale, e.g. because the file was mapped or its fd was
+         * reopened, a relative seek would be relative to the wrong
+         * place, so leave it to buf_read() as well.
          */
-        if (ws_lseek64(file->fd, offset - file->out.avail, SEEK_CUR) == -1) {
+        if (file->map != NULL || file->fd_stale)
+            file->fd_stale = TRUE;
+        else if (ws_lseek64(file->fd, offset - file->out.avail, SEEK_CUR) == -1) {
             *err = errno;
             return -1;
         }
@@ -1646,6 +2381,7 @@ int
 file_read(void *buf, unsigned int len, FILE_T file)
 {
     guint got, n;
+    gint64 avail, start_time;
 
     /* if len is zero, avoid unnecessary operations */
     if (len == 0)
@@ -1689,6 +2425,32 @@ file_read(void *buf, unsigned int len, FILE_T file)
                we're at the end of the input; just return
                with what we've gotten so far. */
             break;
+        } else if ((avail = mapped_avail(file)) != 0) {
+            /* We have nothing in the output buffer, but
+               the data is in the mapping; copy it from
+               there, rather than reading it into the
+               output buffer and copying it from there. */
+            n = avail > len ? len : (guint)avail;
+            if (buf != NULL) {
+                /* Any wait for the data happens here, as it's
+                   paged in.  Only time it if we're prefetching,
+                   as that's what the time is reported for, and
+                   timing every copy would slow down the common
+                   case. */
+                file_prefetch(file);
+                if (file->prefetch_window != 0) {
+                    start_time = g_get_monotonic_time();
+                    memcpy(buf, file->map + file->raw_pos, n);
+                    file->stall_time += g_get_monotonic_time() - start_time;
+                } else
+                    memcpy(buf, file->map + file->raw_pos, n);
+                buf = (char *)buf + n;
+            }
+            file->raw_pos += n;
+            file->fd_stale = TRUE;
+            len -= n;
+            got += n;
+            file->pos += n;
         } else {
             /* We have nothing in the output buffer, and
                we can generate more data; get more output,
@@ -1885,6 +2647,13 @@ file_clearerr(FILE_T stream)
 void
 file_fdclose(FILE_T file)
 {
+    /*
+     * The mapping keeps the file open as well, which would keep it
+     * from being renamed on Windows; we'll read it with ws_read()
+     * once it's been reopened.
+     */
+    file_unmap(file);
+    file->fd_stale = TRUE;
     ws_close(file->fd);
     file->fd = -1;
 }
@@ -1920,6 +2689,10 @@ file_close(FILE_T file)
         g_free(file->in.buf);
     }
     g_free(file->fast_seek_cur);
+#ifdef HAVE_ZLIB
+    gz_parallel_free(file);
+#endif
+    file_unmap(file);
     file->err = 0;
     file->err_info = NULL;
     g_free(file);
@@ -0,0 +1,313 @@
+/* frame_index.c
+ * Routines for reading and writing persistent frame index files.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#define WS_LOG_DOMAIN LOG_DOMAIN_WIRETAP
+
+#include <errno.h>
+#include <string.h>
+
+#include "frame_index.h"
+#include "wtap-int.h"
+
+#include <wsutil/crc32.h>
+#include <wsutil/file_util.h>
+#include <wsutil/wslog.h>
+
+#define FRAME_INDEX_MAGIC       "WSFIDX\r\n"
+#define FRAME_INDEX_MAGIC_LEN   8
+#define FRAME_INDEX_BYTE_ORDER  0x1A2B3C4D
+
+/*
+ * Number of bytes at the beginning of the capture file that are
+ * checksummed, to catch files that have been rewritten in place with
+ * the same size and modification time.
+ */
+#define FRAME_INDEX_CRC_LEN     65536
+
+typedef struct {
+    char    magic[FRAME_INDEX_MAGIC_LEN];
+    guint32 version;
+    guint32 byte_order;     /* FRAME_INDEX_BYTE_ORDER, in the writer's byte order */
+    guint64 file_size;      /* size of the capture file */
+    gint64  file_mtime;     /* modification time of the capture file */
+    guint32 file_crc;       /* CRC of the first FRAME_INDEX_CRC_LEN bytes */
+    guint32 entry_size;     /* sizeof (wtap_frame_index_entry) */
+    guint32 num_shbs;       /* number of SHBs in the capture file */
+    guint32 num_interfaces; /* number of IDBs in the capture file */
+    guint32 num_entries;
+    guint32 reserved;       /* keeps the entries 8-byte aligned */
+} frame_index_header;
+
+struct wtap_frame_index_writer {
+    char               *filename;       /* name of the index file */
+    char               *tmp_filename;   /* name it's written under until it's complete */
+    FILE               *fh;
+    frame_index_header  hdr;
+};
+
+struct wtap_frame_index {
+    GMappedFile                  *mapped;
+    const frame_index_header     *hdr;
+    const wtap_frame_index_entry *entries;
+};
+
+/*
+ * Fill in the parts of the header that identify the capture file.
+ */
+static gboolean
+frame_index_stat_capture_file(const char *capture_filename,
+                              frame_index_header *hdr, int *err)
+{
+    ws_statb64 statb;
+    guint8    *buf;
+    int        fd;
+    int        bytes_read;
+
+    if (ws_stat64(capture_filename, &statb) != 0) {
+        *err = errno;
+        return FALSE;
+    }
+    hdr->file_size = (guint64)statb.st_size;
+    hdr->file_mtime = (gint64)statb.st_mtime;
+
+    fd = ws_open(capture_filename, O_RDONLY|O_BINARY, 0000);
+    if (fd == -1) {
+        *err = errno;
+        return FALSE;
+    }
+    buf = (guint8 *)g_malloc(FRAME_INDEX_CRC_LEN);
+    bytes_read = (int)ws_read(fd, buf, FRAME_INDEX_CRC_LEN);
+    if (bytes_read < 0) {
+        *err = errno;
+        g_free(buf);
+        ws_close(fd);
+        return FALSE;
+    }
+    hdr->file_crc = crc32_ccitt(buf, bytes_read);
+    g_free(buf);
+    ws_close(fd);
+    return TRUE;
+}
+
+wtap_frame_index_writer *
+wtap_frame_index_writer_open(const char *capture_filename, int *err)
+{
+    wtap_frame_index_writer *writer;
+
+    writer = g_new0(wtap_frame_index_writer, 1);
+    if (!frame_index_stat_capture_file(capture_filename, &writer->hdr, err)) {
+        g_free(writer);
+        return NULL;
+    }
+    memcpy(writer->hdr.magic, FRAME_INDEX_MAGIC, FRAME_INDEX_MAGIC_LEN);
+    writer->hdr.version = WTAP_FRAME_INDEX_VERSION;
+    writer->hdr.byte_order = FRAME_INDEX_BYTE_ORDER;
+    writer->hdr.entry_size = (guint32)sizeof (wtap_frame_index_entry);
+
+    writer->filename = g_strconcat(capture_filename, WTAP_FRAME_INDEX_SUFFIX, NULL);
+    writer->tmp_filename = g_strconcat(writer->filename, ".tmp", NULL);
+    writer->fh = ws_fopen(writer->tmp_filename, "wb");
+    if (writer->fh == NULL) {
+        *err = errno;
+        g_free(writer->tmp_filename);
+        g_free(writer->filename);
+        g_free(writer);
+        return NULL;
+    }
+
+    /* Write a placeholder header; the real one is written at the end. */
+    if (fwrite(&writer->hdr, sizeof writer->hdr, 1, writer->fh) != 1) {
+        *err = errno;
+        wtap_frame_index_writer_abort(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+gboolean
+wtap_frame_index_writer_add(wtap_frame_index_writer *writer, gint64 offset,
+                            const wtap_rec *rec, int *err)
+{
+    wtap_frame_index_entry entry;
+
+    memset(&entry, 0, sizeof entry);
+    entry.file_off = offset;
+    entry.ts_secs = (gint64)rec->ts.secs;
+    entry.ts_nsecs = (gint32)rec->ts.nsecs;
+    entry.rec_type = rec->rec_type;
+    entry.presence_flags = rec->presence_flags;
+    if (rec->rec_type == REC_TYPE_PACKET) {
+        entry.cap_len = rec->rec_header.packet_header.caplen;
+        entry.pkt_len = rec->rec_header.packet_header.len;
+        entry.pkt_encap = rec->rec_header.packet_header.pkt_encap;
+    }
+
+    if (writer->hdr.num_entries == G_MAXUINT32) {
+        *err = EFBIG;
+        return FALSE;
+    }
+    if (fwrite(&entry, sizeof entry, 1, writer->fh) != 1) {
+        *err = errno;
+        return FALSE;
+    }
+    writer->hdr.num_entries++;
+    return TRUE;
+}
+
+gboolean
+wtap_frame_index_writer_close(wtap_frame_index_writer *writer, wtap *wth,
+                              int *err)
+{
+    writer->hdr.num_shbs = wth->shb_hdrs->len;
+    writer->hdr.num_interfaces = wth->interface_data->len;
+
+    if (fseek(writer->fh, 0, SEEK_SET) != 0 ||
+        fwrite(&writer->hdr, sizeof writer->hdr, 1, writer->fh) != 1) {
+        *err = errno;
+        wtap_frame_index_writer_abort(writer);
+        return FALSE;
+    }
+    if (fclose(writer->fh) == EOF) {
+        *err = errno;
+        writer->fh = NULL;
+        wtap_frame_index_writer_abort(writer);
+        return FALSE;
+    }
+    writer->fh = NULL;
+
+    /* ws_rename() doesn't replace an existing file on Windows. */
+    ws_unlink(writer->filename);
+    if (ws_rename(writer->tmp_filename, writer->filename) != 0) {
+        *err = errno;
+        wtap_frame_index_writer_abort(writer);
+        return FALSE;
+    }
+
+    g_free(writer->tmp_filename);
+    g_free(writer->filename);
+    g_free(writer);
+    return TRUE;
+}
+
+void
+wtap_frame_index_writer_abort(wtap_frame_index_writer *writer)
+{
+    if (writer->fh != NULL)
+        fclose(writer->fh);
+    ws_unlink(writer->tmp_filename);
+    g_free(writer->tmp_filename);
+    g_free(writer->filename);
+    g_free(writer);
+}
+
+wtap_frame_index *
+wtap_frame_index_open(const char *capture_filename)
+{
+    wtap_frame_index   *idx;
+    frame_index_header  expected;
+    const frame_index_header *hdr;
+    char               *filename;
+    GMappedFile        *mapped;
+    GError             *gerr = NULL;
+    gsize               length;
+    int                 err;
+
+    memset(&expected, 0, sizeof expected);
+    if (!frame_index_stat_capture_file(capture_filename, &expected, &err))
+        return NULL;
+
+    filename = g_strconcat(capture_filename, WTAP_FRAME_INDEX_SUFFIX, NULL);
+    mapped = g_mapped_file_new(filename, FALSE, &gerr);
+    if (mapped == NULL) {
+        /* Most likely there simply isn't an index. */
+        ws_debug("no frame index %s: %s", filename, gerr->message);
+        g_error_free(gerr);
+        g_free(filename);
+        return NULL;
+    }
+
+    length = g_mapped_file_get_length(mapped);
+    hdr = (const frame_index_header *)g_mapped_file_get_contents(mapped);
+    if (length < sizeof *hdr ||
+        memcmp(hdr->magic, FRAME_INDEX_MAGIC, FRAME_INDEX_MAGIC_LEN) != 0 ||
+        hdr->version != WTAP_FRAME_INDEX_VERSION ||
+        hdr->byte_order != FRAME_INDEX_BYTE_ORDER ||
+        hdr->entry_size != sizeof (wtap_frame_index_entry) ||
+        length != sizeof *hdr + (gsize)hdr->num_entries * sizeof (wtap_frame_index_entry)) {
+        ws_info("ignoring frame index %s: not a valid frame index", filename);
+        g_mapped_file_unref(mapped);
+        g_free(filename);
+        return NULL;
+    }
+    if (hdr->file_size != expected.file_size ||
+        hdr->file_mtime != expected.file_mtime ||
+        hdr->file_crc != expected.file_crc) {
+        ws_info("ignoring frame index %s: capture file has changed", filename);
+        g_mapped_file_unref(mapped);
+        g_free(filename);
+        return NULL;
+    }
+    ws_debug("using frame index %s with %u records", filename, hdr->num_entries);
+    g_free(filename);
+
+    idx = g_new(wtap_frame_index, 1);
+    idx->mapped = mapped;
+    idx->hdr = hdr;
+    idx->entries = (const wtap_frame_index_entry *)(hdr + 1);
+    return idx;
+}
+
+guint32
+wtap_frame_index_count(const wtap_frame_index *idx)
+{
+    return idx->hdr->num_entries;
+}
+
+guint32
+wtap_frame_index_num_shbs(const wtap_frame_index *idx)
+{
+    return idx->hdr->num_shbs;
+}
+
+guint32
+wtap_frame_index_num_interfaces(const wtap_frame_index *idx)
+{
+    return idx->hdr->num_interfaces;
+}
+
+const wtap_frame_index_entry *
+wtap_frame_index_get(const wtap_frame_index *idx, guint32 n)
+{
+    if (n >= idx->hdr->num_entries)
+        return NULL;
+    return &idx->entries[n];
+}
+
+void
+wtap_frame_index_close(wtap_frame_index *idx)
+{
+    g_mapped_file_unref(idx->mapped);
+    g_free(idx);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,148 @@
+/* frame_index.h
+ * Definitions for persistent frame index ("sidecar") files.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __WTAP_FRAME_INDEX_H__
+#define __WTAP_FRAME_INDEX_H__
+
+#include "wiretap/wtap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** @file
+ * A frame index is a file stored next to a capture file, with the name
+ * of the capture file plus WTAP_FRAME_INDEX_SUFFIX, that records the
+ * file offset and the basic metadata of every record in the capture
+ * file.  Programs that would otherwise have to read the whole capture
+ * file sequentially just to find out where its records are can load
+ * the index instead and go straight to wtap_seek_read().
+ *
+ * The index is a fixed-size header followed by an array of fixed-size
+ * entries in host byte order, so it can be memory-mapped and used in
+ * place.  It is tied to the capture file it was generated from by the
+ * file's size, modification time and a CRC of its first bytes; an index
+ * that doesn't match is ignored.
+ */
+
+#define WTAP_FRAME_INDEX_SUFFIX     ".frameidx"
+
+/** Version of the frame index format written by this code. */
+#define WTAP_FRAME_INDEX_VERSION    1
+
+/** One entry per record in the capture file. */
+typedef struct {
+    gint64  file_off;       /**< Offset of the record, as returned by wtap_read() */
+    gint64  ts_secs;        /**< Time stamp of the record, seconds */
+    gint32  ts_nsecs;       /**< Time stamp of the record, nanoseconds */
+    guint32 cap_len;        /**< Captured length of the record */
+    guint32 pkt_len;        /**< Original length of the record */
+    gint32  pkt_encap;      /**< Encapsulation of the record (WTAP_ENCAP_) */
+    guint32 rec_type;       /**< Record type (REC_TYPE_) */
+    guint32 presence_flags; /**< WTAP_HAS_ flags of the record */
+} wtap_frame_index_entry;
+
+typedef struct wtap_frame_index_writer wtap_frame_index_writer;
+typedef struct wtap_frame_index wtap_frame_index;
+
+/**
+ * Start writing a frame index for a capture file.  The index is written
+ * to a temporary file and only put in place by
+ * wtap_frame_index_writer_close().
+ *
+ * @param capture_filename Name of the capture file being indexed.
+ * @param[out] err Set to an errno value on failure.
+ * @return The writer, or NULL on failure.
+ */
+WS_DLL_PUBLIC wtap_frame_index_writer *
+wtap_frame_index_writer_open(const char *capture_filename, int *err);
+
+/**
+ * Add the record just read with wtap_read() to a frame index.
+ *
+ * @param writer The writer.
+ * @param offset The offset returned by wtap_read().
+ * @param rec The record returned by wtap_read().
+ * @param[out] err Set to an errno value on failure.
+ * @return TRUE on success, FALSE on failure.
+ */
+WS_DLL_PUBLIC gboolean
+wtap_frame_index_writer_add(wtap_frame_index_writer *writer, gint64 offset,
+                            const wtap_rec *rec, int *err);
+
+/**
+ * Finish a frame index once all the records of the capture file have
+ * been added, and put it in place.  The writer is freed.
+ *
+ * @param writer The writer.
+ * @param wth The capture file the index was generated from; the number
+ * of sections and interfaces in it is recorded in the index.
+ * @param[out] err Set to an errno value on failure.
+ * @return TRUE on success, FALSE on failure.
+ */
+WS_DLL_PUBLIC gboolean
+wtap_frame_index_writer_close(wtap_frame_index_writer *writer, wtap *wth,
+                              int *err);
+
+/**
+ * Discard a partially written frame index, e.g. because reading the
+ * capture file failed.  The writer is freed.
+ */
+WS_DLL_PUBLIC void
+wtap_frame_index_writer_abort(wtap_frame_index_writer *writer);
+
+/**
+ * Load the frame index for a capture file, if there's one and it
+ * matches the capture file.
+ *
+ * @param capture_filename Name of the capture file.
+ * @return The index, or NULL if there's no usable index.
+ */
+WS_DLL_PUBLIC wtap_frame_index *
+wtap_frame_index_open(const char *capture_filename);
+
+/** Number of records in a frame index. */
+WS_DLL_PUBLIC guint32
+wtap_frame_index_count(const wtap_frame_index *idx);
+
+/** Number of sections that the capture file had once fully read. */
+WS_DLL_PUBLIC guint32
+wtap_frame_index_num_shbs(const wtap_frame_index *idx);
+
+/** Number of interfaces that the capture file had once fully read. */
+WS_DLL_PUBLIC guint32
+wtap_frame_index_num_interfaces(const wtap_frame_index *idx);
+
+/** Get the entry for the n'th record, 0-origin. */
+WS_DLL_PUBLIC const wtap_frame_index_entry *
+wtap_frame_index_get(const wtap_frame_index *idx, guint32 n);
+
+/** Release a frame index. */
+WS_DLL_PUBLIC void
+wtap_frame_index_close(wtap_frame_index *idx);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __WTAP_FRAME_INDEX_H__ */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -35,6 +35,13 @@
 
 
 
+/*
+ * How much of each input file to have the OS read ahead.  Merging
+ * reads from all the input files in turn, which would otherwise mean
+ * a seek and a wait for each of them.
+ */
+#define MERGE_PREFETCH_SIZE (512 * 1024)
+
 static const char* idb_merge_mode_strings[] = {
     /* IDB_MERGE_MODE_NONE */
     "none",
@@ -149,6 +156,7 @@ merge_open_in_files(guint in_file_count, const char *const *in_file_names,
         ws_buffer_init(&files[i].frame_buffer, 1514);
         files[i].size = size;
         files[i].idb_index_map = g_array_new(FALSE, FALSE, sizeof(guint));
+        wtap_set_prefetch(files[i].wth, MERGE_PREFETCH_SIZE);
     }
 
     if (cb)
@@ -204,21 +212,104 @@ merge_select_frame_type(int in_file_count, merge_in_file_t in_files[])
 }
 
 /*
- * returns TRUE if first argument is earlier than second
+ * Files with a record available, kept as a binary min-heap ordered by
+ * merge_record_before(), so that finding the next record to write
+ * doesn't mean looking at every input file.
+ */
+typedef struct {
+    merge_in_file_t **files;
+    guint             count;
+    merge_in_file_t  *refill;   /* file whose record was returned last */
+    gboolean          primed;   /* TRUE once every file has been read from */
+} merge_heap_t;
+
+/*
+ * Returns TRUE if the record from file a should be written before the
+ * record from file b.
+ *
+ * Records with no time stamp can't be put in chronological order, so
+ * they go first, in file order.  Of two records with the same time
+ * stamp, the one from the later file goes first.
  */
 static gboolean
-is_earlier(nstime_t *l, nstime_t *r) /* XXX, move to nstime.c */
+merge_record_before(const merge_in_file_t *a, const merge_in_file_t *b)
 {
-    if (l->secs > r->secs) {  /* left is later */
-        return FALSE;
-    } else if (l->secs < r->secs) { /* left is earlier */
+    gboolean a_has_ts = (a->rec.presence_flags & WTAP_HAS_TS) != 0;
+    gboolean b_has_ts = (b->rec.presence_flags & WTAP_HAS_TS) != 0;
+
+    if (a_has_ts != b_has_ts)
+        return !a_has_ts;
+    if (!a_has_ts)
+        return a < b;
+    if (a->rec.ts.secs != b->rec.ts.secs)
+        return a->rec.ts.secs < b->rec.ts.secs;
+    if (a->rec.ts.nsecs != b->rec.ts.nsecs)
+        return a->rec.ts.nsecs < b->rec.ts.nsecs;
+    return a > b;
+}
+
+static void
+merge_heap_push(merge_heap_t *heap, merge_in_file_t *in_file)
+{
+    guint i = heap->count++;
+
+    while (i > 0) {
+        guint parent = (i - 1) / 2;
+
+        if (!merge_record_before(in_file, heap->files[parent]))
+            break;
+        heap->files[i] = heap->files[parent];
+        i = parent;
+    }
+    heap->files[i] = in_file;
+}
+
+static merge_in_file_t *
+merge_heap_pop(merge_heap_t *heap)
+{
+    merge_in_file_t *top = heap->files[0];
+    merge_in_file_t *last = heap->files[--heap->count];
+    guint i = 0;
+
+    for (;;) {
+        guint child = 2 * i + 1;
+
+        if (child >= heap->count)
+            break;
+        if (child + 1 < heap->count &&
+            merge_record_before(heap->files[child + 1], heap->files[child]))
+            child++;
+        if (!merge_record_before(heap->files[child], last))
+            break;
+        heap->files[i] = heap->files[child];
+        i = child;
+    }
+    if (heap->count != 0)
+        heap->files[i] = last;
+    return top;
+}
+
+/*
+ * Read the next record from a file and, if there is one, put the file
+ * into the heap.  Returns FALSE on a read error.
+ */
+static gboolean
+merge_heap_fill(merge_heap_t *heap, merge_in_file_t *in_file,
+                int *err, gchar **err_info)
+{
+    gint64 data_offset;
+
+    if (!wtap_read(in_file->wth, &in_file->rec, &in_file->frame_buffer,
+                   err, err_info, &data_offset)) {
+        if (*err != 0) {
+            in_file->state = GOT_ERROR;
+            return FALSE;
+        }
+        in_file->state = AT_EOF;
         return TRUE;
-    } else if (l->nsecs > r->nsecs) { /* tv_sec equal, l.usec later */
-        return FALSE;
     }
-    /* either one < two or one == two
-     * either way, return one
-     */
+    in_file->state = RECORD_PRESENT;
+    merge_heap_push(heap, in_file);
     return TRUE;
 }
 
@@ -234,6 +325,7 @@ is_earlier(nstime_t *l, nstime_t *r) /* XXX, move to nstime.c */
  * On an EOF (meaning all the files are at EOF), set *err to 0 and return
  * NULL.
  *
+ * @param heap heap of files with a record available
  * @param in_file_count number of entries in in_files
  * @param in_files input file array
  * @param err wiretap error, if failed
@@ -243,80 +335,51 @@ is_earlier(nstime_t *l, nstime_t *r) /* XXX, move to nstime.c */
  * all files
  */
 static merge_in_file_t *
-merge_read_packet(int in_file_count, merge_in_file_t in_files[],
-                  int *err, gchar **err_info)
+merge_read_packet(merge_heap_t *heap, int in_file_count,
+                  merge_in_file_t in_files[], int *err, gchar **err_info)
 {
+    merge_in_file_t *in_file;
     int i;
-    int ei = -1;
-    nstime_t tv = NSTIME_INIT_MAX;
-    wtap_rec *rec;
 
     /*
      * Make sure we have a record available from each file that's not at
-     * EOF, and search for the record with the earliest time stamp or
-     * with no time stamp (those records are treated as earlier than
-     * all other records).  Yes, this means you won't get a chronological
-     * merge of those records, but you obviously *can't* get that.
+     * EOF; after the first time through, that's just the file whose
+     * record we returned last time.
      */
-    for (i = 0; i < in_file_count; i++) {
-        gint64 data_offset;
-
-        if (in_files[i].state == RECORD_NOT_PRESENT) {
-            /*
-             * No packet available, and we haven't seen an error or EOF yet,
-             * so try to read the next packet.
-             */
-            if (!wtap_read(in_files[i].wth, &in_files[i].rec,
-                           &in_files[i].frame_buffer, err, err_info,
-                           &data_offset)) {
-                if (*err != 0) {
-                    in_files[i].state = GOT_ERROR;
-                    return &in_files[i];
-                }
-                in_files[i].state = AT_EOF;
-            } else
-                in_files[i].state = RECORD_PRESENT;
-        }
-
-        if (in_files[i].state == RECORD_PRESENT) {
-            rec = &in_files[i].rec;
-            if (!(rec->presence_flags & WTAP_HAS_TS)) {
-                /*
-                 * No time stamp.  Pick this record, and stop looking.
-                 */
-                ei = i;
-                break;
-            }
-            if (is_earlier(&rec->ts, &tv)) {
-                /*
-                 * This record's time stamp is earlier than any of the
-                 * records we've seen so far.  Pick it, for now, but
-                 * keep looking.
-                 */
-                tv = rec->ts;
-                ei = i;
-            }
+    if (!heap->primed) {
+        for (i = 0; i < in_file_count; i++) {
+            if (!merge_heap_fill(heap, &in_files[i], err, err_info))
+                return &in_files[i];
         }
+        heap->primed = TRUE;
+    } else if (heap->refill != NULL) {
+        in_file = heap->refill;
+        heap->refill = NULL;
+        if (!merge_heap_fill(heap, in_file, err, err_info))
+            return in_file;
     }
 
-    if (ei == -1) {
+    if (heap->count == 0) {
         /* All the streams are at EOF.  Return an EOF indication. */
         *err = 0;
         return NULL;
     }
 
+    in_file = merge_heap_pop(heap);
+
     /* We'll need to read another packet from this file. */
-    in_files[ei].state = RECORD_NOT_PRESENT;
+    in_file->state = RECORD_NOT_PRESENT;
+    heap->refill = in_file;
 
     /* Count this packet. */
-    in_files[ei].packet_num++;
+    in_file->packet_num++;
 
     /*
      * Return a pointer to the merge_in_file_t of the file from which the
      * packet was read.
      */
     *err = 0;
-    return &in_files[ei];
+    return in_file;
 }
 
 /** Read the next packet, in file sequence order, from the set of files
@@ -848,6 +911,10 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
     int                 count = 0;
     gboolean            stop_flag = FALSE;
     wtap_rec *rec,      snap_rec;
+    merge_heap_t        heap;
+
+    memset(&heap, 0, sizeof heap);
+    heap.files = g_new(merge_in_file_t *, in_file_count);
 
     for (;;) {
         *err = 0;
@@ -857,8 +924,8 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
                                                err_info);
         }
         else {
-            in_file = merge_read_packet(in_file_count, in_files, err,
-                                        err_info);
+            in_file = merge_read_packet(&heap, in_file_count, in_files,
+                                        err, err_info);
         }
 
         if (in_file == NULL) {
@@ -948,6 +1015,8 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
         wtap_rec_reset(rec);
     }
 
+    g_free(heap.files);
+
     if (cb)
         cb->callback_func(MERGE_EVENT_DONE, count, in_files, in_file_count, cb->data);
 
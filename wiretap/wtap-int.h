@@ -75,6 +75,7 @@ struct wtap {
     wtap_new_ipv6_callback_t    add_new_ipv6;
     wtap_new_secrets_callback_t add_new_secrets;
     GPtrArray                   *fast_seek;
+    gint64                      read_stall_time;        /**< Stall time of the sequential stream, once closed */
 };
 
 struct wtap_dumper;
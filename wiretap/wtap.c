@@ -1407,6 +1407,7 @@ wtap_sequential_close(wtap *wth)
 		(*wth->subtype_sequential_close)(wth);
 
 	if (wth->fh != NULL) {
+		wth->read_stall_time += file_stall_time(wth->fh);
 		file_close(wth->fh);
 		wth->fh = NULL;
 	}
@@ -1668,6 +1669,40 @@ wtap_read_so_far(wtap *wth)
 	return file_tell_raw(wth->fh);
 }
 
+void
+wtap_set_prefetch(wtap *wth, gint64 window)
+{
+	/*
+	 * Only the sequential stream reads far enough ahead
+	 * for this to be worthwhile.
+	 */
+	if (wth->fh != NULL && !wth->ispipe)
+		file_set_prefetch(wth->fh, window);
+}
+
+void
+wtap_set_mmap(wtap *wth, gboolean use_mmap)
+{
+	if (wth->ispipe)
+		return;
+	if (wth->fh != NULL)
+		file_set_mmap(wth->fh, use_mmap);
+	if (wth->random_fh != NULL)
+		file_set_mmap(wth->random_fh, use_mmap);
+}
+
+gint64
+wtap_read_stall_time(wtap *wth)
+{
+	gint64 stall_time = wth->read_stall_time;
+
+	if (wth->fh != NULL)
+		stall_time += file_stall_time(wth->fh);
+	if (wth->random_fh != NULL)
+		stall_time += file_stall_time(wth->random_fh);
+	return stall_time;
+}
+
 /* Perform global/initial initialization */
 void
 wtap_rec_init(wtap_rec *rec)
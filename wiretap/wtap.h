@@ -1795,6 +1795,43 @@ GSList *wtap_get_all_compression_type_extensions_list(void);
  * from the file so far. */
 WS_DLL_PUBLIC
 gint64 wtap_read_so_far(wtap *wth);
+
+/**
+ * @brief Read the file ahead of the sequential read position.
+ * @details Asks the OS to keep up to window bytes past the current
+ *          position in the file being read sequentially on their way
+ *          into memory, so that reading doesn't wait for each block in
+ *          turn, e.g. on network storage.  Has no effect on pipes or
+ *          on platforms without posix_fadvise().
+ *
+ * @param wth The wiretap session.
+ * @param window The number of bytes to read ahead, or 0 to stop.
+ */
+WS_DLL_PUBLIC
+void wtap_set_prefetch(wtap *wth, gint64 window);
+
+/**
+ * @brief Read uncompressed data straight from a mapping of the file.
+ * @details Saves copying the data of every record through an
+ *          intermediate buffer.  Only use this on files that won't be
+ *          truncated while they're open: accessing a mapping past the
+ *          end of a truncated file crashes the program with SIGBUS.
+ *          That rules out files that are being captured to.  Has no
+ *          effect on pipes, or on files that can't be mapped.
+ *
+ * @param wth The wiretap session.
+ * @param use_mmap TRUE to map the file, FALSE to stop using a mapping.
+ */
+WS_DLL_PUBLIC
+void wtap_set_mmap(wtap *wth, gboolean use_mmap);
+
+/** Return the total time, in microseconds, spent waiting for data to be
+ * read from the file so far.  Waits for a mapped file's pages (see
+ * wtap_set_mmap()) are only counted if a prefetch window has been set
+ * with wtap_set_prefetch().  Time spent waiting for compressed data to be
+ * decompressed isn't counted. */
+WS_DLL_PUBLIC
+gint64 wtap_read_stall_time(wtap *wth);
 WS_DLL_PUBLIC
 gint64 wtap_file_size(wtap *wth, int *err);
 WS_DLL_PUBLIC
@@ -42,6 +42,7 @@
 #include <glib.h>
 
 #include <wsutil/epochs.h>
+#include <wsutil/file_util.h>
 
 #include "pcapio.h"
 
@@ -188,6 +189,30 @@ write_to_file(FILE* pfile, const guint8* data, size_t data_length,
         return TRUE;
 }
 
+/*
+ * Default size of the buffer used when writing a capture file; large
+ * enough that the data is written out in big chunks rather than a few
+ * packets at a time.
+ */
+#define PCAPIO_WRITE_BUF_SIZE (1024 * 1024)
+
+size_t
+pcapio_write_buffer_size(int fd)
+{
+        size_t buffsize = PCAPIO_WRITE_BUF_SIZE;
+#ifdef HAVE_STRUCT_STAT_ST_BLKSIZE
+        ws_statb64 statb;
+
+        /* Make it a multiple of the file system's preferred I/O size. */
+        if (ws_fstat64(fd, &statb) == 0 && statb.st_blksize > 0) {
+                buffsize = ((buffsize + statb.st_blksize - 1) / statb.st_blksize) * statb.st_blksize;
+        }
+#else
+        (void)fd;
+#endif
+        return buffsize;
+}
+
 /* Writing pcap files */
 
 /* Write the file header to a dump file.
@@ -11,6 +11,11 @@
  * SPDX-License-Identifier: GPL-2.0-or-later
  */
 
+/** Return the size of the stdio buffer to use when writing a capture
+    file to the file descriptor "fd". */
+extern size_t
+pcapio_write_buffer_size(int fd);
+
 /* Writing pcap files */
 
 /** Write the file header to a dump file.
@@ -11,6 +11,8 @@
 #include "config.h"
 #include "str_util.h"
 
+#include <string.h>
+
 int
 ws_xton(char ch)
 {
@@ -208,6 +210,38 @@ printable_char_or_period(gchar c)
 	return g_ascii_isprint(c) ? c : '.';
 }
 
+const guint8 *
+ws_memmem(const guint8 *haystack, size_t haystack_len,
+		const guint8 *needle, size_t needle_len)
+{
+	const guint8 *begin, *last_possible;
+	guint8 first, last;
+
+	if (needle_len == 0 || needle_len > haystack_len)
+		return NULL;
+
+	first = needle[0];
+	last = needle[needle_len - 1];
+	last_possible = haystack + haystack_len - needle_len;
+	begin = haystack;
+
+	while (begin <= last_possible) {
+		/* Let the C library find the next candidate. */
+		begin = (const guint8 *)memchr(begin, first,
+				(size_t)(last_possible - begin) + 1);
+		if (begin == NULL)
+			return NULL;
+		/* Checking the last byte first rejects most candidates
+		 * without calling memcmp(). */
+		if (begin[needle_len - 1] == last &&
+				memcmp(begin + 1, needle + 1, needle_len - 1) == 0)
+			return begin;
+		begin++;
+	}
+
+	return NULL;
+}
+
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
  *
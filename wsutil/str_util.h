@@ -112,6 +112,22 @@ gchar *format_size_wmem(wmem_allocator_t *allocator, gint64 size, format_size_fl
 WS_DLL_PUBLIC
 gchar printable_char_or_period(gchar c);
 
+/** Find the first occurrence of a byte string in another byte string.
+ *
+ * The search uses memchr() to skip to the candidate positions, which
+ * the C library implements with vector instructions on most platforms.
+ *
+ * @param haystack The bytes to search
+ * @param haystack_len The number of bytes in haystack
+ * @param needle The bytes to search for
+ * @param needle_len The number of bytes in needle
+ * @return A pointer to the first occurrence of needle in haystack, or NULL
+ * if there is none or if needle_len is 0
+ */
+WS_DLL_PUBLIC
+const guint8 *ws_memmem(const guint8 *haystack, size_t haystack_len,
+			const guint8 *needle, size_t needle_len);
+
 /* To pass one of two strings, singular or plural */
 #define plurality(d,s,p) ((d) == 1 ? (s) : (p))
 
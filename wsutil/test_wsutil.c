@@ -9,6 +9,7 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <glib.h>
 #include <wsutil/utf8_entities.h>
 
@@ -32,6 +33,115 @@ static void test_format_size(void)
     g_free(str);
 }
 
+static void test_ws_memmem(void)
+{
+    static const guint8 haystack[] = "abcabdabcabcd";
+    const guint8 *p;
+
+    p = ws_memmem(haystack, 13, (const guint8 *)"abcd", 4);
+    g_assert_true(p == haystack + 9);
+
+    p = ws_memmem(haystack, 13, (const guint8 *)"a", 1);
+    g_assert_true(p == haystack);
+
+    p = ws_memmem(haystack, 13, (const guint8 *)"d", 1);
+    g_assert_true(p == haystack + 5);
+
+    /* Needle at the very end and just past it. */
+    p = ws_memmem(haystack, 13, (const guint8 *)"cd", 2);
+    g_assert_true(p == haystack + 11);
+    p = ws_memmem(haystack, 12, (const guint8 *)"cd", 2);
+    g_assert_null(p);
+
+    p = ws_memmem(haystack, 13, (const guint8 *)"abx", 3);
+    g_assert_null(p);
+    p = ws_memmem(haystack, 3, (const guint8 *)"abcd", 4);
+    g_assert_null(p);
+    p = ws_memmem(haystack, 13, (const guint8 *)"", 0);
+    g_assert_null(p);
+}
+
+/* The straightforward search that ws_memmem() replaced in epan_memmem(). */
+static const guint8 *
+naive_memmem(const guint8 *haystack, size_t haystack_len,
+                const guint8 *needle, size_t needle_len)
+{
+    const guint8 *begin;
+    const guint8 *last_possible;
+
+    if (needle_len == 0 || haystack_len < needle_len)
+        return NULL;
+
+    last_possible = haystack + haystack_len - needle_len;
+    for (begin = haystack; begin <= last_possible; ++begin) {
+        if (begin[0] == needle[0] &&
+                !memcmp(&begin[1], needle + 1, needle_len - 1))
+            return begin;
+    }
+    return NULL;
+}
+
+#define MEMMEM_HAYSTACK_LEN (64 * 1024)
+#define MEMMEM_LOOP_COUNT   2000
+
+static void
+time_memmem(const char *desc, const guint8 *haystack,
+                const guint8 *needle, size_t needle_len)
+{
+    const guint8 *expected, *p = NULL;
+    double naive_ms, ws_ms;
+    int i;
+
+    expected = naive_memmem(haystack, MEMMEM_HAYSTACK_LEN, needle, needle_len);
+    g_assert_true(ws_memmem(haystack, MEMMEM_HAYSTACK_LEN, needle, needle_len) == expected);
+
+    g_test_timer_start();
+    for (i = 0; i < MEMMEM_LOOP_COUNT; i++)
+        p = naive_memmem(haystack, MEMMEM_HAYSTACK_LEN, needle, needle_len);
+    naive_ms = g_test_timer_elapsed() * 1000;
+    g_assert_true(p == expected);
+
+    g_test_timer_start();
+    for (i = 0; i < MEMMEM_LOOP_COUNT; i++)
+        p = ws_memmem(haystack, MEMMEM_HAYSTACK_LEN, needle, needle_len);
+    ws_ms = g_test_timer_elapsed() * 1000;
+    g_assert_true(p == expected);
+
+    g_test_minimized_result(ws_ms,
+        "%s: naive %.3f ms, ws_memmem %.3f ms", desc, naive_ms, ws_ms);
+}
+
+/*
+ * Compare ws_memmem() with the search it replaced, on a 64 KiB haystack,
+ * the size of a large reassembled PDU.  Run with "test_wsutil -m perf".
+ */
+static void test_ws_memmem_perf(void)
+{
+    guint8 *haystack;
+    static const guint8 rare_needle[] = "GET /index.html";
+    static const guint8 common_needle[] = { 0x00, 0x00, 0x00, 0x01 };
+    static const guint8 last_needle[] = { 0xfe, 0xfe, 0xfe, 0xff };
+    int i;
+
+    haystack = (guint8 *)g_malloc(MEMMEM_HAYSTACK_LEN);
+
+    /* Packet-like bytes; 'G' doesn't occur, so the needle's first byte is rare. */
+    for (i = 0; i < MEMMEM_HAYSTACK_LEN; i++)
+        haystack[i] = (guint8)((i * 7) % 64);
+    time_memmem("first byte absent", haystack, rare_needle, sizeof rare_needle - 1);
+
+    /* Mostly zeroes: the needle's first byte is everywhere. */
+    memset(haystack, 0, MEMMEM_HAYSTACK_LEN);
+    time_memmem("first byte everywhere", haystack, common_needle, sizeof common_needle);
+
+    /* Needle right at the end of a haystack full of its first byte. */
+    memset(haystack, 0xfe, MEMMEM_HAYSTACK_LEN);
+    haystack[MEMMEM_HAYSTACK_LEN - 1] = 0xff;
+    time_memmem("match at the end", haystack, last_needle, sizeof last_needle);
+
+    g_free(haystack);
+}
+
 #include "to_str.h"
 
 static void test_word_to_hex(void)
@@ -474,6 +584,10 @@ int main(int argc, char **argv)
     g_test_init(&argc, &argv, NULL);
 
     g_test_add_func("/str_util/format_size", test_format_size);
+    g_test_add_func("/str_util/ws_memmem", test_ws_memmem);
+    if (g_test_perf()) {
+        g_test_add_func("/str_util/ws_memmem_perf", test_ws_memmem_perf);
+    }
 
     g_test_add_func("/to_str/word_to_hex", test_word_to_hex);
     g_test_add_func("/to_str/bytes_to_str", test_bytes_to_str);